@@ -489,6 +489,29 @@ typedef union {
   void *ptr;
 } nghttp2_data_source;
 
+/**
+ * @enum
+ *
+ * The flags used to set in |*eof| output parameter in
+ * :type:`nghttp2_data_source_read_callback`.
+ */
+typedef enum {
+  /**
+   * No flag set.
+   */
+  NGHTTP2_DATA_FLAG_NONE = 0,
+  /**
+   * Indicates EOF was sensed.
+   */
+  NGHTTP2_DATA_FLAG_EOF = 0x01,
+  /**
+   * Indicates that DATA payload will be written by
+   * :member:`nghttp2_session_callbacks.send_data_callback` instead of
+   * being copied to the library buffer.
+   */
+  NGHTTP2_DATA_FLAG_NO_COPY = 0x02
+} nghttp2_data_flag;
+
 /**
  * @functypedef
  *
@@ -497,7 +520,18 @@ typedef union {
  * implementation of this function must read at most |length| bytes of
  * data from |source| (or possibly other places) and store them in
  * |buf| and return number of data stored in |buf|. If EOF is reached,
- * set |*eof| to 1.  If the application wants to postpone DATA frames,
+ * set :enum:`NGHTTP2_DATA_FLAG_EOF` in |*eof|.
+ *
+ * If the application wants to avoid copying data into |buf|, it can
+ * set :enum:`NGHTTP2_DATA_FLAG_NO_COPY` in |*eof| and return the
+ * number of bytes to send without touching |buf|. In this case,
+ * :member:`nghttp2_session_callbacks.send_data_callback` must be
+ * specified, and it is invoked later to send the frame header and
+ * that amount of payload directly from the application's own
+ * memory. :enum:`NGHTTP2_DATA_FLAG_NO_COPY` may be combined with
+ * :enum:`NGHTTP2_DATA_FLAG_EOF`.
+ *
+ * If the application wants to postpone DATA frames,
  * (e.g., asynchronous I/O, or reading data blocks for long time), it
  * is achieved by returning :enum:`NGHTTP2_ERR_DEFERRED` without
  * reading any data in this invocation.  The library removes DATA
@@ -1023,6 +1057,69 @@ typedef int (*nghttp2_on_unknown_frame_recv_callback)
  const uint8_t *payload, size_t payloadlen,
  void *user_data);
 
+/**
+ * @functypedef
+ *
+ * Callback function invoked when the library wants to send DATA frame
+ * whose payload was not copied into the library buffer because
+ * :type:`nghttp2_data_source_read_callback` set
+ * :enum:`NGHTTP2_DATA_FLAG_NO_COPY`. The |framehd| points to the 8
+ * bytes frame header serialized by the library. The |length| is the
+ * length of the payload, which is the value returned by the
+ * :type:`nghttp2_data_source_read_callback`. The |stream_id| is the
+ * stream ID of the DATA frame and the |source| is the data source
+ * passed to :type:`nghttp2_data_source_read_callback`.
+ *
+ * The implementation of this function must send (or take the
+ * responsibility to send) the |framehd| followed by |length| bytes of
+ * payload read from |source|, for example, using writev(2) with the
+ * frame header and the application buffer as separate vectors. It
+ * must write either all of them or nothing.
+ *
+ * The implementation of this function must return 0 if it
+ * succeeds. If it cannot send anything without blocking, it must
+ * return :enum:`NGHTTP2_ERR_WOULDBLOCK`; in this case, the same frame
+ * will be passed to this callback again later, so the payload must be
+ * kept available.  For other errors, it must return
+ * :enum:`NGHTTP2_ERR_CALLBACK_FAILURE`.
+ */
+typedef int (*nghttp2_send_data_callback)
+(nghttp2_session *session, const uint8_t *framehd, size_t length,
+ int32_t stream_id, nghttp2_data_source *source, void *user_data);
+
+/**
+ * @functypedef
+ *
+ * Callback function invoked by `nghttp2_session_recv()` for each
+ * header name/value pair in the received HEADERS or PUSH_PROMISE
+ * frame |frame|. The |name| of length |namelen| is the header name,
+ * which is lower-cased, and the |value| of length |valuelen| is the
+ * header value. They are not NULL-terminated and point to the
+ * library's input buffer or header table, so they are only valid
+ * during this call. The application must copy them if it needs to
+ * keep them.
+ *
+ * If this callback is set, the library does not build the sorted
+ * name/value pair array for the received header block. Instead, this
+ * callback is invoked for each header in the order of decoding, just
+ * before :type:`nghttp2_on_frame_recv_callback` is invoked for the
+ * |frame|. The ``nva`` and ``nvlen`` members of the |frame| are
+ * ``NULL`` and 0 respectively. The headers are not sorted and the
+ * same name may appear more than once. If the frame is rejected
+ * (e.g., :type:`nghttp2_on_invalid_frame_recv_callback` is invoked),
+ * this callback is not invoked for the frame.
+ *
+ * The implementation of this function must return 0 if it
+ * succeeds. If nonzero is returned, it is treated as fatal error and
+ * `nghttp2_session_recv()` and `nghttp2_session_send()` functions
+ * immediately return :enum:`NGHTTP2_ERR_CALLBACK_FAILURE`.
+ */
+typedef int (*nghttp2_on_header_callback)
+(nghttp2_session *session, const nghttp2_frame *frame,
+ const uint8_t *name, size_t namelen,
+ const uint8_t *value, size_t valuelen,
+ void *user_data);
+
 /**
  * @struct
  *
@@ -1095,8 +1192,59 @@ typedef struct {
    * unknown.
    */
   nghttp2_on_unknown_frame_recv_callback on_unknown_frame_recv_callback;
+  /**
+   * Callback function invoked when DATA frame, whose payload was
+   * produced with :enum:`NGHTTP2_DATA_FLAG_NO_COPY`, is sent.
+   */
+  nghttp2_send_data_callback send_data_callback;
+  /**
+   * Callback function invoked for each header name/value pair in the
+   * received HEADERS or PUSH_PROMISE frame.
+   */
+  nghttp2_on_header_callback on_header_callback;
 } nghttp2_session_callbacks;
 
+/**
+ * @functypedef
+ *
+ * Custom memory allocator function to replace malloc(). The
+ * |mem_user_data| is the :member:`nghttp2_mem.mem_user_data`.
+ */
+typedef void* (*nghttp2_malloc)(size_t size, void *mem_user_data);
+
+/**
+ * @functypedef
+ *
+ * Custom memory allocator function to replace free(). The
+ * |mem_user_data| is the :member:`nghttp2_mem.mem_user_data`.
+ */
+typedef void (*nghttp2_free)(void *ptr, void *mem_user_data);
+
+/**
+ * @struct
+ *
+ * Custom memory allocator. The session uses it to allocate the
+ * session object itself, streams, outbound frames and their
+ * name/value pair arrays. In addition, the session keeps a free list
+ * of the fixed size objects (outbound queue items and frames), so
+ * that the allocator is not called per frame in steady state.
+ */
+typedef struct {
+  /**
+   * An arbitrary user supplied data. This is passed to each allocator
+   * function.
+   */
+  void *mem_user_data;
+  /**
+   * Custom allocator function to replace malloc().
+   */
+  nghttp2_malloc malloc;
+  /**
+   * Custom allocator function to replace free().
+   */
+  nghttp2_free free;
+} nghttp2_mem;
+
 /**
  * @function
  *
@@ -1143,6 +1291,44 @@ int nghttp2_session_server_new(nghttp2_session **session_ptr,
                                const nghttp2_session_callbacks *callbacks,
                                void *user_data);
 
+/**
+ * @function
+ *
+ * Like `nghttp2_session_client_new()`, but with additional custom
+ * memory allocator specified in the |mem|. The |mem| is copied to
+ * |*session_ptr|. If |mem| is ``NULL``, the standard malloc() and
+ * free() are used.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGHTTP2_ERR_NOMEM`
+ *     Out of memory.
+ */
+int nghttp2_session_client_new2(nghttp2_session **session_ptr,
+                                const nghttp2_session_callbacks *callbacks,
+                                void *user_data,
+                                const nghttp2_mem *mem);
+
+/**
+ * @function
+ *
+ * Like `nghttp2_session_server_new()`, but with additional custom
+ * memory allocator specified in the |mem|. The |mem| is copied to
+ * |*session_ptr|. If |mem| is ``NULL``, the standard malloc() and
+ * free() are used.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGHTTP2_ERR_NOMEM`
+ *     Out of memory.
+ */
+int nghttp2_session_server_new2(nghttp2_session **session_ptr,
+                                const nghttp2_session_callbacks *callbacks,
+                                void *user_data,
+                                const nghttp2_mem *mem);
+
 /**
  * @function
  *
@@ -1151,6 +1337,20 @@ int nghttp2_session_server_new(nghttp2_session **session_ptr,
  */
 void nghttp2_session_del(nghttp2_session *session);
 
+/**
+ * @function
+ *
+ * Releases the buffers and the cached objects of the |session| which
+ * are not in use at the moment, for example, to reduce the memory
+ * footprint of idle sessions. They are allocated again when they are
+ * needed. The header compression state and the streams are
+ * unaffected.
+ *
+ * This function must not be called from inside the callback
+ * functions.
+ */
+void nghttp2_session_shrink(nghttp2_session *session);
+
 /**
  * @enum
  *
@@ -1170,7 +1370,18 @@ typedef enum {
    * is responsible for sending WINDOW_UPDATE with stream ID 0 using
    * `nghttp2_submit_window_update`.
    */
-  NGHTTP2_OPT_NO_AUTO_CONNECTION_WINDOW_UPDATE = 2
+  NGHTTP2_OPT_NO_AUTO_CONNECTION_WINDOW_UPDATE = 2,
+  /**
+   * This option makes the library coalesce several outbound frames
+   * into one :member:`nghttp2_session_callbacks.send_callback`
+   * invocation.
+   */
+  NGHTTP2_OPT_SEND_BATCH_SIZE = 3,
+  /**
+   * This option makes the library share the connection bandwidth
+   * among the streams sending DATA in proportion to their priority.
+   */
+  NGHTTP2_OPT_FAIR_DATA_SCHEDULING = 4
 } nghttp2_opt;
 
 /**
@@ -1198,12 +1409,42 @@ typedef enum {
  *     sending WINDOW_UPDATE using
  *     `nghttp2_submit_window_update`. This option defaults to 0.
  *
+ * :enum:`NGHTTP2_OPT_SEND_BATCH_SIZE`
+ *     The |optval| must be a pointer to ``int``. If the |*optval| is
+ *     positive, `nghttp2_session_send()` serializes as many ready
+ *     frames as fit into the buffer of |*optval| bytes and passes them
+ *     to :member:`nghttp2_session_callbacks.send_callback` at once.
+ *     The frame larger than the buffer is sent as before. The
+ *     callbacks invoked after a frame is sent (e.g.,
+ *     :member:`nghttp2_session_callbacks.on_frame_send_callback`) are
+ *     called when the frame is stored in the buffer. If the |*optval|
+ *     is 0, frame coalescing is disabled. This option defaults to 0.
+ *
+ * :enum:`NGHTTP2_OPT_FAIR_DATA_SCHEDULING`
+ *     The |optval| must be a pointer to ``int``. If the |*optval| is
+ *     nonzero, DATA frames of the streams are sent in weighted round
+ *     robin manner instead of strictly by priority, so that a stream
+ *     with higher priority does not starve the others. The weight of
+ *     a stream is derived from its priority: the stream with priority
+ *     0 gets 32 times as much bandwidth as the stream with
+ *     :macro:`NGHTTP2_PRI_LOWEST` and 16 times as much as the stream
+ *     with :macro:`NGHTTP2_PRI_DEFAULT`. The streams with the same
+ *     priority share the bandwidth equally. Control frames are sent
+ *     before DATA frames in this mode. The option takes effect for
+ *     the DATA frames queued after this call. This option defaults
+ *     to 0.
+ *
  * This function returns 0 if it succeeds, or one of the following
  * negative error codes:
  *
  * :enum:`NGHTTP2_ERR_INVALID_ARGUMENT`
  *     The |optname| is not supported; or the |optval| and/or the
  *     |optlen| are invalid.
+ * :enum:`NGHTTP2_ERR_INVALID_STATE`
+ *     :enum:`NGHTTP2_OPT_SEND_BATCH_SIZE` is given while the buffer
+ *     still has data not sent yet.
+ * :enum:`NGHTTP2_ERR_NOMEM`
+ *     Out of memory.
  */
 int nghttp2_session_set_option(nghttp2_session *session,
                                int optname, void *optval, size_t optlen);
@@ -1234,7 +1475,11 @@ int nghttp2_session_set_option(nghttp2_session *session,
  * 5. :member:`nghttp2_session_callbacks.before_ctrl_send_callback` is
  *    invoked.
  * 6. :member:`nghttp2_session_callbacks.send_callback` is invoked one
- *    or more times to send the frame.
+ *    or more times to send the frame. If the frame is a DATA frame
+ *    whose payload is provided with
+ *    :enum:`NGHTTP2_DATA_FLAG_NO_COPY`,
+ *    :member:`nghttp2_session_callbacks.send_data_callback` is
+ *    invoked instead.
  * 7. If the frame is a control frame,
  *    :member:`nghttp2_session_callbacks.on_ctrl_send_callback` is
  *    invoked.
@@ -250,7 +250,7 @@ int nghttp2_frame_unpack_headers(nghttp2_headers *frame,
   if(r < 0) {
     return r;
   }
-  pnv_offset = headers_nv_offset(frame) - NGHTTP2_FRAME_HEAD_LENGTH;
+  pnv_offset = nghttp2_frame_headers_payload_nv_offset(frame);
   r = nghttp2_hd_inflate_hd(inflater, &frame->nva,
                             (uint8_t*)payload + pnv_offset,
                             payloadlen - pnv_offset);
@@ -261,6 +261,11 @@ int nghttp2_frame_unpack_headers(nghttp2_headers *frame,
   return 0;
 }
 
+size_t nghttp2_frame_headers_payload_nv_offset(nghttp2_headers *frame)
+{
+  return headers_nv_offset(frame) - NGHTTP2_FRAME_HEAD_LENGTH;
+}
+
 int nghttp2_frame_unpack_headers_without_nv(nghttp2_headers *frame,
                                             const uint8_t *head,
                                             size_t headlen,
@@ -445,7 +450,10 @@ int nghttp2_frame_unpack_push_promise(nghttp2_push_promise *frame,
     return r;
   }
   r = nghttp2_hd_inflate_hd(inflater, &frame->nva,
-                            (uint8_t*)payload + 4, payloadlen - 4);
+                            (uint8_t*)payload +
+                            NGHTTP2_PUSH_PROMISE_PAYLOAD_NV_OFFSET,
+                            payloadlen -
+                            NGHTTP2_PUSH_PROMISE_PAYLOAD_NV_OFFSET);
   if(r < 0) {
     return r;
   }
@@ -609,6 +617,13 @@ void nghttp2_nv_array_del(nghttp2_nv *nva)
   free(nva);
 }
 
+void nghttp2_nv_array_del_mem(nghttp2_nv *nva, nghttp2_mem *mem)
+{
+  if(nva) {
+    nghttp2_mem_free(mem, nva);
+  }
+}
+
 static int nghttp2_nv_name_compar(const void *lhs, const void *rhs)
 {
   nghttp2_nv *a = (nghttp2_nv*)lhs, *b = (nghttp2_nv*)rhs;
@@ -642,6 +657,12 @@ void nghttp2_nv_array_sort(nghttp2_nv *nva, size_t nvlen)
 }
 
 ssize_t nghttp2_nv_array_from_cstr(nghttp2_nv **nva_ptr, const char **nv)
+{
+  return nghttp2_nv_array_from_cstr_mem(nva_ptr, nv, nghttp2_mem_default());
+}
+
+ssize_t nghttp2_nv_array_from_cstr_mem(nghttp2_nv **nva_ptr, const char **nv,
+                                       nghttp2_mem *mem)
 {
   int i;
   uint8_t *data;
@@ -661,7 +682,7 @@ ssize_t nghttp2_nv_array_from_cstr(nghttp2_nv **nva_ptr, const char **nv)
     return 0;
   }
   buflen += sizeof(nghttp2_nv)*nvlen;
-  *nva_ptr = malloc(buflen);
+  *nva_ptr = nghttp2_mem_malloc(mem, buflen);
   if(*nva_ptr == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
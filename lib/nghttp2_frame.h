@@ -32,6 +32,7 @@
 #include <nghttp2/nghttp2.h>
 #include "nghttp2_hd.h"
 #include "nghttp2_buffer.h"
+#include "nghttp2_mem.h"
 
 /* The maximum payload length of a frame */
 #define NGHTTP2_MAX_FRAME_LENGTH ((1 << 16) - 1)
@@ -56,6 +57,10 @@
 /* The number of bytes of frame header. */
 #define NGHTTP2_FRAME_HEAD_LENGTH 8
 
+/* The offset of the name/value header block in the payload of
+   PUSH_PROMISE frame */
+#define NGHTTP2_PUSH_PROMISE_PAYLOAD_NV_OFFSET 4
+
 /* Category of frames. */
 typedef enum {
   /* non-DATA frame */
@@ -76,6 +81,13 @@ typedef struct {
    * exclusively by nghttp2 library and not in the spec.
    */
   uint8_t eof;
+  /**
+   * Nonzero if the payload of the last packed DATA frame was not
+   * copied into the frame buffer because the read callback set
+   * NGHTTP2_DATA_FLAG_NO_COPY. The payload is sent by
+   * send_data_callback.
+   */
+  uint8_t no_copy;
   /**
    * The data to be sent for this DATA frame.
    */
@@ -142,6 +154,12 @@ int nghttp2_frame_unpack_headers(nghttp2_headers *frame,
                                  const uint8_t *payload, size_t payloadlen,
                                  nghttp2_hd_context *inflater);
 
+/*
+ * Returns the offset of the name/value header block in the payload
+ * of the HEADERS frame |frame|. The |frame->hd| must be initialized.
+ */
+size_t nghttp2_frame_headers_payload_nv_offset(nghttp2_headers *frame);
+
 /*
  * Unpacks HEADERS frame byte sequence into |frame|. This function
  * only unapcks bytes that come before name/value header block.
@@ -547,6 +565,14 @@ void nghttp2_nv_array_sort(nghttp2_nv *nva, size_t nvlen);
  */
 ssize_t nghttp2_nv_array_from_cstr(nghttp2_nv **nva_ptr, const char **nv);
 
+/*
+ * Like nghttp2_nv_array_from_cstr(), but |*nva_ptr| is allocated by
+ * |mem|. The result must be freed by nghttp2_nv_array_del_mem() with
+ * the same |mem|.
+ */
+ssize_t nghttp2_nv_array_from_cstr_mem(nghttp2_nv **nva_ptr, const char **nv,
+                                       nghttp2_mem *mem);
+
 /*
  * Returns nonzero if the name/value pair |a| equals to |b|. The name
  * is compared in case-sensitive, because we ensure that this function
@@ -559,6 +585,11 @@ int nghttp2_nv_equal(const nghttp2_nv *a, const nghttp2_nv *b);
  */
 void nghttp2_nv_array_del(nghttp2_nv *nva);
 
+/*
+ * Frees |nva| allocated by |mem|.
+ */
+void nghttp2_nv_array_del_mem(nghttp2_nv *nva, nghttp2_mem *mem);
+
 /*
  * Checks names are not empty string and do not contain control
  * characters and values are not NULL. This function allows captital
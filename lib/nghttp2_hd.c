@@ -98,10 +98,18 @@ static const char *reshd_table[] = {
   NULL
 };
 
+/* The initial value of FNV-1a hash */
+#define NGHTTP2_HD_HASH_INIT 2166136261u
+
 typedef struct {
   nghttp2_nv *nva;
   size_t nvacap;
+  /* The number of name/value pairs emitted so far */
   size_t nvlen;
+  /* If non-NULL, each name/value pair is passed to this function
+     instead of being appended to |nva|. */
+  nghttp2_hd_emit_callback emit_cb;
+  void *emit_arg;
 } nghttp2_nva_out;
 
 int nghttp2_hd_entry_init(nghttp2_hd_entry *ent, uint8_t index, uint8_t flags,
@@ -162,6 +170,74 @@ void nghttp2_hd_entry_free(nghttp2_hd_entry *ent)
   }
 }
 
+static uint32_t hash(uint32_t h, const uint8_t *s, size_t len)
+{
+  /* FNV-1a */
+  for(; len > 0; --len) {
+    h ^= *s++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/*
+ * Computes the hash value of the name of |nv| and the hash value of
+ * the name/value pair of |nv|, and stores them in |*name_hash_ptr| and
+ * |*nv_hash_ptr| respectively.
+ */
+static void hash_nv(uint32_t *name_hash_ptr, uint32_t *nv_hash_ptr,
+                    nghttp2_nv *nv)
+{
+  *name_hash_ptr = hash(NGHTTP2_HD_HASH_INIT, nv->name, nv->namelen);
+  *nv_hash_ptr = hash(*name_hash_ptr, nv->value, nv->valuelen);
+}
+
+/*
+ * Adds |ent| to the hash index of the |context|. If the |context| has
+ * no hash index (e.g., inflater), this function does nothing.
+ */
+static void hd_map_insert(nghttp2_hd_context *context, nghttp2_hd_entry *ent)
+{
+  nghttp2_hd_entry **bucket;
+  if(context->nv_map == NULL) {
+    return;
+  }
+  hash_nv(&ent->name_hash, &ent->nv_hash, &ent->nv);
+  bucket = &context->nv_map[ent->nv_hash & (NGHTTP2_HD_MAP_SIZE - 1)];
+  ent->nv_next = *bucket;
+  *bucket = ent;
+  bucket = &context->name_map[ent->name_hash & (NGHTTP2_HD_MAP_SIZE - 1)];
+  ent->name_next = *bucket;
+  *bucket = ent;
+}
+
+/*
+ * Removes |ent| from the hash index of the |context|. If the
+ * |context| has no hash index (e.g., inflater), this function does
+ * nothing.
+ */
+static void hd_map_remove(nghttp2_hd_context *context, nghttp2_hd_entry *ent)
+{
+  nghttp2_hd_entry **p;
+  if(context->nv_map == NULL) {
+    return;
+  }
+  for(p = &context->nv_map[ent->nv_hash & (NGHTTP2_HD_MAP_SIZE - 1)]; *p;
+      p = &(*p)->nv_next) {
+    if(*p == ent) {
+      *p = ent->nv_next;
+      break;
+    }
+  }
+  for(p = &context->name_map[ent->name_hash & (NGHTTP2_HD_MAP_SIZE - 1)]; *p;
+      p = &(*p)->name_next) {
+    if(*p == ent) {
+      *p = ent->name_next;
+      break;
+    }
+  }
+}
+
 static int nghttp2_hd_context_init(nghttp2_hd_context *context,
                                    nghttp2_hd_role role,
                                    nghttp2_hd_side side)
@@ -181,18 +257,25 @@ static int nghttp2_hd_context_init(nghttp2_hd_context *context,
   context->hd_tablelen = 0;
 
   if(role == NGHTTP2_HD_ROLE_INFLATE) {
-    context->emit_set = malloc(sizeof(nghttp2_hd_entry*)*
-                               NGHTTP2_INITIAL_EMIT_SET_SIZE);
-    if(context->emit_set == NULL) {
-      free(context->hd_table);
-      return NGHTTP2_ERR_NOMEM;
-    }
-    memset(context->emit_set, 0, sizeof(nghttp2_hd_entry*)*
-           NGHTTP2_INITIAL_EMIT_SET_SIZE);
+    /* emit_set is allocated when the first entry is added to it. */
+    context->emit_set = NULL;
     context->emit_set_capacity = NGHTTP2_INITIAL_EMIT_SET_SIZE;
+    context->nv_map = NULL;
+    context->name_map = NULL;
   } else {
     context->emit_set = NULL;
     context->emit_set_capacity = 0;
+    context->nv_map = malloc(sizeof(nghttp2_hd_entry*)*NGHTTP2_HD_MAP_SIZE);
+    context->name_map = malloc(sizeof(nghttp2_hd_entry*)*NGHTTP2_HD_MAP_SIZE);
+    if(context->nv_map == NULL || context->name_map == NULL) {
+      free(context->name_map);
+      free(context->nv_map);
+      free(context->hd_table);
+      return NGHTTP2_ERR_NOMEM;
+    }
+    memset(context->nv_map, 0, sizeof(nghttp2_hd_entry*)*NGHTTP2_HD_MAP_SIZE);
+    memset(context->name_map, 0,
+           sizeof(nghttp2_hd_entry*)*NGHTTP2_HD_MAP_SIZE);
   }
   context->emit_setlen = 0;
 
@@ -209,6 +292,8 @@ static int nghttp2_hd_context_init(nghttp2_hd_context *context,
         nghttp2_hd_entry_free(context->hd_table[i]);
         free(context->hd_table[i]);
       }
+      free(context->name_map);
+      free(context->nv_map);
       free(context->emit_set);
       free(context->hd_table);
       return NGHTTP2_ERR_NOMEM;
@@ -218,6 +303,7 @@ static int nghttp2_hd_context_init(nghttp2_hd_context *context,
                           (uint8_t*)ini_table[i + 1],
                           strlen(ini_table[i+1]));
     context->hd_table[context->hd_tablelen++] = p;
+    hd_map_insert(context, p);
     context->hd_table_bufsize += NGHTTP2_HD_ENTRY_OVERHEAD +
       p->nv.namelen + p->nv.valuelen;
   }
@@ -250,6 +336,8 @@ static void nghttp2_hd_context_free(nghttp2_hd_context *context)
     nghttp2_hd_entry_free(ent);
     free(ent);
   }
+  free(context->name_map);
+  free(context->nv_map);
   free(context->emit_set);
   free(context->hd_table);
 }
@@ -274,6 +362,15 @@ static int add_nva(nghttp2_nva_out *nva_out_ptr,
                    uint8_t *value, uint16_t valuelen)
 {
   nghttp2_nv *nv;
+  if(nva_out_ptr->emit_cb) {
+    nghttp2_nv nvbuf;
+    nvbuf.name = name;
+    nvbuf.namelen = namelen;
+    nvbuf.value = value;
+    nvbuf.valuelen = valuelen;
+    ++nva_out_ptr->nvlen;
+    return nva_out_ptr->emit_cb(&nvbuf, nva_out_ptr->emit_arg);
+  }
   if(nva_out_ptr->nvacap == nva_out_ptr->nvlen) {
     size_t newcap = nva_out_ptr->nvacap == 0 ? 16 : nva_out_ptr->nvacap * 2;
     nghttp2_nv *new_nva = realloc(nva_out_ptr->nva, sizeof(nghttp2_nv)*newcap);
@@ -296,6 +393,13 @@ static int add_emit_set(nghttp2_hd_context *context, nghttp2_hd_entry *ent)
   if(context->emit_setlen == context->emit_set_capacity) {
     return NGHTTP2_ERR_HEADER_COMP;
   }
+  if(context->emit_set == NULL) {
+    context->emit_set = malloc(sizeof(nghttp2_hd_entry*)*
+                               context->emit_set_capacity);
+    if(context->emit_set == NULL) {
+      return NGHTTP2_ERR_NOMEM;
+    }
+  }
   context->emit_set[context->emit_setlen++] = ent;
   ++ent->ref;
   return 0;
@@ -602,6 +706,7 @@ static nghttp2_hd_entry* add_hd_table_incremental(nghttp2_hd_context *context,
         return NULL;
       }
     }
+    hd_map_remove(context, ent);
     ent->index = NGHTTP2_HD_INVALID_INDEX;
     if(--ent->ref == 0) {
       nghttp2_hd_entry_free(ent);
@@ -640,6 +745,7 @@ static nghttp2_hd_entry* add_hd_table_incremental(nghttp2_hd_context *context,
        context->hd_table_capacity. */
     assert(context->hd_tablelen < context->hd_table_capacity);
     context->hd_table[context->hd_tablelen++] = new_ent;
+    hd_map_insert(context, new_ent);
     new_ent->flags |= NGHTTP2_HD_FLAG_REFSET;
   }
   return new_ent;
@@ -672,6 +778,7 @@ static nghttp2_hd_entry* add_hd_table_subst(nghttp2_hd_context *context,
       context->hd_table_bufsize -= entry_room(ent->nv.namelen,
                                               ent->nv.valuelen);
     }
+    hd_map_remove(context, ent);
     ent->index = NGHTTP2_HD_INVALID_INDEX;
     if(--ent->ref == 0) {
       nghttp2_hd_entry_free(ent);
@@ -700,6 +807,7 @@ static nghttp2_hd_entry* add_hd_table_subst(nghttp2_hd_context *context,
   }
   if(k >= 0) {
     nghttp2_hd_entry *ent = context->hd_table[k];
+    hd_map_remove(context, ent);
     ent->index = NGHTTP2_HD_INVALID_INDEX;
     if(--ent->ref == 0) {
       nghttp2_hd_entry_free(ent);
@@ -722,36 +830,52 @@ static nghttp2_hd_entry* add_hd_table_subst(nghttp2_hd_context *context,
     context->hd_tablelen = 0;
   } else {
     context->hd_table[new_ent->index] = new_ent;
+    hd_map_insert(context, new_ent);
     new_ent->flags |= NGHTTP2_HD_FLAG_REFSET;
   }
   return new_ent;
 }
 
-static nghttp2_hd_entry* find_in_hd_table(nghttp2_hd_context *context,
-                                          nghttp2_nv *nv)
+/*
+ * Returns the entry in the header table of the |deflater| which has
+ * the same name/value pair with |nv|, whose hash value is |nv_hash|.
+ * If there are several such entries, the one with the smallest index
+ * is returned. If there is no such entry, returns NULL.
+ */
+static nghttp2_hd_entry* find_in_hd_table(nghttp2_hd_context *deflater,
+                                          nghttp2_nv *nv, uint32_t nv_hash)
 {
-  size_t i;
-  for(i = 0; i < context->hd_tablelen; ++i) {
-    nghttp2_hd_entry *ent = context->hd_table[i];
-    if(nghttp2_nv_equal(&ent->nv, nv)) {
-      return ent;
+  nghttp2_hd_entry *ent, *res = NULL;
+  for(ent = deflater->nv_map[nv_hash & (NGHTTP2_HD_MAP_SIZE - 1)]; ent;
+      ent = ent->nv_next) {
+    if(ent->nv_hash == nv_hash && nghttp2_nv_equal(&ent->nv, nv) &&
+       (res == NULL || res->index > ent->index)) {
+      res = ent;
     }
   }
-  return NULL;
+  return res;
 }
 
-static nghttp2_hd_entry* find_name_in_hd_table(nghttp2_hd_context *context,
-                                               nghttp2_nv *nv)
+/*
+ * Returns the entry in the header table of the |deflater| which has
+ * the same name with |nv|, whose hash value is |name_hash|.  If there
+ * are several such entries, the one with the smallest index is
+ * returned. If there is no such entry, returns NULL.
+ */
+static nghttp2_hd_entry* find_name_in_hd_table(nghttp2_hd_context *deflater,
+                                               nghttp2_nv *nv,
+                                               uint32_t name_hash)
 {
-  size_t i;
-  for(i = 0; i < context->hd_tablelen; ++i) {
-    nghttp2_hd_entry *ent = context->hd_table[i];
-    if(ent->nv.namelen == nv->namelen &&
-       memcmp(ent->nv.name, nv->name, nv->namelen) == 0) {
-      return ent;
+  nghttp2_hd_entry *ent, *res = NULL;
+  for(ent = deflater->name_map[name_hash & (NGHTTP2_HD_MAP_SIZE - 1)]; ent;
+      ent = ent->name_next) {
+    if(ent->name_hash == name_hash && ent->nv.namelen == nv->namelen &&
+       memcmp(ent->nv.name, nv->name, nv->namelen) == 0 &&
+       (res == NULL || res->index > ent->index)) {
+      res = ent;
     }
   }
-  return NULL;
+  return res;
 }
 
 static int deflate_nv(nghttp2_hd_context *deflater,
@@ -761,7 +885,9 @@ static int deflate_nv(nghttp2_hd_context *deflater,
 {
   int rv;
   nghttp2_hd_entry *ent;
-  ent = find_in_hd_table(deflater, nv);
+  uint32_t name_hash, nv_hash;
+  hash_nv(&name_hash, &nv_hash, nv);
+  ent = find_in_hd_table(deflater, nv, nv_hash);
   if(ent) {
     if((ent->flags & NGHTTP2_HD_FLAG_REFSET) == 0) {
       ent->flags |= NGHTTP2_HD_FLAG_REFSET | NGHTTP2_HD_FLAG_EMIT;
@@ -804,7 +930,7 @@ static int deflate_nv(nghttp2_hd_context *deflater,
   } else {
     uint8_t index = NGHTTP2_HD_INVALID_INDEX;
     int incidx = 0;
-    ent = find_name_in_hd_table(deflater, nv);
+    ent = find_name_in_hd_table(deflater, nv, name_hash);
     if(ent) {
       index = ent->index;
     }
@@ -866,19 +992,31 @@ ssize_t nghttp2_hd_deflate_hd(nghttp2_hd_context *deflater,
   return rv;
 }
 
-ssize_t nghttp2_hd_inflate_hd(nghttp2_hd_context *inflater,
-                              nghttp2_nv **nva_ptr,
-                              uint8_t *in, size_t inlen)
+/*
+ * Inflates |in| of length |inlen| and emits each name/value pair to
+ * |nva_out|. On failure, the caller is responsible for freeing
+ * |nva_out->nva|.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory.
+ * NGHTTP2_ERR_HEADER_COMP
+ *     Inflation process has failed.
+ *
+ * It also returns the error code returned by |nva_out->emit_cb|.
+ */
+static int inflate_hd(nghttp2_hd_context *inflater,
+                      nghttp2_nva_out *nva_out,
+                      uint8_t *in, size_t inlen)
 {
   size_t i;
   int rv = 0;
   uint8_t *last = in + inlen;
-  nghttp2_nva_out nva_out;
-  memset(&nva_out, 0, sizeof(nva_out));
   if(inflater->bad) {
     return NGHTTP2_ERR_HEADER_COMP;
   }
-  *nva_ptr = NULL;
   for(; in != last;) {
     uint8_t c = *in;
     if(c & 0x80u) {
@@ -897,7 +1035,7 @@ ssize_t nghttp2_hd_inflate_hd(nghttp2_hd_context *inflater,
       ent = inflater->hd_table[index];
       ent->flags ^= NGHTTP2_HD_FLAG_REFSET;
       if(ent->flags & NGHTTP2_HD_FLAG_REFSET) {
-        rv = emit_indexed_header(inflater, &nva_out, ent);
+        rv = emit_indexed_header(inflater, nva_out, ent);
         if(rv != 0) {
           goto fail;
         }
@@ -939,7 +1077,7 @@ ssize_t nghttp2_hd_inflate_hd(nghttp2_hd_context *inflater,
       in += valuelen;
       nghttp2_downcase(nv.name, nv.namelen);
       if(c == 0x60u) {
-        rv = emit_newname_header(inflater, &nva_out, &nv);
+        rv = emit_newname_header(inflater, nva_out, &nv);
       } else {
         nghttp2_hd_entry *new_ent;
         if(c == 0) {
@@ -948,7 +1086,7 @@ ssize_t nghttp2_hd_inflate_hd(nghttp2_hd_context *inflater,
           new_ent = add_hd_table_incremental(inflater, NULL, NULL, NULL, &nv);
         }
         if(new_ent) {
-          rv = emit_indexed_header(inflater, &nva_out, new_ent);
+          rv = emit_indexed_header(inflater, nva_out, new_ent);
         } else {
           rv = NGHTTP2_ERR_HEADER_COMP;
         }
@@ -987,7 +1125,7 @@ ssize_t nghttp2_hd_inflate_hd(nghttp2_hd_context *inflater,
       value = in;
       in += valuelen;
       if((c & 0x60u) == 0x60u) {
-        rv = emit_indname_header(inflater, &nva_out, ent, value, valuelen);
+        rv = emit_indname_header(inflater, nva_out, ent, value, valuelen);
       } else {
         nghttp2_nv nv;
         nghttp2_hd_entry *new_ent;
@@ -1006,7 +1144,7 @@ ssize_t nghttp2_hd_inflate_hd(nghttp2_hd_context *inflater,
           free(ent);
         }
         if(new_ent) {
-          rv = emit_indexed_header(inflater, &nva_out, new_ent);
+          rv = emit_indexed_header(inflater, nva_out, new_ent);
         } else {
           rv = NGHTTP2_ERR_HEADER_COMP;
         }
@@ -1020,22 +1158,54 @@ ssize_t nghttp2_hd_inflate_hd(nghttp2_hd_context *inflater,
     nghttp2_hd_entry *ent = inflater->hd_table[i];
     if((ent->flags & NGHTTP2_HD_FLAG_REFSET) &&
        (ent->flags & NGHTTP2_HD_FLAG_EMIT) == 0) {
-      rv = emit_indexed_header(inflater, &nva_out, ent);
+      rv = emit_indexed_header(inflater, nva_out, ent);
       if(rv != 0) {
         goto fail;
       }
     }
     ent->flags &= ~NGHTTP2_HD_FLAG_EMIT;
   }
-  nghttp2_nv_array_sort(nva_out.nva, nva_out.nvlen);
-  *nva_ptr = nva_out.nva;
-  return nva_out.nvlen;
+  return 0;
  fail:
   inflater->bad = 1;
-  free(nva_out.nva);
   return rv;
 }
 
+ssize_t nghttp2_hd_inflate_hd(nghttp2_hd_context *inflater,
+                              nghttp2_nv **nva_ptr,
+                              uint8_t *in, size_t inlen)
+{
+  int rv;
+  nghttp2_nva_out nva_out;
+  memset(&nva_out, 0, sizeof(nva_out));
+  *nva_ptr = NULL;
+  rv = inflate_hd(inflater, &nva_out, in, inlen);
+  if(rv != 0) {
+    free(nva_out.nva);
+    return rv;
+  }
+  nghttp2_nv_array_sort(nva_out.nva, nva_out.nvlen);
+  *nva_ptr = nva_out.nva;
+  return nva_out.nvlen;
+}
+
+ssize_t nghttp2_hd_inflate_hd_emit(nghttp2_hd_context *inflater,
+                                   uint8_t *in, size_t inlen,
+                                   nghttp2_hd_emit_callback emit_cb,
+                                   void *emit_arg)
+{
+  int rv;
+  nghttp2_nva_out nva_out;
+  memset(&nva_out, 0, sizeof(nva_out));
+  nva_out.emit_cb = emit_cb;
+  nva_out.emit_arg = emit_arg;
+  rv = inflate_hd(inflater, &nva_out, in, inlen);
+  if(rv != 0) {
+    return rv;
+  }
+  return nva_out.nvlen;
+}
+
 int nghttp2_hd_end_headers(nghttp2_hd_context *context)
 {
   size_t i;
@@ -1050,6 +1220,14 @@ int nghttp2_hd_end_headers(nghttp2_hd_context *context)
   return 0;
 }
 
+void nghttp2_hd_shrink(nghttp2_hd_context *context)
+{
+  if(context->emit_setlen == 0) {
+    free(context->emit_set);
+    context->emit_set = NULL;
+  }
+}
+
 int nghttp2_hd_emit_indname_block(uint8_t **buf_ptr, size_t *buflen_ptr,
                                   size_t *offset_ptr, size_t index,
                                   const uint8_t *value, size_t valuelen,
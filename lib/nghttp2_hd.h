@@ -33,6 +33,11 @@
 
 #define NGHTTP2_INITIAL_HD_TABLE_SIZE 128
 #define NGHTTP2_INITIAL_EMIT_SET_SIZE 128
+/* The number of buckets in the deflater's header table hash
+   index. This must be power of 2. The header table holds at most
+   NGHTTP2_HD_MAX_BUFFER_SIZE / NGHTTP2_HD_ENTRY_OVERHEAD = 128
+   entries, so the load factor stays at most 1. */
+#define NGHTTP2_HD_MAP_SIZE 128
 
 #define NGHTTP2_HD_MAX_BUFFER_SIZE 4096
 #define NGHTTP2_HD_MAX_ENTRY_SIZE 3072
@@ -66,8 +71,15 @@ typedef enum {
   NGHTTP2_HD_FLAG_IMPLICIT_EMIT = 1 << 4
 } nghttp2_hd_flags;
 
-typedef struct {
+typedef struct nghttp2_hd_entry {
   nghttp2_nv nv;
+  /* The next entry in the same bucket of the name/value hash index
+     and of the name only hash index respectively. Only used by
+     deflater. */
+  struct nghttp2_hd_entry *nv_next, *name_next;
+  /* The hash value of name/value pair and of name only. Only used by
+     deflater. */
+  uint32_t nv_hash, name_hash;
   /* Reference count */
   uint8_t ref;
   /* Index in the header table */
@@ -81,6 +93,11 @@ typedef struct {
   /* Holding emitted entry in deflating header block to retain
      reference count. */
   nghttp2_hd_entry **emit_set;
+  /* Hash index of the entries in |hd_table| keyed by name/value pair
+     and by name only. Both have NGHTTP2_HD_MAP_SIZE buckets. They are
+     only allocated for deflater and NULL for inflater. */
+  nghttp2_hd_entry **nv_map;
+  nghttp2_hd_entry **name_map;
   /* The capacity of the |hd_table| */
   uint16_t hd_table_capacity;
   /* The number of entry the |hd_table| contains */
@@ -208,6 +225,44 @@ ssize_t nghttp2_hd_inflate_hd(nghttp2_hd_context *inflater,
                               nghttp2_nv **nva_ptr,
                               uint8_t *in, size_t inlen);
 
+/*
+ * The callback function invoked by nghttp2_hd_inflate_hd_emit() for
+ * each inflated name/value pair |nv|. The |arg| is the pointer passed
+ * to nghttp2_hd_inflate_hd_emit(). The |nv| and the memory region it
+ * points to are only valid during the invocation. It must return 0
+ * if it succeeds, or negative error code. The negative error code
+ * aborts inflation, makes |inflater| unusable and is returned from
+ * nghttp2_hd_inflate_hd_emit().
+ */
+typedef int (*nghttp2_hd_emit_callback)(nghttp2_nv *nv, void *arg);
+
+/*
+ * Inflates name/value block stored in |in| with length |inlen| like
+ * nghttp2_hd_inflate_hd(), but instead of building name/value pair
+ * array, passes each name/value pair to |emit_cb| in the order they
+ * are decoded, followed by the ones implicitly emitted from the
+ * reference set. The name/value pairs are not sorted. The names and
+ * values point to the memory region in |in| or in the header table.
+ *
+ * As with nghttp2_hd_inflate_hd(), the caller must call
+ * nghttp2_hd_end_headers() after the header block is processed.
+ *
+ * This function returns the number of name/value pairs emitted if it
+ * succeeds, or one of the following negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory.
+ * NGHTTP2_ERR_HEADER_COMP
+ *     Inflation process has failed.
+ *
+ * If |emit_cb| returns negative error code, this function returns
+ * it.
+ */
+ssize_t nghttp2_hd_inflate_hd_emit(nghttp2_hd_context *inflater,
+                                   uint8_t *in, size_t inlen,
+                                   nghttp2_hd_emit_callback emit_cb,
+                                   void *emit_arg);
+
 /*
  * Signals the end of processing one header block.
  *
@@ -216,6 +271,14 @@ ssize_t nghttp2_hd_inflate_hd(nghttp2_hd_context *inflater,
  */
 int nghttp2_hd_end_headers(nghttp2_hd_context *deflater_or_inflater);
 
+/*
+ * Releases the memory which is only needed while a header block is
+ * processed. It is allocated again on demand. The header table is
+ * left intact. This function must not be called between the
+ * processing of a header block and nghttp2_hd_end_headers().
+ */
+void nghttp2_hd_shrink(nghttp2_hd_context *deflater_or_inflater);
+
 /* For unittesting purpose */
 int nghttp2_hd_emit_indname_block(uint8_t **buf_ptr, size_t *buflen_ptr,
                                   size_t *offset_ptr, size_t index,
@@ -24,109 +24,53 @@
  */
 #include "nghttp2_map.h"
 
-void nghttp2_map_init(nghttp2_map *map)
-{
-  map->root = NULL;
-  map->size = 0;
-}
-
-void nghttp2_map_free(nghttp2_map *map)
-{
-  map->root = NULL;
-}
+#include <stdlib.h>
 
-/* Find left most node, which is not necessarily a leaf. */
-static nghttp2_map_entry* find_left_most(nghttp2_map_entry *entry)
+int nghttp2_map_init(nghttp2_map *map)
 {
-  while(entry->left) {
-    entry = entry->left;
+  map->tablelen = NGHTTP2_INITIAL_TABLE_LENGTH;
+  map->table = calloc(map->tablelen, sizeof(nghttp2_map_entry*));
+  if(map->table == NULL) {
+    return NGHTTP2_ERR_NOMEM;
   }
-  return entry;
-}
-
-/* Find left most leaf. */
-static nghttp2_map_entry* find_left_most_leaf(nghttp2_map_entry *entry)
-{
-  for(;;) {
-    entry = find_left_most(entry);
-    if(entry->right) {
-      entry = entry->right;
-    } else {
-      break;
-    }
-  }
-  return entry;
+  map->size = 0;
+  return 0;
 }
 
-/* Returns next node in postorder traversal. Returns NULL if there is
-   no next node. */
-static nghttp2_map_entry* traverse_postorder(nghttp2_map_entry *parent,
-                                             nghttp2_map_entry *entry)
+void nghttp2_map_free(nghttp2_map *map)
 {
-  if(!parent) {
-    return NULL;
-  }
-  if(parent->left == entry) {
-    if(parent->right) {
-      return find_left_most_leaf(parent->right);
-    } else {
-      return parent;
-    }
-  } else {
-    return parent;
-  }
+  free(map->table);
+  map->table = NULL;
+  map->tablelen = 0;
+  map->size = 0;
 }
 
 void nghttp2_map_each_free(nghttp2_map *map,
                            int (*func)(nghttp2_map_entry *entry, void *ptr),
                            void *ptr)
 {
-  nghttp2_map_entry *entry;
-  if(!map->root) {
-    return;
-  }
-  entry = find_left_most_leaf(map->root);
-  while(entry) {
-    nghttp2_map_entry *parent = entry->parent;
-    /* Ignore return value. */
-    func(entry, ptr);
-    /* entry has been deleted. */
-    entry = traverse_postorder(parent, entry);
-  }
-  map->root = NULL;
-}
-
-/* Returns next node in inorder traversal. Returns NULL if there is no
-   next node. */
-static nghttp2_map_entry* traverse_inorder(nghttp2_map_entry *entry)
-{
-  nghttp2_map_entry *parent;
-  if(entry->right) {
-    return find_left_most(entry->right);
-  }
-  parent = entry->parent;
-  while(parent && parent->right == entry) {
-    entry = entry->parent;
-    parent = parent->parent;
+  size_t i;
+  for(i = 0; i < map->tablelen; ++i) {
+    if(map->table[i]) {
+      /* Ignore return value. */
+      func(map->table[i], ptr);
+    }
   }
-  return parent;
+  nghttp2_map_free(map);
 }
 
 int nghttp2_map_each(nghttp2_map *map,
                      int (*func)(nghttp2_map_entry *entry, void *ptr),
                      void *ptr)
 {
-  nghttp2_map_entry *entry;
-  if(!map->root) {
-    return 0;
-  }
-  entry = find_left_most(map->root);
-  while(entry) {
-    int rv = func(entry, ptr);
-    if(rv != 0) {
-      return rv;
+  size_t i;
+  for(i = 0; i < map->tablelen; ++i) {
+    if(map->table[i]) {
+      int rv = func(map->table[i], ptr);
+      if(rv != 0) {
+        return rv;
+      }
     }
-    entry = traverse_inorder(entry);
   }
   return 0;
 }
@@ -147,185 +91,131 @@ static uint32_t hash32shift(uint32_t key)
   return key;
 }
 
+/* Returns the home slot of the |key| in the table of length
+   |tablelen|. */
+static size_t hash(key_type key, size_t tablelen)
+{
+  return hash32shift(key) & (tablelen - 1);
+}
+
 void nghttp2_map_entry_init(nghttp2_map_entry *entry, key_type key)
 {
   entry->key = key;
-  entry->parent = entry->left = entry->right = NULL;
-  entry->priority = hash32shift(key);
 }
 
-static nghttp2_map_entry* rotate_left(nghttp2_map_entry *entry)
+/* Inserts |entry| to the |table| of length |tablelen|. The |entry|
+   must not exist in |table| and |table| must have at least one empty
+   slot. */
+static void insert(nghttp2_map_entry **table, size_t tablelen,
+                   nghttp2_map_entry *entry)
 {
-  nghttp2_map_entry *root = entry->right;
-  entry->right = root->left;
-  root->left = entry;
-
-  root->parent = entry->parent;
-  entry->parent = root;
-  if(root->parent) {
-    if(root->parent->left == entry) {
-      root->parent->left = root;
-    } else {
-      root->parent->right = root;
-    }
+  size_t i = hash(entry->key, tablelen);
+  while(table[i]) {
+    i = (i + 1) & (tablelen - 1);
   }
-  if(entry->right) {
-    entry->right->parent = entry;
-  }
-  return root;
+  table[i] = entry;
 }
 
-static nghttp2_map_entry* rotate_right(nghttp2_map_entry* entry)
+/*
+ * Resizes the table of the |map| to |new_tablelen| slots and
+ * reinserts all entries.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory
+ */
+static int resize(nghttp2_map *map, size_t new_tablelen)
 {
-  nghttp2_map_entry *root = entry->left;
-  entry->left = root->right;
-  root->right = entry;
-
-  root->parent = entry->parent;
-  entry->parent = root;
-  if(root->parent) {
-    if(root->parent->left == entry) {
-      root->parent->left = root;
-    } else {
-      root->parent->right = root;
-    }
+  size_t i;
+  nghttp2_map_entry **new_table;
+  new_table = calloc(new_tablelen, sizeof(nghttp2_map_entry*));
+  if(new_table == NULL) {
+    return NGHTTP2_ERR_NOMEM;
   }
-  if(entry->left) {
-    entry->left->parent = entry;
+  for(i = 0; i < map->tablelen; ++i) {
+    if(map->table[i]) {
+      insert(new_table, new_tablelen, map->table[i]);
+    }
   }
-  return root;
+  free(map->table);
+  map->table = new_table;
+  map->tablelen = new_tablelen;
+  return 0;
 }
 
-int nghttp2_map_insert(nghttp2_map *map, nghttp2_map_entry *new_entry)
+/* Returns the slot index of the entry associated by the |key|, or -1
+   if there is no such entry. */
+static ssize_t find_slot(nghttp2_map *map, key_type key)
 {
-  nghttp2_map_entry *entry = map->root, *parent = NULL;
-  if(map->root == NULL) {
-    map->root = new_entry;
-    map->size = 1;
-    return 0;
+  size_t i;
+  if(map->size == 0) {
+    return -1;
   }
-  /* Find position to insert. */
-  while(1) {
-    if(new_entry->key == entry->key) {
-      return NGHTTP2_ERR_INVALID_ARGUMENT;
-    } else {
-      if(new_entry->key < entry->key) {
-        if(entry->left) {
-          entry = entry->left;
-        } else {
-          parent = entry;
-          parent->left = new_entry;
-          break;
-        }
-      } else {
-        if(entry->right) {
-          entry = entry->right;
-        } else {
-          parent = entry;
-          parent->right = new_entry;
-          break;
-        }
-      }
+  for(i = hash(key, map->tablelen); map->table[i];
+      i = (i + 1) & (map->tablelen - 1)) {
+    if(map->table[i]->key == key) {
+      return i;
     }
   }
-  new_entry->parent = parent;
+  return -1;
+}
 
-  /* Rotate tree to satisfy heap property. */
-  for(entry = parent; ; entry = entry->parent) {
-    if(entry->left && entry->priority > entry->left->priority) {
-      entry = rotate_right(entry);
-    } else if(entry->right && entry->priority > entry->right->priority) {
-      entry = rotate_left(entry);
-    } else {
-      /* At this point, tree forms heap. */
-      break;
-    }
-    /* If no parent is assigned, then it is a root node. */
-    if(!entry->parent) {
-      map->root = entry;
-      break;
+int nghttp2_map_insert(nghttp2_map *map, nghttp2_map_entry *new_entry)
+{
+  int rv;
+  if(find_slot(map, new_entry->key) != -1) {
+    return NGHTTP2_ERR_INVALID_ARGUMENT;
+  }
+  /* Keep load factor at most 3/4 so that probe sequences stay
+     short. */
+  if((map->size + 1) * 4 > map->tablelen * 3) {
+    rv = resize(map, map->tablelen == 0 ?
+                NGHTTP2_INITIAL_TABLE_LENGTH : map->tablelen * 2);
+    if(rv != 0) {
+      return rv;
     }
   }
+  insert(map->table, map->tablelen, new_entry);
   ++map->size;
   return 0;
 }
 
 nghttp2_map_entry* nghttp2_map_find(nghttp2_map *map, key_type key)
 {
-  nghttp2_map_entry *entry = map->root;
-  while(entry != NULL) {
-    if(key < entry->key) {
-      entry = entry->left;
-    } else if(key > entry->key) {
-      entry = entry->right;
-    } else {
-      return entry;
-    }
+  ssize_t i = find_slot(map, key);
+  if(i == -1) {
+    return NULL;
   }
-  return NULL;
+  return map->table[i];
 }
 
 int nghttp2_map_remove(nghttp2_map *map, key_type key)
 {
-  nghttp2_map_entry *entry = map->root;
-
-  if(map->root == NULL) {
-    return NGHTTP2_ERR_INVALID_ARGUMENT;
-  }
-  /* Locate entry to delete. */
-  while(entry) {
-    if(key < entry->key) {
-      entry = entry->left;
-    } else if(key > entry->key) {
-      entry = entry->right;
-    } else {
-      break;
-    }
-  }
-  if(!entry) {
-    /* Not found */
+  size_t i, j, k, mask;
+  ssize_t slot = find_slot(map, key);
+  if(slot == -1) {
     return NGHTTP2_ERR_INVALID_ARGUMENT;
   }
-  /* Rotate and bubble down to satisfy heap property. */
+  mask = map->tablelen - 1;
+  /* Shift the following entries in the same cluster backward instead
+     of leaving tombstone, so that lookups never see deleted slots. An
+     entry at |j| can be moved to the vacant slot |i| only if |i| lies
+     on its probe sequence starting from its home slot |k|. */
+  i = j = slot;
   for(;;) {
-    if(!entry->left) {
-      if(!entry->parent) {
-        map->root = entry->right;
-      } else if(entry->parent->left == entry) {
-        entry->parent->left = entry->right;
-      } else {
-        entry->parent->right = entry->right;
-      }
-      if(entry->right) {
-        entry->right->parent = entry->parent;
-      }
+    j = (j + 1) & mask;
+    if(map->table[j] == NULL) {
       break;
-    } else if(!entry->right) {
-      if(!entry->parent) {
-        map->root = entry->left;
-      } else if(entry->parent->left == entry) {
-        entry->parent->left = entry->left;
-      } else {
-        entry->parent->right = entry->left;
-      }
-      if(entry->left) {
-        entry->left->parent = entry->parent;
-      }
-      break;
-    } else if(entry->left->priority < entry->right->priority) {
-      entry = rotate_right(entry);
-      if(!entry->parent) {
-        map->root = entry;
-      }
-      entry = entry->right;
-    } else {
-      entry = rotate_left(entry);
-      if(!entry->parent) {
-        map->root = entry;
-      }
-      entry = entry->left;
+    }
+    k = hash(map->table[j]->key, map->tablelen);
+    if(((j - k) & mask) >= ((j - i) & mask)) {
+      map->table[i] = map->table[j];
+      i = j;
     }
   }
+  map->table[i] = NULL;
   --map->size;
   return 0;
 }
@@ -32,26 +32,36 @@
 #include <nghttp2/nghttp2.h>
 #include "nghttp2_int.h"
 
-/* Implementation of ordered map */
+/* Implementation of unordered map. The entries are stored in the
+   open addressing hash table with linear probing. */
 
 typedef uint32_t key_type;
-typedef uint32_t pri_type;
+
+#define NGHTTP2_INITIAL_TABLE_LENGTH 16
 
 typedef struct nghttp2_map_entry {
   key_type key;
-  struct nghttp2_map_entry *parent, *left, *right;
-  pri_type priority;
 } nghttp2_map_entry;
 
 typedef struct {
-  nghttp2_map_entry *root;
+  /* The hash table. Empty slot is NULL. */
+  nghttp2_map_entry **table;
+  /* The number of slots in |table|. This is always power of 2. */
+  size_t tablelen;
+  /* The number of entries stored in |table| */
   size_t size;
 } nghttp2_map;
 
 /*
  * Initializes the map |map|.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory
  */
-void nghttp2_map_init(nghttp2_map *map);
+int nghttp2_map_init(nghttp2_map *map);
 
 /*
  * Deallocates any resources allocated for |map|. The stored entries
@@ -84,6 +94,8 @@ void nghttp2_map_entry_init(nghttp2_map_entry *entry, key_type key);
  *
  * NGHTTP2_ERR_INVALID_ARGUMENT
  *     The item associated by |key| already exists.
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory
  */
 int nghttp2_map_insert(nghttp2_map *map, nghttp2_map_entry *entry);
 
@@ -112,7 +124,8 @@ size_t nghttp2_map_size(nghttp2_map *map);
 
 /*
  * Applies the function |func| to each entry in the |map| with the
- * optional user supplied pointer |ptr|.
+ * optional user supplied pointer |ptr|. The entries are visited in no
+ * particular order. The |func| must not insert or remove entries.
  *
  * If the |func| returns 0, this function calls the |func| with the
  * next entry. If the |func| returns nonzero, it will not call the
@@ -0,0 +1,107 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "nghttp2_mem.h"
+
+#include <stdlib.h>
+
+static void* default_malloc(size_t size, void *mem_user_data)
+{
+  return malloc(size);
+}
+
+static void default_free(void *ptr, void *mem_user_data)
+{
+  free(ptr);
+}
+
+static nghttp2_mem mem_default = {
+  NULL, default_malloc, default_free
+};
+
+nghttp2_mem* nghttp2_mem_default(void)
+{
+  return &mem_default;
+}
+
+void* nghttp2_mem_malloc(nghttp2_mem *mem, size_t size)
+{
+  return mem->malloc(size, mem->mem_user_data);
+}
+
+void nghttp2_mem_free(nghttp2_mem *mem, void *ptr)
+{
+  mem->free(ptr, mem->mem_user_data);
+}
+
+void nghttp2_objpool_init(nghttp2_objpool *pool, size_t objsize, size_t max,
+                          nghttp2_mem *mem)
+{
+  pool->mem = mem;
+  pool->head = NULL;
+  if(objsize < sizeof(nghttp2_objpool_entry)) {
+    objsize = sizeof(nghttp2_objpool_entry);
+  }
+  pool->objsize = objsize;
+  pool->len = 0;
+  pool->max = max;
+}
+
+void nghttp2_objpool_free(nghttp2_objpool *pool)
+{
+  while(pool->head) {
+    nghttp2_objpool_entry *next = pool->head->next;
+    nghttp2_mem_free(pool->mem, pool->head);
+    pool->head = next;
+  }
+  pool->len = 0;
+}
+
+void* nghttp2_objpool_get(nghttp2_objpool *pool)
+{
+  nghttp2_objpool_entry *ent;
+  if(pool->head == NULL) {
+    return nghttp2_mem_malloc(pool->mem, pool->objsize);
+  }
+  ent = pool->head;
+  pool->head = ent->next;
+  --pool->len;
+  return ent;
+}
+
+void nghttp2_objpool_put(nghttp2_objpool *pool, void *obj)
+{
+  nghttp2_objpool_entry *ent;
+  if(obj == NULL) {
+    return;
+  }
+  if(pool->len >= pool->max) {
+    nghttp2_mem_free(pool->mem, obj);
+    return;
+  }
+  ent = (nghttp2_objpool_entry*)obj;
+  ent->next = pool->head;
+  pool->head = ent;
+  ++pool->len;
+}
@@ -0,0 +1,95 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NGHTTP2_MEM_H
+#define NGHTTP2_MEM_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <nghttp2/nghttp2.h>
+
+/*
+ * Returns the allocator which uses the standard malloc() and free().
+ */
+nghttp2_mem* nghttp2_mem_default(void);
+
+void* nghttp2_mem_malloc(nghttp2_mem *mem, size_t size);
+
+void nghttp2_mem_free(nghttp2_mem *mem, void *ptr);
+
+typedef struct nghttp2_objpool_entry {
+  struct nghttp2_objpool_entry *next;
+} nghttp2_objpool_entry;
+
+/*
+ * Free list of the objects of the same size. The objects released by
+ * nghttp2_objpool_put() are kept in the list and handed out by the
+ * next nghttp2_objpool_get(), so that allocation in steady state does
+ * not reach the underlying allocator. Each object is allocated
+ * individually by |mem|, so an object allocated by |mem| with the
+ * same size can be put to the pool.
+ */
+typedef struct {
+  nghttp2_mem *mem;
+  /* The head of the free list */
+  nghttp2_objpool_entry *head;
+  /* The size of each object */
+  size_t objsize;
+  /* The number of objects in the free list */
+  size_t len;
+  /* The maximum number of objects the free list holds. The objects
+     put beyond this limit are released to |mem|. */
+  size_t max;
+} nghttp2_objpool;
+
+/*
+ * Initializes |pool| for the objects of size |objsize| bytes, holding
+ * at most |max| free objects. The |objsize| is rounded up to hold
+ * at least a pointer.
+ */
+void nghttp2_objpool_init(nghttp2_objpool *pool, size_t objsize, size_t max,
+                          nghttp2_mem *mem);
+
+/*
+ * Releases all objects in the free list of |pool|. The |pool| can
+ * still be used after this call.
+ */
+void nghttp2_objpool_free(nghttp2_objpool *pool);
+
+/*
+ * Returns the object from the free list of |pool|, or newly
+ * allocated one if the free list is empty. This function returns
+ * NULL if it fails to allocate memory.
+ */
+void* nghttp2_objpool_get(nghttp2_objpool *pool);
+
+/*
+ * Returns the |obj| to the |pool|. If |obj| is NULL, this function
+ * does nothing.
+ */
+void nghttp2_objpool_put(nghttp2_objpool *pool, void *obj);
+
+#endif /* NGHTTP2_MEM_H */
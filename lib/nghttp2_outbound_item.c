@@ -26,7 +26,7 @@
 
 #include <assert.h>
 
-void nghttp2_outbound_item_free(nghttp2_outbound_item *item)
+void nghttp2_outbound_item_free(nghttp2_outbound_item *item, nghttp2_mem *mem)
 {
   if(item == NULL) {
     return;
@@ -36,9 +36,11 @@ void nghttp2_outbound_item_free(nghttp2_outbound_item *item)
     frame = nghttp2_outbound_item_get_ctrl_frame(item);
     switch(frame->hd.type) {
     case NGHTTP2_HEADERS:
-      nghttp2_frame_headers_free(&frame->headers);
-      if(item->aux_data) {
-        free(((nghttp2_headers_aux_data*)item->aux_data)->data_prd);
+      nghttp2_nv_array_del_mem(frame->headers.nva, mem);
+      if(item->aux_data &&
+         ((nghttp2_headers_aux_data*)item->aux_data)->data_prd) {
+        nghttp2_mem_free(mem,
+                         ((nghttp2_headers_aux_data*)item->aux_data)->data_prd);
       }
       break;
     case NGHTTP2_PRIORITY:
@@ -51,7 +53,7 @@ void nghttp2_outbound_item_free(nghttp2_outbound_item *item)
       nghttp2_frame_settings_free(&frame->settings);
       break;
     case NGHTTP2_PUSH_PROMISE:
-      nghttp2_frame_push_promise_free(&frame->push_promise);
+      nghttp2_nv_array_del_mem(frame->push_promise.nva, mem);
       break;
     case NGHTTP2_PING:
       nghttp2_frame_ping_free(&frame->ping);
@@ -71,6 +73,4 @@ void nghttp2_outbound_item_free(nghttp2_outbound_item *item)
     /* Unreachable */
     assert(0);
   }
-  free(item->frame);
-  free(item->aux_data);
 }
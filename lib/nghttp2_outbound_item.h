@@ -31,18 +31,25 @@
 
 #include <nghttp2/nghttp2.h>
 #include "nghttp2_frame.h"
+#include "nghttp2_pq.h"
 
 /* Priority for PING */
 #define NGHTTP2_OB_PRI_PING -10
 /* Priority for SETTINGS */
 #define NGHTTP2_OB_PRI_SETTINGS -9
+/* The maximum weight of the stream in fair DATA scheduling */
+#define NGHTTP2_MAX_DATA_WEIGHT 32
 
 typedef struct {
   nghttp2_data_provider *data_prd;
   void *stream_user_data;
 } nghttp2_headers_aux_data;
 
-typedef struct {
+struct nghttp2_stream;
+
+typedef struct nghttp2_outbound_item {
+  /* Intrusive entry of ob_pq or ob_ss_pq */
+  nghttp2_pq_entry pq_entry;
   /* Type of |frame|. NGHTTP2_CTRL: nghttp2_frame*, NGHTTP2_DATA:
      nghttp2_data* */
   nghttp2_frame_category frame_cat;
@@ -50,13 +57,26 @@ typedef struct {
   void *aux_data;
   int pri;
   int64_t seq;
+  /* Virtual finish time of the DATA frame used for fair DATA
+     scheduling. Items with smaller cycle are sent first. This is 0
+     for control frames and if fair DATA scheduling is disabled. */
+  uint64_t cycle;
+  /* The stream whose priority this item follows, or NULL. While this
+     is not NULL, the item is linked in stream->pri_items. */
+  struct nghttp2_stream *stream;
+  /* The next item in stream->pri_items */
+  struct nghttp2_outbound_item *stream_next;
 } nghttp2_outbound_item;
 
 /*
- * Deallocates resource for |item|. If |item| is NULL, this function
- * does nothing.
+ * Deallocates resource owned by the frame and the auxiliary data in
+ * |item|. The name/value pair arrays and the data provider are freed
+ * by |mem|. The |item->frame|, |item->aux_data| and |item| itself are
+ * not freed by this function; they are owned by the session. Use
+ * nghttp2_session_outbound_item_del() to free all of them. If |item|
+ * is NULL, this function does nothing.
  */
-void nghttp2_outbound_item_free(nghttp2_outbound_item *item);
+void nghttp2_outbound_item_free(nghttp2_outbound_item *item, nghttp2_mem *mem);
 
 /* Macros to cast nghttp2_outbound_item.frame to the proper type. */
 #define nghttp2_outbound_item_get_ctrl_frame(ITEM) ((nghttp2_frame*)ITEM->frame)
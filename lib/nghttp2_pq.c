@@ -27,7 +27,7 @@
 int nghttp2_pq_init(nghttp2_pq *pq, nghttp2_compar compar)
 {
   pq->capacity = 4096;
-  pq->q = malloc(pq->capacity * sizeof(void*));
+  pq->q = malloc(pq->capacity * sizeof(nghttp2_pq_entry*));
   if(pq->q == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
@@ -44,9 +44,11 @@ void nghttp2_pq_free(nghttp2_pq *pq)
 
 static void swap(nghttp2_pq *pq, size_t i, size_t j)
 {
-  void *t = pq->q[i];
+  nghttp2_pq_entry *t = pq->q[i];
   pq->q[i] = pq->q[j];
+  pq->q[i]->index = i;
   pq->q[j] = t;
+  pq->q[j]->index = j;
 }
 
 static void bubble_up(nghttp2_pq *pq, size_t index)
@@ -62,24 +64,25 @@ static void bubble_up(nghttp2_pq *pq, size_t index)
   }
 }
 
-int nghttp2_pq_push(nghttp2_pq *pq, void *item)
+int nghttp2_pq_push(nghttp2_pq *pq, nghttp2_pq_entry *item)
 {
   if(pq->capacity <= pq->length) {
     void *nq;
-    nq = realloc(pq->q, (pq->capacity*2) * sizeof(void*));
+    nq = realloc(pq->q, (pq->capacity*2) * sizeof(nghttp2_pq_entry*));
     if(nq == NULL) {
       return NGHTTP2_ERR_NOMEM;
     }
     pq->capacity *= 2;
     pq->q = nq;
   }
+  item->index = pq->length;
   pq->q[pq->length] = item;
   ++pq->length;
   bubble_up(pq, pq->length-1);
   return 0;
 }
 
-void* nghttp2_pq_top(nghttp2_pq *pq)
+nghttp2_pq_entry* nghttp2_pq_top(nghttp2_pq *pq)
 {
   if(pq->length == 0) {
     return NULL;
@@ -112,6 +115,7 @@ void nghttp2_pq_pop(nghttp2_pq *pq)
 {
   if(pq->length > 0) {
     pq->q[0] = pq->q[pq->length-1];
+    pq->q[0]->index = 0;
     --pq->length;
     bubble_down(pq, 0);
   }
@@ -143,3 +147,13 @@ void nghttp2_pq_update(nghttp2_pq *pq, nghttp2_pq_item_cb fun, void *arg)
     }
   }
 }
+
+void nghttp2_pq_update_item(nghttp2_pq *pq, nghttp2_pq_entry *item)
+{
+  size_t index = item->index;
+  if(index >= pq->length || pq->q[index] != item) {
+    return;
+  }
+  bubble_up(pq, index);
+  bubble_down(pq, item->index);
+}
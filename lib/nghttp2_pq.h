@@ -34,15 +34,25 @@
 
 /* Implementation of priority queue */
 
+/* Intrusive entry of the priority queue. The item stored in the
+   queue must embed this struct as its first member. */
+typedef struct {
+  /* The position of the item in the heap. This is only valid while
+     the item is in the queue. */
+  size_t index;
+} nghttp2_pq_entry;
+
 typedef struct {
   /* The pointer to the pointer to the item stored */
-  void **q;
+  nghttp2_pq_entry **q;
   /* The number of items sotred */
   size_t length;
   /* The maximum number of items this pq can store. This is
      automatically extended when length is reached to this value. */
   size_t capacity;
-  /* The compare function between items */
+  /* The compare function between items. The pointers to the items,
+     which are also the pointers to their nghttp2_pq_entry, are
+     passed. */
   nghttp2_compar compar;
 } nghttp2_pq;
 
@@ -72,13 +82,13 @@ void nghttp2_pq_free(nghttp2_pq *pq);
  * NGHTTP2_ERR_NOMEM
  *     Out of memory.
  */
-int nghttp2_pq_push(nghttp2_pq *pq, void *item);
+int nghttp2_pq_push(nghttp2_pq *pq, nghttp2_pq_entry *item);
 
 /*
  * Returns item at the top of the queue |pq|. If the queue is empty,
  * this function returns NULL.
  */
-void* nghttp2_pq_top(nghttp2_pq *pq);
+nghttp2_pq_entry* nghttp2_pq_top(nghttp2_pq *pq);
 
 /*
  * Pops item at the top of the queue |pq|. The popped item is not
@@ -106,4 +116,11 @@ typedef int (*nghttp2_pq_item_cb)(void *item, void *arg);
  */
 void nghttp2_pq_update(nghttp2_pq *pq, nghttp2_pq_item_cb fun, void *arg);
 
+/*
+ * Restores the order of the queue |pq| after the key of |item| is
+ * changed. This is O(log n), only moving |item| up or down in the
+ * heap. If |item| is not in |pq|, this function does nothing.
+ */
+void nghttp2_pq_update_item(nghttp2_pq *pq, nghttp2_pq_entry *item);
+
 #endif /* NGHTTP2_PQ_H */
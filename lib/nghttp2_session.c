@@ -115,6 +115,9 @@ static int nghttp2_outbound_item_compar(const void *lhsx, const void *rhsx)
   const nghttp2_outbound_item *lhs, *rhs;
   lhs = (const nghttp2_outbound_item*)lhsx;
   rhs = (const nghttp2_outbound_item*)rhsx;
+  if(lhs->cycle != rhs->cycle) {
+    return lhs->cycle < rhs->cycle ? -1 : 1;
+  }
   if(lhs->pri == rhs->pri) {
     return (lhs->seq < rhs->seq) ? -1 : ((lhs->seq > rhs->seq) ? 1 : 0);
   } else {
@@ -126,6 +129,7 @@ static void nghttp2_inbound_frame_reset(nghttp2_inbound_frame *iframe)
 {
   iframe->state = NGHTTP2_RECV_HEAD;
   iframe->payloadlen = iframe->buflen = iframe->off = 0;
+  iframe->payload = NULL;
   iframe->headbufoff = 0;
   iframe->error_code = 0;
 }
@@ -133,20 +137,39 @@ static void nghttp2_inbound_frame_reset(nghttp2_inbound_frame *iframe)
 static int nghttp2_session_new(nghttp2_session **session_ptr,
                                const nghttp2_session_callbacks *callbacks,
                                void *user_data,
-                               nghttp2_hd_side side)
+                               nghttp2_hd_side side,
+                               const nghttp2_mem *mem)
 {
   int r;
-  *session_ptr = malloc(sizeof(nghttp2_session));
+  if(mem == NULL) {
+    mem = nghttp2_mem_default();
+  }
+  *session_ptr = mem->malloc(sizeof(nghttp2_session), mem->mem_user_data);
   if(*session_ptr == NULL) {
     r = NGHTTP2_ERR_NOMEM;
     goto fail_session;
   }
   memset(*session_ptr, 0, sizeof(nghttp2_session));
 
+  (*session_ptr)->mem = *mem;
+  nghttp2_objpool_init(&(*session_ptr)->item_pool,
+                       sizeof(nghttp2_outbound_item),
+                       NGHTTP2_SESSION_OBJPOOL_MAX, &(*session_ptr)->mem);
+  nghttp2_objpool_init(&(*session_ptr)->frame_pool,
+                       sizeof(nghttp2_frame),
+                       NGHTTP2_SESSION_OBJPOOL_MAX, &(*session_ptr)->mem);
+  nghttp2_objpool_init(&(*session_ptr)->data_pool,
+                       sizeof(nghttp2_data),
+                       NGHTTP2_SESSION_OBJPOOL_MAX, &(*session_ptr)->mem);
+  nghttp2_objpool_init(&(*session_ptr)->aux_pool,
+                       sizeof(nghttp2_headers_aux_data),
+                       NGHTTP2_SESSION_OBJPOOL_MAX, &(*session_ptr)->mem);
+
   /* next_stream_id and last_recv_stream_id are initialized in either
      nghttp2_session_client_new or nghttp2_session_server_new */
 
   (*session_ptr)->next_seq = 0;
+  (*session_ptr)->last_cycle = 0;
 
   (*session_ptr)->remote_flow_control = 1;
   (*session_ptr)->local_flow_control = 1;
@@ -165,7 +188,10 @@ static int nghttp2_session_new(nghttp2_session **session_ptr,
   if(r != 0) {
     goto fail_hd_inflater;
   }
-  nghttp2_map_init(&(*session_ptr)->streams);
+  r = nghttp2_map_init(&(*session_ptr)->streams);
+  if(r != 0) {
+    goto fail_streams;
+  }
   r = nghttp2_pq_init(&(*session_ptr)->ob_pq, nghttp2_outbound_item_compar);
   if(r != 0) {
     goto fail_ob_pq;
@@ -175,20 +201,10 @@ static int nghttp2_session_new(nghttp2_session **session_ptr,
     goto fail_ob_ss_pq;
   }
 
-  (*session_ptr)->aob.framebuf = malloc
-    (NGHTTP2_INITIAL_OUTBOUND_FRAMEBUF_LENGTH);
-  if((*session_ptr)->aob.framebuf == NULL) {
-    r = NGHTTP2_ERR_NOMEM;
-    goto fail_aob_framebuf;
-  }
-  (*session_ptr)->aob.framebufmax = NGHTTP2_INITIAL_OUTBOUND_FRAMEBUF_LENGTH;
-
-  (*session_ptr)->nvbuf = malloc(NGHTTP2_INITIAL_NV_BUFFER_LENGTH);
-  if((*session_ptr)->nvbuf == NULL) {
-    r = NGHTTP2_ERR_NOMEM;
-    goto fail_nvbuf;
-  }
-  (*session_ptr)->nvbuflen = NGHTTP2_INITIAL_NV_BUFFER_LENGTH;
+  /* aob.framebuf and iframe.buf are allocated when they are first
+     needed. */
+  (*session_ptr)->aob.framebuf = NULL;
+  (*session_ptr)->aob.framebufmax = 0;
 
   memset((*session_ptr)->remote_settings, 0,
          sizeof((*session_ptr)->remote_settings));
@@ -207,32 +223,23 @@ static int nghttp2_session_new(nghttp2_session **session_ptr,
   (*session_ptr)->callbacks = *callbacks;
   (*session_ptr)->user_data = user_data;
 
-  (*session_ptr)->iframe.buf = malloc(NGHTTP2_INITIAL_INBOUND_FRAMEBUF_LENGTH);
-  if((*session_ptr)->iframe.buf == NULL) {
-    r = NGHTTP2_ERR_NOMEM;
-    goto fail_iframe_buf;
-  }
-  (*session_ptr)->iframe.bufmax = NGHTTP2_INITIAL_INBOUND_FRAMEBUF_LENGTH;
+  (*session_ptr)->iframe.buf = NULL;
+  (*session_ptr)->iframe.bufmax = 0;
 
   nghttp2_inbound_frame_reset(&(*session_ptr)->iframe);
 
   return 0;
 
- fail_iframe_buf:
-  free((*session_ptr)->nvbuf);
- fail_nvbuf:
-  free((*session_ptr)->aob.framebuf);
- fail_aob_framebuf:
-  nghttp2_pq_free(&(*session_ptr)->ob_ss_pq);
  fail_ob_ss_pq:
   nghttp2_pq_free(&(*session_ptr)->ob_pq);
  fail_ob_pq:
-  /* No need to free (*session_ptr)->streams) here. */
+  nghttp2_map_free(&(*session_ptr)->streams);
+ fail_streams:
   nghttp2_hd_inflate_free(&(*session_ptr)->hd_inflater);
  fail_hd_inflater:
   nghttp2_hd_deflate_free(&(*session_ptr)->hd_deflater);
  fail_hd_deflater:
-  free(*session_ptr);
+  nghttp2_mem_free(&(*session_ptr)->mem, *session_ptr);
  fail_session:
   return r;
 }
@@ -240,11 +247,19 @@ static int nghttp2_session_new(nghttp2_session **session_ptr,
 int nghttp2_session_client_new(nghttp2_session **session_ptr,
                                const nghttp2_session_callbacks *callbacks,
                                void *user_data)
+{
+  return nghttp2_session_client_new2(session_ptr, callbacks, user_data, NULL);
+}
+
+int nghttp2_session_client_new2(nghttp2_session **session_ptr,
+                                const nghttp2_session_callbacks *callbacks,
+                                void *user_data,
+                                const nghttp2_mem *mem)
 {
   int r;
   /* For client side session, header compression is disabled. */
   r = nghttp2_session_new(session_ptr, callbacks, user_data,
-                          NGHTTP2_HD_SIDE_CLIENT);
+                          NGHTTP2_HD_SIDE_CLIENT, mem);
   if(r == 0) {
     /* IDs for use in client */
     (*session_ptr)->next_stream_id = 1;
@@ -256,11 +271,19 @@ int nghttp2_session_client_new(nghttp2_session **session_ptr,
 int nghttp2_session_server_new(nghttp2_session **session_ptr,
                                const nghttp2_session_callbacks *callbacks,
                                void *user_data)
+{
+  return nghttp2_session_server_new2(session_ptr, callbacks, user_data, NULL);
+}
+
+int nghttp2_session_server_new2(nghttp2_session **session_ptr,
+                                const nghttp2_session_callbacks *callbacks,
+                                void *user_data,
+                                const nghttp2_mem *mem)
 {
   int r;
   /* Enable header compression on server side. */
   r = nghttp2_session_new(session_ptr, callbacks, user_data,
-                          NGHTTP2_HD_SIDE_SERVER);
+                          NGHTTP2_HD_SIDE_SERVER, mem);
   if(r == 0) {
     (*session_ptr)->server = 1;
     /* IDs for use in client */
@@ -270,29 +293,94 @@ int nghttp2_session_server_new(nghttp2_session **session_ptr,
   return r;
 }
 
+/*
+ * Links |item| to the |stream| so that the priority of |item| is
+ * updated when |stream| is reprioritized.
+ */
+static void nghttp2_stream_attach_pri_item(nghttp2_stream *stream,
+                                           nghttp2_outbound_item *item)
+{
+  item->stream = stream;
+  item->stream_next = stream->pri_items;
+  stream->pri_items = item;
+}
+
+/*
+ * Unlinks |item| from the stream it is linked to, if any.
+ */
+static void nghttp2_outbound_item_detach_stream(nghttp2_outbound_item *item)
+{
+  nghttp2_outbound_item **p;
+  if(item->stream == NULL) {
+    return;
+  }
+  for(p = &item->stream->pri_items; *p; p = &(*p)->stream_next) {
+    if(*p == item) {
+      *p = item->stream_next;
+      break;
+    }
+  }
+  item->stream = NULL;
+  item->stream_next = NULL;
+}
+
+void nghttp2_session_outbound_item_del(nghttp2_session *session,
+                                       nghttp2_outbound_item *item)
+{
+  if(item == NULL) {
+    return;
+  }
+  nghttp2_outbound_item_detach_stream(item);
+  nghttp2_outbound_item_free(item, &session->mem);
+  if(item->frame_cat == NGHTTP2_CAT_CTRL) {
+    nghttp2_objpool_put(&session->frame_pool, item->frame);
+  } else {
+    nghttp2_objpool_put(&session->data_pool, item->frame);
+  }
+  nghttp2_objpool_put(&session->aux_pool, item->aux_data);
+  nghttp2_objpool_put(&session->item_pool, item);
+}
+
+/*
+ * Deallocates |stream| and its deferred DATA frame if any.
+ */
+static void nghttp2_session_stream_del(nghttp2_session *session,
+                                       nghttp2_stream *stream)
+{
+  nghttp2_outbound_item *item, *next;
+  /* The items may outlive the stream in the outbound queues */
+  for(item = stream->pri_items; item; item = next) {
+    next = item->stream_next;
+    item->stream = NULL;
+    item->stream_next = NULL;
+  }
+  stream->pri_items = NULL;
+  nghttp2_session_outbound_item_del(session, stream->deferred_data);
+  nghttp2_stream_free(stream);
+  nghttp2_mem_free(&session->mem, stream);
+}
+
 static int nghttp2_free_streams(nghttp2_map_entry *entry, void *ptr)
 {
-  nghttp2_stream_free((nghttp2_stream*)entry);
-  free(entry);
+  nghttp2_session_stream_del((nghttp2_session*)ptr, (nghttp2_stream*)entry);
   return 0;
 }
 
-static void nghttp2_session_ob_pq_free(nghttp2_pq *pq)
+static void nghttp2_session_ob_pq_free(nghttp2_session *session,
+                                       nghttp2_pq *pq)
 {
   while(!nghttp2_pq_empty(pq)) {
     nghttp2_outbound_item *item = (nghttp2_outbound_item*)nghttp2_pq_top(pq);
-    nghttp2_outbound_item_free(item);
-    free(item);
     nghttp2_pq_pop(pq);
+    nghttp2_session_outbound_item_del(session, item);
   }
   nghttp2_pq_free(pq);
 }
 
-static void nghttp2_active_outbound_item_reset
-(nghttp2_active_outbound_item *aob)
+static void nghttp2_active_outbound_item_reset(nghttp2_session *session)
 {
-  nghttp2_outbound_item_free(aob->item);
-  free(aob->item);
+  nghttp2_active_outbound_item *aob = &session->aob;
+  nghttp2_session_outbound_item_del(session, aob->item);
   aob->item = NULL;
   aob->framebuflen = aob->framebufoff = 0;
 }
@@ -302,63 +390,115 @@ void nghttp2_session_del(nghttp2_session *session)
   if(session == NULL) {
     return;
   }
-  nghttp2_map_each_free(&session->streams, nghttp2_free_streams, NULL);
-  nghttp2_session_ob_pq_free(&session->ob_pq);
-  nghttp2_session_ob_pq_free(&session->ob_ss_pq);
+  nghttp2_map_each_free(&session->streams, nghttp2_free_streams, session);
+  nghttp2_session_ob_pq_free(session, &session->ob_pq);
+  nghttp2_session_ob_pq_free(session, &session->ob_ss_pq);
   nghttp2_hd_deflate_free(&session->hd_deflater);
   nghttp2_hd_inflate_free(&session->hd_inflater);
-  nghttp2_active_outbound_item_reset(&session->aob);
+  nghttp2_active_outbound_item_reset(session);
   free(session->aob.framebuf);
-  free(session->nvbuf);
+  free(session->batch.buf);
   free(session->iframe.buf);
-   free(session);
+  nghttp2_objpool_free(&session->item_pool);
+  nghttp2_objpool_free(&session->frame_pool);
+  nghttp2_objpool_free(&session->data_pool);
+  nghttp2_objpool_free(&session->aux_pool);
+  nghttp2_mem_free(&session->mem, session);
 }
 
-static int outbound_item_update_pri
-(nghttp2_outbound_item *item, nghttp2_stream *stream)
+void nghttp2_session_shrink(nghttp2_session *session)
 {
-  if(item->frame_cat == NGHTTP2_CAT_CTRL) {
-    if(((nghttp2_frame*)item->frame)->hd.stream_id != stream->stream_id) {
-      return 0;
-    }
-    switch(((nghttp2_frame*)item->frame)->hd.type) {
-    case NGHTTP2_HEADERS:
-    case NGHTTP2_PUSH_PROMISE:
-      break;
-    default:
-      return 0;
-    }
-  } else {
-    if(((nghttp2_data*)item->frame)->hd.stream_id != stream->stream_id) {
-      return 0;
-    }
+  if(session->aob.item == NULL) {
+    free(session->aob.framebuf);
+    session->aob.framebuf = NULL;
+    session->aob.framebufmax = 0;
   }
-  item->pri = stream->pri;
-  return 1;
-}
-
-static int update_stream_pri(void *ptr, void *arg)
-{
-  nghttp2_outbound_item *item = (nghttp2_outbound_item*)ptr;
-  nghttp2_stream *stream = (nghttp2_stream*)arg;
-  return outbound_item_update_pri(item, stream);
+  if(session->iframe.state == NGHTTP2_RECV_HEAD) {
+    free(session->iframe.buf);
+    session->iframe.buf = NULL;
+    session->iframe.bufmax = 0;
+  }
+  nghttp2_hd_shrink(&session->hd_deflater);
+  nghttp2_hd_shrink(&session->hd_inflater);
+  nghttp2_objpool_free(&session->item_pool);
+  nghttp2_objpool_free(&session->frame_pool);
+  nghttp2_objpool_free(&session->data_pool);
+  nghttp2_objpool_free(&session->aux_pool);
 }
 
 void nghttp2_session_reprioritize_stream
 (nghttp2_session *session, nghttp2_stream *stream, int32_t pri)
 {
+  nghttp2_outbound_item *item;
   if(stream->pri == pri) {
     return;
   }
   stream->pri = pri;
-  nghttp2_pq_update(&session->ob_pq, update_stream_pri, stream);
-  nghttp2_pq_update(&session->ob_ss_pq, update_stream_pri, stream);
-  if(stream->deferred_data) {
-    stream->deferred_data->pri = pri;
+  /* The items may be in either queue, or may be deferred or being
+     sent. nghttp2_pq_update_item() does nothing for the item not in
+     the queue. */
+  for(item = stream->pri_items; item; item = item->stream_next) {
+    item->pri = pri;
+    nghttp2_pq_update_item(&session->ob_pq, &item->pq_entry);
+    nghttp2_pq_update_item(&session->ob_ss_pq, &item->pq_entry);
+  }
+}
+
+/*
+ * Returns the weight of the priority |pri| for fair DATA scheduling.
+ * The weight is halved each time |pri| + 1 doubles; it is 32 for
+ * priority 0 and 1 for NGHTTP2_PRI_LOWEST.
+ */
+static uint32_t nghttp2_pri_to_weight(int32_t pri)
+{
+  uint32_t v;
+  uint32_t weight = NGHTTP2_MAX_DATA_WEIGHT;
+  if(pri < 0) {
+    return weight;
   }
-  if(session->aob.item) {
-    outbound_item_update_pri(session->aob.item, stream);
+  for(v = (uint32_t)pri + 1; v > 1; v >>= 1) {
+    --weight;
+  }
+  return weight;
+}
+
+/*
+ * Advances the cycle of the DATA |item| by the cost of sending |len|
+ * bytes of payload, which is inversely proportional to the weight of
+ * its priority. The cycle is counted from the current virtual time
+ * if the |item| has fallen behind it. If fair DATA scheduling is
+ * disabled, the cycle is set to 0.
+ */
+static void nghttp2_session_update_data_cycle(nghttp2_session *session,
+                                              nghttp2_outbound_item *item,
+                                              size_t len)
+{
+  uint64_t cost;
+  if((session->opt_flags & NGHTTP2_OPTMASK_FAIR_DATA_SCHEDULING) == 0) {
+    item->cycle = 0;
+    return;
+  }
+  if(item->cycle < session->last_cycle) {
+    item->cycle = session->last_cycle;
+  }
+  cost = (uint64_t)len * NGHTTP2_MAX_DATA_WEIGHT /
+    nghttp2_pri_to_weight(item->pri);
+  item->cycle += cost > 0 ? cost : 1;
+}
+
+/*
+ * Pushes the deferred DATA |item| back to ob_pq. If the |item| has
+ * fallen behind the virtual time of fair DATA scheduling while it was
+ * deferred, it is scheduled at the current virtual time so that it
+ * does not get ahead of the other streams.
+ */
+static int nghttp2_session_push_deferred_data(nghttp2_session *session,
+                                              nghttp2_outbound_item *item)
+{
+  if(item->cycle != 0 && item->cycle < session->last_cycle) {
+    item->cycle = session->last_cycle;
   }
+  return nghttp2_pq_push(&session->ob_pq, &item->pq_entry);
 }
 
 int nghttp2_session_add_frame(nghttp2_session *session,
@@ -370,7 +510,7 @@ int nghttp2_session_add_frame(nghttp2_session *session,
      stream presence. */
   int r = 0;
   nghttp2_outbound_item *item;
-  item = malloc(sizeof(nghttp2_outbound_item));
+  item = nghttp2_objpool_get(&session->item_pool);
   if(item == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
@@ -378,6 +518,9 @@ int nghttp2_session_add_frame(nghttp2_session *session,
   item->frame = abs_frame;
   item->aux_data = aux_data;
   item->seq = session->next_seq++;
+  item->cycle = 0;
+  item->stream = NULL;
+  item->stream_next = NULL;
   /* Set priority to the default value at the moment. */
   item->pri = NGHTTP2_PRI_DEFAULT;
   if(frame_cat == NGHTTP2_CAT_CTRL) {
@@ -394,6 +537,7 @@ int nghttp2_session_add_frame(nghttp2_session *session,
         stream = nghttp2_session_get_stream(session, frame->hd.stream_id);
         if(stream) {
           item->pri = stream->pri;
+          nghttp2_stream_attach_pri_item(stream, item);
         }
       }
       break;
@@ -415,6 +559,7 @@ int nghttp2_session_add_frame(nghttp2_session *session,
       stream = nghttp2_session_get_stream(session, frame->hd.stream_id);
       if(stream) {
         item->pri = stream->pri;
+        nghttp2_stream_attach_pri_item(stream, item);
       }
       break;
     case NGHTTP2_PING:
@@ -435,9 +580,9 @@ int nghttp2_session_add_frame(nghttp2_session *session,
       /* TODO If 2 HEADERS are submitted for reserved stream, then
          both of them are queued into ob_ss_pq, which is not
          desirable. */
-      r = nghttp2_pq_push(&session->ob_ss_pq, item);
+      r = nghttp2_pq_push(&session->ob_ss_pq, &item->pq_entry);
     } else {
-      r = nghttp2_pq_push(&session->ob_pq, item);
+      r = nghttp2_pq_push(&session->ob_pq, &item->pq_entry);
     }
   } else if(frame_cat == NGHTTP2_CAT_DATA) {
     nghttp2_data *data_frame = (nghttp2_data*)abs_frame;
@@ -445,14 +590,18 @@ int nghttp2_session_add_frame(nghttp2_session *session,
     stream = nghttp2_session_get_stream(session, data_frame->hd.stream_id);
     if(stream) {
       item->pri = stream->pri;
+      nghttp2_stream_attach_pri_item(stream, item);
     }
-    r = nghttp2_pq_push(&session->ob_pq, item);
+    nghttp2_session_update_data_cycle(session, item,
+                                      NGHTTP2_DATA_PAYLOAD_LENGTH);
+    r = nghttp2_pq_push(&session->ob_pq, &item->pq_entry);
   } else {
     /* Unreachable */
     assert(0);
   }
   if(r != 0) {
-    free(item);
+    nghttp2_outbound_item_detach_stream(item);
+    nghttp2_objpool_put(&session->item_pool, item);
     return r;
   }
   return 0;
@@ -464,7 +613,7 @@ int nghttp2_session_add_rst_stream(nghttp2_session *session,
 {
   int r;
   nghttp2_frame *frame;
-  frame = malloc(sizeof(nghttp2_frame));
+  frame = nghttp2_objpool_get(&session->frame_pool);
   if(frame == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
@@ -472,7 +621,7 @@ int nghttp2_session_add_rst_stream(nghttp2_session *session,
   r = nghttp2_session_add_frame(session, NGHTTP2_CAT_CTRL, frame, NULL);
   if(r != 0) {
     nghttp2_frame_rst_stream_free(&frame->rst_stream);
-    free(frame);
+    nghttp2_objpool_put(&session->frame_pool, frame);
     return r;
   }
   return 0;
@@ -485,7 +634,8 @@ nghttp2_stream* nghttp2_session_open_stream(nghttp2_session *session,
                                             void *stream_user_data)
 {
   int r;
-  nghttp2_stream *stream = malloc(sizeof(nghttp2_stream));
+  nghttp2_stream *stream = nghttp2_mem_malloc(&session->mem,
+                                              sizeof(nghttp2_stream));
   if(stream == NULL) {
     return NULL;
   }
@@ -501,7 +651,7 @@ nghttp2_stream* nghttp2_session_open_stream(nghttp2_session *session,
                       stream_user_data);
   r = nghttp2_map_insert(&session->streams, &stream->map_entry);
   if(r != 0) {
-    free(stream);
+    nghttp2_mem_free(&session->mem, stream);
     return NULL;
   }
   if(initial_state == NGHTTP2_STREAM_RESERVED) {
@@ -567,8 +717,7 @@ int nghttp2_session_close_stream(nghttp2_session *session, int32_t stream_id,
     }
   }
   nghttp2_map_remove(&session->streams, stream_id);
-  nghttp2_stream_free(stream);
-  free(stream);
+  nghttp2_session_stream_del(session, stream);
   return 0;
 }
 
@@ -1202,20 +1351,19 @@ nghttp2_outbound_item* nghttp2_session_get_next_ob_item
       if(nghttp2_session_is_outgoing_concurrent_streams_max(session)) {
         return NULL;
       } else {
-        return nghttp2_pq_top(&session->ob_ss_pq);
+        return (nghttp2_outbound_item*)nghttp2_pq_top(&session->ob_ss_pq);
       }
     }
   } else {
     if(nghttp2_pq_empty(&session->ob_ss_pq)) {
-      return nghttp2_pq_top(&session->ob_pq);
+      return (nghttp2_outbound_item*)nghttp2_pq_top(&session->ob_pq);
     } else {
       nghttp2_outbound_item *item, *headers_item;
-      item = nghttp2_pq_top(&session->ob_pq);
-      headers_item = nghttp2_pq_top(&session->ob_ss_pq);
+      item = (nghttp2_outbound_item*)nghttp2_pq_top(&session->ob_pq);
+      headers_item =
+        (nghttp2_outbound_item*)nghttp2_pq_top(&session->ob_ss_pq);
       if(nghttp2_session_is_outgoing_concurrent_streams_max(session) ||
-         item->pri < headers_item->pri ||
-         (item->pri == headers_item->pri &&
-          item->seq < headers_item->seq)) {
+         nghttp2_outbound_item_compar(item, headers_item) < 0) {
         return item;
       } else {
         return headers_item;
@@ -1237,7 +1385,7 @@ nghttp2_outbound_item* nghttp2_session_pop_next_ob_item
         return NULL;
       } else {
         nghttp2_outbound_item *item;
-        item = nghttp2_pq_top(&session->ob_ss_pq);
+        item = (nghttp2_outbound_item*)nghttp2_pq_top(&session->ob_ss_pq);
         nghttp2_pq_pop(&session->ob_ss_pq);
         return item;
       }
@@ -1245,17 +1393,16 @@ nghttp2_outbound_item* nghttp2_session_pop_next_ob_item
   } else {
     if(nghttp2_pq_empty(&session->ob_ss_pq)) {
       nghttp2_outbound_item *item;
-      item = nghttp2_pq_top(&session->ob_pq);
+      item = (nghttp2_outbound_item*)nghttp2_pq_top(&session->ob_pq);
       nghttp2_pq_pop(&session->ob_pq);
       return item;
     } else {
       nghttp2_outbound_item *item, *headers_item;
-      item = nghttp2_pq_top(&session->ob_pq);
-      headers_item = nghttp2_pq_top(&session->ob_ss_pq);
+      item = (nghttp2_outbound_item*)nghttp2_pq_top(&session->ob_pq);
+      headers_item =
+        (nghttp2_outbound_item*)nghttp2_pq_top(&session->ob_ss_pq);
       if(nghttp2_session_is_outgoing_concurrent_streams_max(session) ||
-         item->pri < headers_item->pri ||
-         (item->pri == headers_item->pri &&
-          item->seq < headers_item->seq)) {
+         nghttp2_outbound_item_compar(item, headers_item) < 0) {
         nghttp2_pq_pop(&session->ob_pq);
         return item;
       } else {
@@ -1387,11 +1534,14 @@ static int nghttp2_session_after_frame_sent(nghttp2_session *session)
       /* nothing to do */
       break;
     }
-    nghttp2_active_outbound_item_reset(&session->aob);
+    nghttp2_active_outbound_item_reset(session);
   } else if(item->frame_cat == NGHTTP2_CAT_DATA) {
     int r;
     nghttp2_data *data_frame;
     data_frame = nghttp2_outbound_item_get_data_frame(session->aob.item);
+    if(session->last_cycle < session->aob.item->cycle) {
+      session->last_cycle = session->aob.item->cycle;
+    }
     if(session->callbacks.on_data_send_callback) {
       if(session->callbacks.on_data_send_callback
          (session,
@@ -1420,14 +1570,27 @@ static int nghttp2_session_after_frame_sent(nghttp2_session *session)
     if(data_frame->eof ||
        nghttp2_session_predicate_data_send(session,
                                            data_frame->hd.stream_id) != 0) {
-      nghttp2_active_outbound_item_reset(&session->aob);
+      nghttp2_active_outbound_item_reset(session);
     } else {
       nghttp2_outbound_item* next_item;
+      int cont;
       next_item = nghttp2_session_get_next_ob_item(session);
-      /* If priority of this stream is higher or equal to other stream
-         waiting at the top of the queue, we continue to send this
-         data. */
-      if(next_item == NULL || session->aob.item->pri <= next_item->pri) {
+      if(session->opt_flags & NGHTTP2_OPTMASK_FAIR_DATA_SCHEDULING) {
+        /* Charge this stream for the DATA just sent, and continue to
+           send it only if it is still the first in line. */
+        nghttp2_session_update_data_cycle
+          (session, session->aob.item,
+           session->aob.framebuflen - NGHTTP2_FRAME_HEAD_LENGTH);
+        cont = next_item == NULL ||
+          nghttp2_outbound_item_compar(session->aob.item, next_item) <= 0;
+      } else {
+        /* If priority of this stream is higher or equal to other
+           stream waiting at the top of the queue, we continue to send
+           this data. */
+        cont = next_item == NULL ||
+          session->aob.item->pri <= next_item->pri;
+      }
+      if(cont) {
         size_t next_readmax;
         nghttp2_stream *stream;
         stream = nghttp2_session_get_stream(session, data_frame->hd.stream_id);
@@ -1438,7 +1601,7 @@ static int nghttp2_session_after_frame_sent(nghttp2_session *session)
           nghttp2_stream_defer_data(stream, session->aob.item,
                                     NGHTTP2_DEFERRED_FLOW_CONTROL);
           session->aob.item = NULL;
-          nghttp2_active_outbound_item_reset(&session->aob);
+          nghttp2_active_outbound_item_reset(session);
           return 0;
         }
         r = nghttp2_session_pack_data(session,
@@ -1450,35 +1613,35 @@ static int nghttp2_session_after_frame_sent(nghttp2_session *session)
           nghttp2_stream_defer_data(stream, session->aob.item,
                                     NGHTTP2_DEFERRED_NONE);
           session->aob.item = NULL;
-          nghttp2_active_outbound_item_reset(&session->aob);
+          nghttp2_active_outbound_item_reset(session);
         } else if(r == NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE) {
           /* Stop DATA frame chain and issue RST_STREAM to close the
              stream.  We don't return
              NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE intentionally. */
           r = nghttp2_session_add_rst_stream(session, data_frame->hd.stream_id,
                                              NGHTTP2_INTERNAL_ERROR);
-          nghttp2_active_outbound_item_reset(&session->aob);
+          nghttp2_active_outbound_item_reset(session);
           if(r != 0) {
             return r;
           }
         } else if(r < 0) {
           /* In this context, r is either NGHTTP2_ERR_NOMEM or
              NGHTTP2_ERR_CALLBACK_FAILURE */
-          nghttp2_active_outbound_item_reset(&session->aob);
+          nghttp2_active_outbound_item_reset(session);
           return r;
         } else {
           session->aob.framebuflen = r;
           session->aob.framebufoff = 0;
         }
       } else {
-        r = nghttp2_pq_push(&session->ob_pq, session->aob.item);
+        r = nghttp2_pq_push(&session->ob_pq, &session->aob.item->pq_entry);
         if(r == 0) {
           session->aob.item = NULL;
-          nghttp2_active_outbound_item_reset(&session->aob);
+          nghttp2_active_outbound_item_reset(session);
         } else {
           /* FATAL error */
           assert(r < NGHTTP2_ERR_FATAL);
-          nghttp2_active_outbound_item_reset(&session->aob);
+          nghttp2_active_outbound_item_reset(session);
           return r;
         }
       }
@@ -1490,6 +1653,128 @@ static int nghttp2_session_after_frame_sent(nghttp2_session *session)
   return 0;
 }
 
+/*
+ * Consumes the connection-level and stream-level remote window by the
+ * payload length of the DATA frame which is currently sent.
+ */
+static void nghttp2_session_consume_remote_window(nghttp2_session *session)
+{
+  nghttp2_data *frame;
+  nghttp2_stream *stream;
+  uint16_t len = nghttp2_get_uint16(&session->aob.framebuf[0]);
+  frame = nghttp2_outbound_item_get_data_frame(session->aob.item);
+  stream = nghttp2_session_get_stream(session, frame->hd.stream_id);
+  if(stream && stream->remote_flow_control) {
+    stream->remote_window_size -= len;
+  }
+  if(session->remote_flow_control) {
+    session->remote_window_size -= len;
+  }
+}
+
+/*
+ * Sends DATA frame whose payload was not copied into framebuf, using
+ * send_data_callback. The framebuf only contains the frame header.
+ *
+ * This function returns 0 if the whole frame is sent, or one of the
+ * following negative error codes:
+ *
+ * NGHTTP2_ERR_WOULDBLOCK
+ *     The callback could not send the frame without blocking.
+ * NGHTTP2_ERR_CALLBACK_FAILURE
+ *     The callback function failed.
+ */
+static int nghttp2_session_send_data_no_copy(nghttp2_session *session)
+{
+  int r;
+  nghttp2_data *frame;
+  frame = nghttp2_outbound_item_get_data_frame(session->aob.item);
+  r = session->callbacks.send_data_callback
+    (session, session->aob.framebuf,
+     session->aob.framebuflen - NGHTTP2_FRAME_HEAD_LENGTH,
+     frame->hd.stream_id, &frame->data_prd.source, session->user_data);
+  if(r == 0 || r == NGHTTP2_ERR_WOULDBLOCK) {
+    return r;
+  }
+  return NGHTTP2_ERR_CALLBACK_FAILURE;
+}
+
+/*
+ * Called when the frame in session->aob is completely sent, or
+ * completely stored in the batch buffer.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory.
+ * NGHTTP2_ERR_CALLBACK_FAILURE
+ *     The callback function failed.
+ */
+static int nghttp2_session_on_frame_completely_sent(nghttp2_session *session)
+{
+  int r;
+  if(session->aob.item->frame_cat == NGHTTP2_CAT_DATA) {
+    nghttp2_session_consume_remote_window(session);
+  }
+  r = nghttp2_session_after_frame_sent(session);
+  if(r < 0) {
+    /* FATAL */
+    assert(r < NGHTTP2_ERR_FATAL);
+    return r;
+  }
+  return 0;
+}
+
+/*
+ * Returns nonzero if the rest of the frame in session->aob can be
+ * appended to the batch buffer.
+ */
+static int nghttp2_session_batch_fits(nghttp2_session *session)
+{
+  if(session->batch.buf == NULL ||
+     (session->aob.item->frame_cat == NGHTTP2_CAT_DATA &&
+      nghttp2_outbound_item_get_data_frame(session->aob.item)->no_copy)) {
+    return 0;
+  }
+  return session->batch.buflen +
+    (session->aob.framebuflen - session->aob.framebufoff) <=
+    session->batch.bufmax;
+}
+
+/*
+ * Sends the frames stored in the batch buffer.
+ *
+ * This function returns 0 if all frames in the buffer are sent, or
+ * one of the following negative error codes:
+ *
+ * NGHTTP2_ERR_WOULDBLOCK
+ *     The send_callback could not send them without blocking.
+ * NGHTTP2_ERR_CALLBACK_FAILURE
+ *     The callback function failed.
+ */
+static int nghttp2_session_flush_batch(nghttp2_session *session)
+{
+  nghttp2_send_batch *batch = &session->batch;
+  while(batch->bufoff < batch->buflen) {
+    ssize_t sentlen;
+    sentlen = session->callbacks.send_callback(session,
+                                               batch->buf + batch->bufoff,
+                                               batch->buflen - batch->bufoff,
+                                               0, session->user_data);
+    if(sentlen < 0) {
+      if(sentlen == NGHTTP2_ERR_WOULDBLOCK) {
+        return NGHTTP2_ERR_WOULDBLOCK;
+      } else {
+        return NGHTTP2_ERR_CALLBACK_FAILURE;
+      }
+    }
+    batch->bufoff += sentlen;
+  }
+  batch->buflen = batch->bufoff = 0;
+  return 0;
+}
+
 int nghttp2_session_send(nghttp2_session *session)
 {
   int r;
@@ -1524,8 +1809,7 @@ int nghttp2_session_send(nghttp2_session *session)
             }
           }
         }
-        nghttp2_outbound_item_free(item);
-        free(item);
+        nghttp2_session_outbound_item_del(session, item);
 
         if(framebuflen == NGHTTP2_ERR_HEADER_COMP) {
           /* If header compression error occurred, should terminiate
@@ -1552,10 +1836,46 @@ int nghttp2_session_send(nghttp2_session *session)
         }
       }
     }
-    data = session->aob.framebuf + session->aob.framebufoff;
-    datalen = session->aob.framebuflen - session->aob.framebufoff;
-    sentlen = session->callbacks.send_callback(session, data, datalen, 0,
-                                               session->user_data);
+    if(session->batch.buf) {
+      if(nghttp2_session_batch_fits(session)) {
+        size_t len = session->aob.framebuflen - session->aob.framebufoff;
+        memcpy(session->batch.buf + session->batch.buflen,
+               session->aob.framebuf + session->aob.framebufoff, len);
+        session->batch.buflen += len;
+        session->aob.framebufoff = session->aob.framebuflen;
+        r = nghttp2_session_on_frame_completely_sent(session);
+        if(r != 0) {
+          return r;
+        }
+        continue;
+      }
+      /* Flush the buffer first to keep the order of frames. */
+      r = nghttp2_session_flush_batch(session);
+      if(r == NGHTTP2_ERR_WOULDBLOCK) {
+        return 0;
+      } else if(r != 0) {
+        return r;
+      }
+      if(nghttp2_session_batch_fits(session)) {
+        continue;
+      }
+      /* The frame is too large to be coalesced; send it directly. */
+    }
+    if(session->aob.item->frame_cat == NGHTTP2_CAT_DATA &&
+       nghttp2_outbound_item_get_data_frame(session->aob.item)->no_copy) {
+      r = nghttp2_session_send_data_no_copy(session);
+      if(r == NGHTTP2_ERR_WOULDBLOCK) {
+        return 0;
+      } else if(r != 0) {
+        return r;
+      }
+      sentlen = session->aob.framebuflen - session->aob.framebufoff;
+    } else {
+      data = session->aob.framebuf + session->aob.framebufoff;
+      datalen = session->aob.framebuflen - session->aob.framebufoff;
+      sentlen = session->callbacks.send_callback(session, data, datalen, 0,
+                                                 session->user_data);
+    }
     if(sentlen < 0) {
       if(sentlen == NGHTTP2_ERR_WOULDBLOCK) {
         return 0;
@@ -1564,31 +1884,20 @@ int nghttp2_session_send(nghttp2_session *session)
       }
     } else {
       session->aob.framebufoff += sentlen;
-      if(session->aob.item->frame_cat == NGHTTP2_CAT_DATA) {
-        nghttp2_data *frame;
-        nghttp2_stream *stream;
-        uint16_t len = nghttp2_get_uint16(&session->aob.framebuf[0]);
-        frame = nghttp2_outbound_item_get_data_frame(session->aob.item);
-        stream = nghttp2_session_get_stream(session, frame->hd.stream_id);
-        if(stream && stream->remote_flow_control) {
-          stream->remote_window_size -= len;
-        }
-        if(session->remote_flow_control) {
-          session->remote_window_size -= len;
-        }
-      }
       if(session->aob.framebufoff == session->aob.framebuflen) {
         /* Frame has completely sent */
-        r = nghttp2_session_after_frame_sent(session);
-        if(r < 0) {
-          /* FATAL */
-          assert(r < NGHTTP2_ERR_FATAL);
+        r = nghttp2_session_on_frame_completely_sent(session);
+        if(r != 0) {
           return r;
         }
       }
     }
   }
-  return 0;
+  r = nghttp2_session_flush_batch(session);
+  if(r == NGHTTP2_ERR_WOULDBLOCK) {
+    return 0;
+  }
+  return r;
 }
 
 static ssize_t nghttp2_recv(nghttp2_session *session, uint8_t *buf, size_t len)
@@ -1620,10 +1929,85 @@ static int nghttp2_session_call_on_request_recv
   return 0;
 }
 
+typedef struct {
+  nghttp2_session *session;
+  nghttp2_frame *frame;
+} nghttp2_emit_header_arg;
+
+static int nghttp2_session_emit_header(nghttp2_nv *nv, void *ptr)
+{
+  nghttp2_emit_header_arg *arg = (nghttp2_emit_header_arg*)ptr;
+  nghttp2_session *session = arg->session;
+  if(session->callbacks.on_header_callback(session, arg->frame,
+                                           nv->name, nv->namelen,
+                                           nv->value, nv->valuelen,
+                                           session->user_data) != 0) {
+    return NGHTTP2_ERR_CALLBACK_FAILURE;
+  }
+  return 0;
+}
+
+static int nghttp2_session_discard_header(nghttp2_nv *nv, void *ptr)
+{
+  return 0;
+}
+
+/*
+ * Inflates the pending header block session->hdblock of the |frame|.
+ * If |emit| is nonzero, on_header_callback is invoked for each
+ * header. Otherwise, the header block is just consumed to keep the
+ * header table in sync.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGHTTP2_ERR_HEADER_COMP
+ *     Inflation process has failed.
+ * NGHTTP2_ERR_NOMEM
+ *     Out of memory.
+ * NGHTTP2_ERR_CALLBACK_FAILURE
+ *     The callback function failed.
+ */
+static int nghttp2_session_inflate_hdblock(nghttp2_session *session,
+                                           nghttp2_frame *frame,
+                                           int emit)
+{
+  ssize_t rv;
+  nghttp2_emit_header_arg arg;
+  const uint8_t *in = session->hdblock;
+  size_t inlen = session->hdblocklen;
+  session->hdblock = NULL;
+  session->hdblocklen = 0;
+  arg.session = session;
+  arg.frame = frame;
+  rv = nghttp2_hd_inflate_hd_emit(&session->hd_inflater,
+                                  (uint8_t*)in, inlen,
+                                  emit ?
+                                  nghttp2_session_emit_header :
+                                  nghttp2_session_discard_header,
+                                  &arg);
+  if(rv < 0) {
+    return rv;
+  }
+  return 0;
+}
+
 static int nghttp2_session_call_on_frame_received
 (nghttp2_session *session, nghttp2_frame *frame)
 {
   int rv;
+  if(session->hdblock &&
+     (frame->hd.type == NGHTTP2_HEADERS ||
+      frame->hd.type == NGHTTP2_PUSH_PROMISE)) {
+    rv = nghttp2_session_inflate_hdblock(session, frame, 1);
+    if(nghttp2_is_fatal(rv)) {
+      return rv;
+    }
+    if(rv != 0) {
+      return nghttp2_session_fail_session(session,
+                                          NGHTTP2_COMPRESSION_ERROR);
+    }
+  }
   if(session->callbacks.on_frame_recv_callback) {
     rv = session->callbacks.on_frame_recv_callback(session, frame,
                                                    session->user_data);
@@ -1683,7 +2067,7 @@ static int nghttp2_session_handle_parse_error(nghttp2_session *session,
         type,
         session->iframe.headbuf,
         sizeof(session->iframe.headbuf),
-        session->iframe.buf,
+        session->iframe.payload,
         session->iframe.buflen,
         lib_error_code,
         session->user_data) != 0) {
@@ -2003,7 +2387,8 @@ static int nghttp2_update_remote_initial_window_size_func
      stream->remote_window_size > 0 &&
      (arg->session->remote_flow_control == 0 ||
       arg->session->remote_window_size > 0)) {
-    rv = nghttp2_pq_push(&arg->session->ob_pq, stream->deferred_data);
+    rv = nghttp2_session_push_deferred_data(arg->session,
+                                            stream->deferred_data);
     if(rv != 0) {
       /* FATAL */
       assert(rv < NGHTTP2_ERR_FATAL);
@@ -2111,7 +2496,7 @@ static int nghttp2_disable_remote_flow_control_func(nghttp2_map_entry *entry,
   if(stream->deferred_data &&
      (stream->deferred_flags & NGHTTP2_DEFERRED_FLOW_CONTROL)) {
     int rv;
-    rv = nghttp2_pq_push(&session->ob_pq, stream->deferred_data);
+    rv = nghttp2_session_push_deferred_data(session, stream->deferred_data);
     if(rv == 0) {
       nghttp2_stream_detach_deferred_data(stream);
     } else {
@@ -2372,7 +2757,7 @@ static int nghttp2_push_back_deferred_data_func(nghttp2_map_entry *entry,
      (stream->deferred_flags & NGHTTP2_DEFERRED_FLOW_CONTROL) &&
      (stream->remote_flow_control == 0 || stream->remote_window_size > 0)) {
     int rv;
-    rv = nghttp2_pq_push(&session->ob_pq, stream->deferred_data);
+    rv = nghttp2_session_push_deferred_data(session, stream->deferred_data);
     if(rv == 0) {
       nghttp2_stream_detach_deferred_data(stream);
     } else {
@@ -2453,7 +2838,7 @@ static int session_on_stream_window_update_received
       session->remote_window_size > 0) &&
      stream->deferred_data != NULL &&
      (stream->deferred_flags & NGHTTP2_DEFERRED_FLOW_CONTROL)) {
-    rv = nghttp2_pq_push(&session->ob_pq, stream->deferred_data);
+    rv = nghttp2_session_push_deferred_data(session, stream->deferred_data);
     if(rv != 0) {
       /* FATAL */
       assert(rv < NGHTTP2_ERR_FATAL);
@@ -2484,6 +2869,33 @@ static int get_error_code_from_lib_error_code(int lib_error_code)
   }
 }
 
+/*
+ * Consumes the header block of |frame| if it was not inflated while
+ * the frame was processed, e.g., because the frame was rejected. The
+ * |rv| is the return value of the frame processing. This function
+ * returns |rv| if it is nonzero. Otherwise it returns 0 or fatal
+ * error.
+ */
+static int nghttp2_session_discard_hdblock(nghttp2_session *session,
+                                           nghttp2_frame *frame, int rv)
+{
+  int r;
+  if(session->hdblock == NULL) {
+    return rv;
+  }
+  r = nghttp2_session_inflate_hdblock(session, frame, 0);
+  if(rv != 0) {
+    return rv;
+  }
+  if(nghttp2_is_fatal(r)) {
+    return r;
+  }
+  if(r != 0) {
+    return nghttp2_session_fail_session(session, NGHTTP2_COMPRESSION_ERROR);
+  }
+  return 0;
+}
+
 /* For errors, this function only returns FATAL error. */
 static int nghttp2_session_process_ctrl_frame(nghttp2_session *session)
 {
@@ -2493,18 +2905,30 @@ static int nghttp2_session_process_ctrl_frame(nghttp2_session *session)
   type = session->iframe.headbuf[2];
   switch(type) {
   case NGHTTP2_HEADERS:
-    if(session->iframe.error_code == 0) {
+    if(session->iframe.error_code == 0 &&
+       session->callbacks.on_header_callback) {
+      r = nghttp2_frame_unpack_headers_without_nv
+        (&frame.headers,
+         session->iframe.headbuf, sizeof(session->iframe.headbuf),
+         session->iframe.payload, session->iframe.buflen);
+      if(r == 0) {
+        size_t nv_offset;
+        nv_offset = nghttp2_frame_headers_payload_nv_offset(&frame.headers);
+        session->hdblock = session->iframe.payload + nv_offset;
+        session->hdblocklen = session->iframe.buflen - nv_offset;
+      }
+    } else if(session->iframe.error_code == 0) {
       r = nghttp2_frame_unpack_headers(&frame.headers,
                                        session->iframe.headbuf,
                                        sizeof(session->iframe.headbuf),
-                                       session->iframe.buf,
+                                       session->iframe.payload,
                                        session->iframe.buflen,
                                        &session->hd_inflater);
     } else if(session->iframe.error_code == NGHTTP2_ERR_FRAME_TOO_LARGE) {
       r = nghttp2_frame_unpack_headers_without_nv
         (&frame.headers,
          session->iframe.headbuf, sizeof(session->iframe.headbuf),
-         session->iframe.buf, session->iframe.buflen);
+         session->iframe.payload, session->iframe.buflen);
       if(r == 0) {
         r = session->iframe.error_code;
       }
@@ -2537,6 +2961,7 @@ static int nghttp2_session_process_ctrl_frame(nghttp2_session *session)
         frame.headers.cat = NGHTTP2_HCAT_REQUEST;
         r = nghttp2_session_on_request_headers_received(session, &frame);
       }
+      r = nghttp2_session_discard_hdblock(session, &frame, r);
       nghttp2_frame_headers_free(&frame.headers);
       nghttp2_hd_end_headers(&session->hd_inflater);
     } else if(nghttp2_is_non_fatal(r)) {
@@ -2548,7 +2973,7 @@ static int nghttp2_session_process_ctrl_frame(nghttp2_session *session)
     r = nghttp2_frame_unpack_priority(&frame.priority,
                                       session->iframe.headbuf,
                                       sizeof(session->iframe.headbuf),
-                                      session->iframe.buf,
+                                      session->iframe.payload,
                                       session->iframe.buflen);
     if(r == 0) {
       r = nghttp2_session_on_priority_received(session, &frame);
@@ -2562,7 +2987,7 @@ static int nghttp2_session_process_ctrl_frame(nghttp2_session *session)
     r = nghttp2_frame_unpack_rst_stream(&frame.rst_stream,
                                         session->iframe.headbuf,
                                         sizeof(session->iframe.headbuf),
-                                        session->iframe.buf,
+                                        session->iframe.payload,
                                         session->iframe.buflen);
     if(r == 0) {
       r = nghttp2_session_on_rst_stream_received(session, &frame);
@@ -2576,7 +3001,7 @@ static int nghttp2_session_process_ctrl_frame(nghttp2_session *session)
     r = nghttp2_frame_unpack_settings(&frame.settings,
                                       session->iframe.headbuf,
                                       sizeof(session->iframe.headbuf),
-                                      session->iframe.buf,
+                                      session->iframe.payload,
                                       session->iframe.buflen);
     if(r == 0) {
       r = nghttp2_session_on_settings_received(session, &frame);
@@ -2587,11 +3012,23 @@ static int nghttp2_session_process_ctrl_frame(nghttp2_session *session)
     }
     break;
   case NGHTTP2_PUSH_PROMISE:
-    if(session->iframe.error_code == 0) {
+    if(session->iframe.error_code == 0 &&
+       session->callbacks.on_header_callback) {
+      r = nghttp2_frame_unpack_push_promise_without_nv
+        (&frame.push_promise,
+         session->iframe.headbuf, sizeof(session->iframe.headbuf),
+         session->iframe.payload, session->iframe.buflen);
+      if(r == 0) {
+        session->hdblock = session->iframe.payload +
+          NGHTTP2_PUSH_PROMISE_PAYLOAD_NV_OFFSET;
+        session->hdblocklen = session->iframe.buflen -
+          NGHTTP2_PUSH_PROMISE_PAYLOAD_NV_OFFSET;
+      }
+    } else if(session->iframe.error_code == 0) {
       r = nghttp2_frame_unpack_push_promise(&frame.push_promise,
                                             session->iframe.headbuf,
                                             sizeof(session->iframe.headbuf),
-                                            session->iframe.buf,
+                                            session->iframe.payload,
                                             session->iframe.buflen,
                                             &session->hd_inflater);
     } else {
@@ -2599,6 +3036,7 @@ static int nghttp2_session_process_ctrl_frame(nghttp2_session *session)
     }
     if(r == 0) {
       r = nghttp2_session_on_push_promise_received(session, &frame);
+      r = nghttp2_session_discard_hdblock(session, &frame, r);
       nghttp2_frame_push_promise_free(&frame.push_promise);
       nghttp2_hd_end_headers(&session->hd_inflater);
     } else if(nghttp2_is_non_fatal(r)) {
@@ -2610,7 +3048,7 @@ static int nghttp2_session_process_ctrl_frame(nghttp2_session *session)
     r = nghttp2_frame_unpack_ping(&frame.ping,
                                   session->iframe.headbuf,
                                   sizeof(session->iframe.headbuf),
-                                  session->iframe.buf,
+                                  session->iframe.payload,
                                   session->iframe.buflen);
     if(r == 0) {
       r = nghttp2_session_on_ping_received(session, &frame);
@@ -2624,7 +3062,7 @@ static int nghttp2_session_process_ctrl_frame(nghttp2_session *session)
     r = nghttp2_frame_unpack_goaway(&frame.goaway,
                                     session->iframe.headbuf,
                                     sizeof(session->iframe.headbuf),
-                                    session->iframe.buf,
+                                    session->iframe.payload,
                                     session->iframe.buflen);
     if(r == 0) {
       r = nghttp2_session_on_goaway_received(session, &frame);
@@ -2638,7 +3076,7 @@ static int nghttp2_session_process_ctrl_frame(nghttp2_session *session)
     r = nghttp2_frame_unpack_window_update(&frame.window_update,
                                            session->iframe.headbuf,
                                            sizeof(session->iframe.headbuf),
-                                           session->iframe.buf,
+                                           session->iframe.payload,
                                            session->iframe.buflen);
     if(r == 0) {
       r = nghttp2_session_on_window_update_received(session, &frame);
@@ -2655,7 +3093,7 @@ static int nghttp2_session_process_ctrl_frame(nghttp2_session *session)
          (session,
           session->iframe.headbuf,
           sizeof(session->iframe.headbuf),
-          session->iframe.buf,
+          session->iframe.payload,
           session->iframe.buflen,
           session->user_data) != 0) {
         r = NGHTTP2_ERR_CALLBACK_FAILURE;
@@ -2926,15 +3364,21 @@ ssize_t nghttp2_session_mem_recv(nghttp2_session *session,
           }
         } else if(!nghttp2_frame_is_data_frame(session->iframe.headbuf)) {
           /* non-DATA frame */
-          ssize_t buflen = session->iframe.payloadlen;
-          session->iframe.buflen = buflen;
-          r = nghttp2_reserve_buffer(&session->iframe.buf,
-                                     &session->iframe.bufmax,
-                                     buflen);
-          if(r != 0) {
-            /* FATAL */
-            assert(r < NGHTTP2_ERR_FATAL);
-            return r;
+          session->iframe.buflen = session->iframe.payloadlen;
+          if((size_t)(inlimit-inmark) >= session->iframe.payloadlen) {
+            /* The whole payload is available in the input. Process it
+               in place. */
+            session->iframe.payload = inmark;
+          } else {
+            r = nghttp2_reserve_buffer(&session->iframe.buf,
+                                       &session->iframe.bufmax,
+                                       session->iframe.buflen);
+            if(r != 0) {
+              /* FATAL */
+              assert(r < NGHTTP2_ERR_FATAL);
+              return r;
+            }
+            session->iframe.payload = session->iframe.buf;
           }
         } else {
           /* Check stream is open. If it is not open or closing,
@@ -2964,7 +3408,8 @@ ssize_t nghttp2_session_mem_recv(nghttp2_session *session,
       }
       readlen =  nghttp2_min(bufavail, rempayloadlen);
       if(!nghttp2_frame_is_data_frame(session->iframe.headbuf)) {
-        if(session->iframe.state != NGHTTP2_RECV_PAYLOAD_IGN) {
+        if(session->iframe.state != NGHTTP2_RECV_PAYLOAD_IGN &&
+           session->iframe.payload == session->iframe.buf) {
           memcpy(session->iframe.buf+session->iframe.off, inmark, readlen);
         }
       } else {
@@ -3081,6 +3526,11 @@ int nghttp2_session_want_read(nghttp2_session *session)
 
 int nghttp2_session_want_write(nghttp2_session *session)
 {
+  /* Coalesced frames which have not been sent must be flushed even if
+     GOAWAY is in them. */
+  if(session->batch.bufoff < session->batch.buflen) {
+    return 1;
+  }
   /* If these flags are set, we don't want to write any data. The
      application should drop the connection. */
   if((session->goaway_flags & NGHTTP2_GOAWAY_FAIL_ON_SEND) &&
@@ -3105,7 +3555,7 @@ int nghttp2_session_add_ping(nghttp2_session *session, uint8_t flags,
 {
   int r;
   nghttp2_frame *frame;
-  frame = malloc(sizeof(nghttp2_frame));
+  frame = nghttp2_objpool_get(&session->frame_pool);
   if(frame == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
@@ -3113,7 +3563,7 @@ int nghttp2_session_add_ping(nghttp2_session *session, uint8_t flags,
   r = nghttp2_session_add_frame(session, NGHTTP2_CAT_CTRL, frame, NULL);
   if(r != 0) {
     nghttp2_frame_ping_free(&frame->ping);
-    free(frame);
+    nghttp2_objpool_put(&session->frame_pool, frame);
   }
   return r;
 }
@@ -3136,7 +3586,7 @@ int nghttp2_session_add_goaway(nghttp2_session *session,
     }
     memcpy(opaque_data_copy, opaque_data, opaque_data_len);
   }
-  frame = malloc(sizeof(nghttp2_frame));
+  frame = nghttp2_objpool_get(&session->frame_pool);
   if(frame == NULL) {
     free(opaque_data_copy);
     return NGHTTP2_ERR_NOMEM;
@@ -3146,7 +3596,7 @@ int nghttp2_session_add_goaway(nghttp2_session *session,
   r = nghttp2_session_add_frame(session, NGHTTP2_CAT_CTRL, frame, NULL);
   if(r != 0) {
     nghttp2_frame_goaway_free(&frame->goaway);
-    free(frame);
+    nghttp2_objpool_put(&session->frame_pool, frame);
   }
   return r;
 }
@@ -3157,7 +3607,7 @@ int nghttp2_session_add_window_update(nghttp2_session *session, uint8_t flags,
 {
   int r;
   nghttp2_frame *frame;
-  frame = malloc(sizeof(nghttp2_frame));
+  frame = nghttp2_objpool_get(&session->frame_pool);
   if(frame == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
@@ -3166,7 +3616,7 @@ int nghttp2_session_add_window_update(nghttp2_session *session, uint8_t flags,
   r = nghttp2_session_add_frame(session, NGHTTP2_CAT_CTRL, frame, NULL);
   if(r != 0) {
     nghttp2_frame_window_update_free(&frame->window_update);
-    free(frame);
+    nghttp2_objpool_put(&session->frame_pool, frame);
   }
   return r;
 }
@@ -3193,10 +3643,18 @@ ssize_t nghttp2_session_pack_data(nghttp2_session *session,
     /* This is the error code when callback is failed. */
     return NGHTTP2_ERR_CALLBACK_FAILURE;
   }
+  if(eof_flags & NGHTTP2_DATA_FLAG_NO_COPY) {
+    if(session->callbacks.send_data_callback == NULL) {
+      return NGHTTP2_ERR_CALLBACK_FAILURE;
+    }
+    frame->no_copy = 1;
+  } else {
+    frame->no_copy = 0;
+  }
   memset(*buf_ptr, 0, NGHTTP2_FRAME_HEAD_LENGTH);
   nghttp2_put_uint16be(&(*buf_ptr)[0], r);
   flags = 0;
-  if(eof_flags) {
+  if(eof_flags & NGHTTP2_DATA_FLAG_EOF) {
     frame->eof = 1;
     if(frame->hd.flags & NGHTTP2_FLAG_END_STREAM) {
       flags |= NGHTTP2_FLAG_END_STREAM;
@@ -3228,7 +3686,7 @@ int nghttp2_session_resume_data(nghttp2_session *session, int32_t stream_id)
      (stream->deferred_flags & NGHTTP2_DEFERRED_FLOW_CONTROL)) {
     return NGHTTP2_ERR_INVALID_ARGUMENT;
   }
-  r = nghttp2_pq_push(&session->ob_pq, stream->deferred_data);
+  r = nghttp2_session_push_deferred_data(session, stream->deferred_data);
   if(r == 0) {
     nghttp2_stream_detach_deferred_data(stream);
   }
@@ -3245,12 +3703,15 @@ int nghttp2_session_set_option(nghttp2_session *session,
 {
   switch(optname) {
   case NGHTTP2_OPT_NO_AUTO_STREAM_WINDOW_UPDATE:
-  case NGHTTP2_OPT_NO_AUTO_CONNECTION_WINDOW_UPDATE: {
+  case NGHTTP2_OPT_NO_AUTO_CONNECTION_WINDOW_UPDATE:
+  case NGHTTP2_OPT_FAIR_DATA_SCHEDULING: {
     int flag;
     if(optname == NGHTTP2_OPT_NO_AUTO_STREAM_WINDOW_UPDATE) {
       flag = NGHTTP2_OPTMASK_NO_AUTO_STREAM_WINDOW_UPDATE;
-    } else {
+    } else if(optname == NGHTTP2_OPT_NO_AUTO_CONNECTION_WINDOW_UPDATE) {
       flag = NGHTTP2_OPTMASK_NO_AUTO_CONNECTION_WINDOW_UPDATE;
+    } else {
+      flag = NGHTTP2_OPTMASK_FAIR_DATA_SCHEDULING;
     }
     if(optlen == sizeof(int)) {
       int intval = *(int*)optval;
@@ -3264,6 +3725,30 @@ int nghttp2_session_set_option(nghttp2_session *session,
     }
     break;
   }
+  case NGHTTP2_OPT_SEND_BATCH_SIZE: {
+    int intval;
+    uint8_t *buf = NULL;
+    if(optlen != sizeof(int)) {
+      return NGHTTP2_ERR_INVALID_ARGUMENT;
+    }
+    intval = *(int*)optval;
+    if(intval < 0) {
+      return NGHTTP2_ERR_INVALID_ARGUMENT;
+    }
+    if(session->batch.buflen > 0) {
+      return NGHTTP2_ERR_INVALID_STATE;
+    }
+    if(intval > 0) {
+      buf = malloc(intval);
+      if(buf == NULL) {
+        return NGHTTP2_ERR_NOMEM;
+      }
+    }
+    free(session->batch.buf);
+    session->batch.buf = buf;
+    session->batch.bufmax = intval;
+    break;
+  }
   default:
     return NGHTTP2_ERR_INVALID_ARGUMENT;
   }
@@ -37,21 +37,23 @@
 #include "nghttp2_stream.h"
 #include "nghttp2_buffer.h"
 #include "nghttp2_outbound_item.h"
+#include "nghttp2_mem.h"
 
 /*
  * Option flags.
  */
 typedef enum {
   NGHTTP2_OPTMASK_NO_AUTO_STREAM_WINDOW_UPDATE = 1 << 0,
-  NGHTTP2_OPTMASK_NO_AUTO_CONNECTION_WINDOW_UPDATE = 1 << 1
+  NGHTTP2_OPTMASK_NO_AUTO_CONNECTION_WINDOW_UPDATE = 1 << 1,
+  NGHTTP2_OPTMASK_FAIR_DATA_SCHEDULING = 1 << 2
 } nghttp2_optmask;
 
 typedef struct {
   nghttp2_outbound_item *item;
   /* Buffer for outbound frames. Used to pack one frame. The memory
-     pointed by framebuf is initially allocated by
-     nghttp2_session_{client,server}_new() and deallocated by
-     nghttp2_session_del() */
+     pointed by framebuf is allocated when the first frame is packed,
+     released by nghttp2_session_shrink() while no frame is being
+     sent and deallocated by nghttp2_session_del(). */
   uint8_t *framebuf;
   /* The capacity of framebuf in bytes */
   size_t framebufmax;
@@ -61,13 +63,26 @@ typedef struct {
   size_t framebufoff;
 } nghttp2_active_outbound_item;
 
+/* Buffer to coalesce several outbound frames into one send_callback
+   invocation. */
+typedef struct {
+  /* Buffer to store serialized frames. NULL if frame coalescing is
+     disabled. */
+  uint8_t *buf;
+  /* The capacity of buf in bytes */
+  size_t bufmax;
+  /* The number of bytes stored in buf */
+  size_t buflen;
+  /* The number of bytes in buf which have been sent */
+  size_t bufoff;
+} nghttp2_send_batch;
+
 /* Buffer length for inbound raw byte stream. */
 #define NGHTTP2_INBOUND_BUFFER_LENGTH 16384
 
-#define NGHTTP2_INITIAL_OUTBOUND_FRAMEBUF_LENGTH (NGHTTP2_DATA_PAYLOAD_LENGTH+8)
-#define NGHTTP2_INITIAL_INBOUND_FRAMEBUF_LENGTH \
-  NGHTTP2_INITIAL_OUTBOUND_FRAMEBUF_LENGTH
-#define NGHTTP2_INITIAL_NV_BUFFER_LENGTH 4096
+/* The maximum number of free objects kept in each free list of the
+   session */
+#define NGHTTP2_SESSION_OBJPOOL_MAX 64
 
 /* Internal state when receiving incoming frame */
 typedef enum {
@@ -84,10 +99,16 @@ typedef struct {
   uint8_t headbuf[NGHTTP2_FRAME_HEAD_LENGTH];
   /* How many bytes are filled in headbuf */
   size_t headbufoff;
-  /* Payload for non-DATA frames. */
+  /* Buffer for the payload of non-DATA frames which are split across
+     several reads. Allocated on demand. */
   uint8_t *buf;
   /* Capacity of buf */
   size_t bufmax;
+  /* Payload of the non-DATA frame being processed. This points to
+     buf, or directly into the input of nghttp2_session_mem_recv() if
+     the whole payload is contiguous there. In the latter case, the
+     payload is not copied. */
+  const uint8_t *payload;
   /* For frames without name/value header block, this is how many
      bytes are going to filled in buf. For frames with the block, buf
      only contains bytes that come before ther block, but this value
@@ -125,6 +146,9 @@ struct nghttp2_session {
   /* Sequence number of outbound frame to maintain the order of
      enqueue if priority is equal. */
   int64_t next_seq;
+  /* The cycle of the last DATA frame sent. This is the virtual time
+     of fair DATA scheduling. */
+  uint64_t last_cycle;
 
   nghttp2_map /* <nghttp2_stream*> */ streams;
   /* The number of outgoing streams. This will be capped by
@@ -141,13 +165,17 @@ struct nghttp2_session {
 
   nghttp2_active_outbound_item aob;
 
+  nghttp2_send_batch batch;
+
   nghttp2_inbound_frame iframe;
 
-  /* Buffer used to store inflated name/value pairs in wire format
-     temporarily on pack/unpack. */
-  uint8_t *nvbuf;
-  /* The number of bytes allocated for nvbuf */
-  size_t nvbuflen;
+  /* The header block in the received HEADERS or PUSH_PROMISE frame
+     which is not inflated yet. This is only used when
+     on_header_callback is set. The block is inflated right before
+     on_frame_recv_callback is invoked for the frame, or after the
+     frame is processed if it was rejected. */
+  const uint8_t *hdblock;
+  size_t hdblocklen;
 
   nghttp2_hd_context hd_deflater;
   nghttp2_hd_context hd_inflater;
@@ -189,6 +217,15 @@ struct nghttp2_session {
 
   nghttp2_session_callbacks callbacks;
   void *user_data;
+
+  /* Memory allocator */
+  nghttp2_mem mem;
+  /* Free lists of nghttp2_outbound_item, nghttp2_frame, nghttp2_data
+     and nghttp2_headers_aux_data respectively. */
+  nghttp2_objpool item_pool;
+  nghttp2_objpool frame_pool;
+  nghttp2_objpool data_pool;
+  nghttp2_objpool aux_pool;
 };
 
 /* Struct used when updating initial window size of each active
@@ -227,6 +264,14 @@ int nghttp2_session_add_frame(nghttp2_session *session,
                               nghttp2_frame_category frame_cat,
                               void *abs_frame, void *aux_data);
 
+/*
+ * Deallocates |item|, including its frame and auxiliary data, and
+ * returns them to the free lists of |session|. If |item| is NULL,
+ * this function does nothing.
+ */
+void nghttp2_session_outbound_item_del(nghttp2_session *session,
+                                       nghttp2_outbound_item *item);
+
 /*
  * Adds RST_STREAM frame for the stream |stream_id| with the error
  * code |error_code|. This is a convenient function built on top of
@@ -472,6 +517,10 @@ nghttp2_stream* nghttp2_session_get_stream(nghttp2_session *session,
  * are the DATA apyload and are filled using |frame->data_prd|. The
  * length of payload is at most |datamax| bytes.
  *
+ * If the read callback sets NGHTTP2_DATA_FLAG_NO_COPY, only the frame
+ * header is written, |frame->no_copy| is set to 1 and the return
+ * value still includes the length of the payload.
+ *
  * This function returns the size of packed frame if it succeeds, or
  * one of the following negative error codes:
  *
@@ -482,7 +531,8 @@ nghttp2_stream* nghttp2_session_get_stream(nghttp2_session *session,
  * NGHTTP2_ERR_NOMEM
  *     Out of memory.
  * NGHTTP2_ERR_CALLBACK_FAILURE
- *     The read_callback failed (session error).
+ *     The read_callback failed (session error); or
+ *     NGHTTP2_DATA_FLAG_NO_COPY is used without send_data_callback.
  */
 ssize_t nghttp2_session_pack_data(nghttp2_session *session,
                                   uint8_t **buf_ptr, size_t *buflen_ptr,
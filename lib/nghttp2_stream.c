@@ -42,6 +42,7 @@ void nghttp2_stream_init(nghttp2_stream *stream, int32_t stream_id,
   stream->state = initial_state;
   stream->shut_flags = NGHTTP2_SHUT_NONE;
   stream->stream_user_data = stream_user_data;
+  stream->pri_items = NULL;
   stream->deferred_data = NULL;
   stream->deferred_flags = NGHTTP2_DEFERRED_NONE;
   stream->remote_flow_control = remote_flow_control;
@@ -53,8 +54,8 @@ void nghttp2_stream_init(nghttp2_stream *stream, int32_t stream_id,
 
 void nghttp2_stream_free(nghttp2_stream *stream)
 {
-  nghttp2_outbound_item_free(stream->deferred_data);
-  free(stream->deferred_data);
+  /* The deferred DATA is freed by the session, since it is allocated
+     from the session's allocator. */
 }
 
 void nghttp2_stream_shutdown(nghttp2_stream *stream, nghttp2_shut_flag flag)
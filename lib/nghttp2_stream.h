@@ -78,7 +78,7 @@ typedef enum {
   NGHTTP2_DEFERRED_FLOW_CONTROL = 0x01
 } nghttp2_deferred_flag;
 
-typedef struct {
+typedef struct nghttp2_stream {
   /* Intrusive Map */
   nghttp2_map_entry map_entry;
   /* stream ID */
@@ -92,6 +92,10 @@ typedef struct {
   uint8_t shut_flags;
   /* The arbitrary data provided by user for this stream. */
   void *stream_user_data;
+  /* The list of the outbound items whose priority follows this
+     stream, linked by nghttp2_outbound_item.stream_next. This is used
+     to reprioritize them without walking the outbound queues. */
+  nghttp2_outbound_item *pri_items;
   /* Deferred DATA frame */
   nghttp2_outbound_item *deferred_data;
   /* The flags for defered DATA. Bitwise OR of zero or more
@@ -54,33 +54,31 @@ static int nghttp2_submit_headers_shared
     return NGHTTP2_ERR_INVALID_ARGUMENT;
   }
   if(data_prd != NULL && data_prd->read_callback != NULL) {
-    data_prd_copy = malloc(sizeof(nghttp2_data_provider));
+    data_prd_copy = nghttp2_mem_malloc(&session->mem,
+                                       sizeof(nghttp2_data_provider));
     if(data_prd_copy == NULL) {
       return NGHTTP2_ERR_NOMEM;
     }
     *data_prd_copy = *data_prd;
   }
   if(data_prd || stream_user_data) {
-    aux_data = malloc(sizeof(nghttp2_headers_aux_data));
+    aux_data = nghttp2_objpool_get(&session->aux_pool);
     if(aux_data == NULL) {
-      free(data_prd_copy);
-      return NGHTTP2_ERR_NOMEM;
+      r = NGHTTP2_ERR_NOMEM;
+      goto fail_aux_data;
     }
     aux_data->data_prd = data_prd_copy;
     aux_data->stream_user_data = stream_user_data;
   }
-  frame = malloc(sizeof(nghttp2_frame));
+  frame = nghttp2_objpool_get(&session->frame_pool);
   if(frame == NULL) {
-    free(aux_data);
-    free(data_prd_copy);
-    return NGHTTP2_ERR_NOMEM;
+    r = NGHTTP2_ERR_NOMEM;
+    goto fail_frame;
   }
-  nvlen = nghttp2_nv_array_from_cstr(&nva_copy, nv);
+  nvlen = nghttp2_nv_array_from_cstr_mem(&nva_copy, nv, &session->mem);
   if(nvlen < 0) {
-    free(frame);
-    free(aux_data);
-    free(data_prd_copy);
-    return nvlen;
+    r = nvlen;
+    goto fail_nva;
   }
   /* TODO Implement header continuation */
   flags_copy = (flags & (NGHTTP2_FLAG_END_STREAM | NGHTTP2_FLAG_PRIORITY)) |
@@ -91,10 +89,19 @@ static int nghttp2_submit_headers_shared
   r = nghttp2_session_add_frame(session, NGHTTP2_CAT_CTRL, frame,
                                 aux_data);
   if(r != 0) {
-    nghttp2_frame_headers_free(&frame->headers);
-    free(frame);
-    free(aux_data);
-    free(data_prd_copy);
+    goto fail_add_frame;
+  }
+  return 0;
+
+ fail_add_frame:
+  nghttp2_nv_array_del_mem(nva_copy, &session->mem);
+ fail_nva:
+  nghttp2_objpool_put(&session->frame_pool, frame);
+ fail_frame:
+  nghttp2_objpool_put(&session->aux_pool, aux_data);
+ fail_aux_data:
+  if(data_prd_copy) {
+    nghttp2_mem_free(&session->mem, data_prd_copy);
   }
   return r;
 }
@@ -126,7 +133,7 @@ int nghttp2_submit_priority(nghttp2_session *session, int32_t stream_id,
   if(stream == NULL) {
     return NGHTTP2_ERR_STREAM_CLOSED;
   }
-  frame = malloc(sizeof(nghttp2_frame));
+  frame = nghttp2_objpool_get(&session->frame_pool);
   if(frame == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
@@ -134,7 +141,7 @@ int nghttp2_submit_priority(nghttp2_session *session, int32_t stream_id,
   r = nghttp2_session_add_frame(session, NGHTTP2_CAT_CTRL, frame, NULL);
   if(r != 0) {
     nghttp2_frame_priority_free(&frame->priority);
-    free(frame);
+    nghttp2_objpool_put(&session->frame_pool, frame);
     return r;
   }
   /* Only update priority if the sender is client for now */
@@ -169,13 +176,13 @@ int nghttp2_submit_settings(nghttp2_session *session,
                        [NGHTTP2_SETTINGS_FLOW_CONTROL_OPTIONS])) {
     return NGHTTP2_ERR_INVALID_ARGUMENT;
   }
-  frame = malloc(sizeof(nghttp2_frame));
+  frame = nghttp2_objpool_get(&session->frame_pool);
   if(frame == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
   iv_copy = nghttp2_frame_iv_copy(iv, niv);
   if(iv_copy == NULL) {
-    free(frame);
+    nghttp2_objpool_put(&session->frame_pool, frame);
     return NGHTTP2_ERR_NOMEM;
   }
   nghttp2_frame_settings_init(&frame->settings, iv_copy, niv);
@@ -183,7 +190,7 @@ int nghttp2_submit_settings(nghttp2_session *session,
   r = nghttp2_session_update_local_settings(session, iv_copy, niv);
   if(r != 0) {
     nghttp2_frame_settings_free(&frame->settings);
-    free(frame);
+    nghttp2_objpool_put(&session->frame_pool, frame);
     return r;
   }
   r = nghttp2_session_add_frame(session, NGHTTP2_CAT_CTRL, frame, NULL);
@@ -191,7 +198,7 @@ int nghttp2_submit_settings(nghttp2_session *session,
     /* The only expected error is fatal one */
     assert(r < NGHTTP2_ERR_FATAL);
     nghttp2_frame_settings_free(&frame->settings);
-    free(frame);
+    nghttp2_objpool_put(&session->frame_pool, frame);
   }
   return r;
 }
@@ -211,13 +218,13 @@ int nghttp2_submit_push_promise(nghttp2_session *session, uint8_t flags,
   if(!nghttp2_frame_nv_check_null(nv)) {
     return NGHTTP2_ERR_INVALID_ARGUMENT;
   }
-  frame = malloc(sizeof(nghttp2_frame));
+  frame = nghttp2_objpool_get(&session->frame_pool);
   if(frame == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
-  nvlen = nghttp2_nv_array_from_cstr(&nva, nv);
+  nvlen = nghttp2_nv_array_from_cstr_mem(&nva, nv, &session->mem);
   if(nvlen < 0) {
-    free(frame);
+    nghttp2_objpool_put(&session->frame_pool, frame);
     return nvlen;
   }
   /* TODO Implement header continuation */
@@ -226,8 +233,8 @@ int nghttp2_submit_push_promise(nghttp2_session *session, uint8_t flags,
                                   stream_id, -1, nva, nvlen);
   r = nghttp2_session_add_frame(session, NGHTTP2_CAT_CTRL, frame, NULL);
   if(r != 0) {
-    nghttp2_frame_push_promise_free(&frame->push_promise);
-    free(frame);
+    nghttp2_nv_array_del_mem(nva, &session->mem);
+    nghttp2_objpool_put(&session->frame_pool, frame);
   }
   return 0;
 }
@@ -331,7 +338,7 @@ int nghttp2_submit_data(nghttp2_session *session, uint8_t flags,
   if(nghttp2_session_get_stream(session, stream_id) == NULL) {
     return NGHTTP2_ERR_STREAM_CLOSED;
   }
-  data_frame = malloc(sizeof(nghttp2_data));
+  data_frame = nghttp2_objpool_get(&session->data_pool);
   if(data_frame == NULL) {
     return NGHTTP2_ERR_NOMEM;
   }
@@ -342,7 +349,7 @@ int nghttp2_submit_data(nghttp2_session *session, uint8_t flags,
   r = nghttp2_session_add_frame(session, NGHTTP2_CAT_DATA, data_frame, NULL);
   if(r != 0) {
     nghttp2_frame_data_free(data_frame);
-    free(data_frame);
+    nghttp2_objpool_put(&session->data_pool, data_frame);
   }
   return r;
 }
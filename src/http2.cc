@@ -78,6 +78,63 @@ const char* get_status_string(int status_code)
   }
 }
 
+int lookup_token(const std::string& name)
+{
+  // Dispatch on the length first, so that at most 2 comparisons are
+  // made.
+  switch(name.size()) {
+  case 2:
+    if(name == "te") {
+      return HD_TE;
+    }
+    break;
+  case 3:
+    if(name == "via") {
+      return HD_VIA;
+    }
+    break;
+  case 4:
+    if(name == "host") {
+      return HD_HOST;
+    }
+    break;
+  case 6:
+    if(name == "expect") {
+      return HD_EXPECT;
+    }
+    break;
+  case 7:
+    if(name == "upgrade") {
+      return HD_UPGRADE;
+    }
+    break;
+  case 10:
+    if(name == "connection") {
+      return HD_CONNECTION;
+    }
+    break;
+  case 14:
+    if(name == "content-length") {
+      return HD_CONTENT_LENGTH;
+    }
+    if(name == "http2-settings") {
+      return HD_HTTP2_SETTINGS;
+    }
+    break;
+  case 15:
+    if(name == "x-forwarded-for") {
+      return HD_X_FORWARDED_FOR;
+    }
+    break;
+  case 17:
+    if(name == "transfer-encoding") {
+      return HD_TRANSFER_ENCODING;
+    }
+    break;
+  }
+  return -1;
+}
+
 void capitalize(std::string& s, size_t offset)
 {
   s[offset] = util::upcase(s[offset]);
@@ -277,20 +334,107 @@ size_t copy_norm_headers_to_nv
   return nvlen;
 }
 
-void build_http1_headers_from_norm_headers
-(std::string& hdrs,
- const std::vector<std::pair<std::string,
- std::string>>& headers)
+namespace {
+struct CapitalizedHeaderName {
+  const char *name;
+  const char *capitalized;
+};
+} // namespace
+
+namespace {
+// Well-known header names and their HTTP/1.1 forms as produced by
+// capitalize(), sorted by name.
+const CapitalizedHeaderName CAPITALIZED_HD[] = {
+  { "accept", "Accept" },
+  { "accept-charset", "Accept-Charset" },
+  { "accept-encoding", "Accept-Encoding" },
+  { "accept-language", "Accept-Language" },
+  { "accept-ranges", "Accept-Ranges" },
+  { "access-control-allow-origin", "Access-Control-Allow-Origin" },
+  { "age", "Age" },
+  { "allow", "Allow" },
+  { "authorization", "Authorization" },
+  { "cache-control", "Cache-Control" },
+  { "content-disposition", "Content-Disposition" },
+  { "content-encoding", "Content-Encoding" },
+  { "content-language", "Content-Language" },
+  { "content-length", "Content-Length" },
+  { "content-location", "Content-Location" },
+  { "content-range", "Content-Range" },
+  { "content-type", "Content-Type" },
+  { "cookie", "Cookie" },
+  { "date", "Date" },
+  { "etag", "Etag" },
+  { "expires", "Expires" },
+  { "from", "From" },
+  { "host", "Host" },
+  { "if-match", "If-Match" },
+  { "if-modified-since", "If-Modified-Since" },
+  { "if-none-match", "If-None-Match" },
+  { "if-range", "If-Range" },
+  { "if-unmodified-since", "If-Unmodified-Since" },
+  { "last-modified", "Last-Modified" },
+  { "link", "Link" },
+  { "location", "Location" },
+  { "max-forwards", "Max-Forwards" },
+  { "pragma", "Pragma" },
+  { "proxy-authenticate", "Proxy-Authenticate" },
+  { "proxy-authorization", "Proxy-Authorization" },
+  { "range", "Range" },
+  { "referer", "Referer" },
+  { "refresh", "Refresh" },
+  { "retry-after", "Retry-After" },
+  { "server", "Server" },
+  { "set-cookie", "Set-Cookie" },
+  { "strict-transport-security", "Strict-Transport-Security" },
+  { "te", "Te" },
+  { "trailer", "Trailer" },
+  { "transfer-encoding", "Transfer-Encoding" },
+  { "user-agent", "User-Agent" },
+  { "vary", "Vary" },
+  { "warning", "Warning" },
+  { "www-authenticate", "Www-Authenticate" },
+  { "x-content-type-options", "X-Content-Type-Options" },
+  { "x-frame-options", "X-Frame-Options" },
+  { "x-xss-protection", "X-Xss-Protection" },
+};
+} // namespace
+
+namespace {
+const size_t CAPITALIZED_HDLEN =
+  sizeof(CAPITALIZED_HD)/sizeof(CAPITALIZED_HD[0]);
+} // namespace
+
+const char* get_capitalized_header_name(const std::string& name)
+{
+  size_t lo = 0, hi = CAPITALIZED_HDLEN;
+  while(lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    int rv = strcmp(name.c_str(), CAPITALIZED_HD[mid].name);
+    if(rv == 0) {
+      return CAPITALIZED_HD[mid].capitalized;
+    }
+    if(rv < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return nullptr;
+}
+
+namespace {
+// Calls |f| for each header in |headers| which is emitted in HTTP/1.1
+// header block, that is, the ones not in HTTP1_IGN_HD.
+template<typename F>
+void for_each_http1_header
+(const std::vector<std::pair<std::string, std::string>>& headers, F f)
 {
   size_t i, j;
   for(i = 0, j = 0; i < headers.size() && j < HTTP1_IGN_HDLEN;) {
     int rv = strcmp(headers[i].first.c_str(), HTTP1_IGN_HD[j]);
     if(rv < 0) {
-      hdrs += headers[i].first;
-      capitalize(hdrs, hdrs.size()-headers[i].first.size());
-      hdrs += ": ";
-      hdrs += headers[i].second;
-      hdrs += "\r\n";
+      f(headers[i]);
       ++i;
     } else if(rv > 0) {
       ++j;
@@ -299,13 +443,47 @@ void build_http1_headers_from_norm_headers
     }
   }
   for(; i < headers.size(); ++i) {
-    hdrs += headers[i].first;
-    capitalize(hdrs, hdrs.size()-headers[i].first.size());
-    hdrs += ": ";
-    hdrs += headers[i].second;
-    hdrs += "\r\n";
+    f(headers[i]);
   }
 }
+} // namespace
+
+size_t count_http1_headers_length
+(const std::vector<std::pair<std::string, std::string>>& headers)
+{
+  size_t len = 0;
+  for_each_http1_header(headers,
+                        [&len](const std::pair<std::string,
+                                               std::string>& hd)
+                        {
+                          // name ": " value CRLF
+                          len += hd.first.size() + hd.second.size() + 4;
+                        });
+  return len;
+}
+
+void build_http1_headers_from_norm_headers
+(std::string& hdrs,
+ const std::vector<std::pair<std::string,
+ std::string>>& headers)
+{
+  hdrs.reserve(hdrs.size() + count_http1_headers_length(headers));
+  for_each_http1_header(headers,
+                        [&hdrs](const std::pair<std::string,
+                                                std::string>& hd)
+                        {
+                          auto name = get_capitalized_header_name(hd.first);
+                          if(name) {
+                            hdrs.append(name, hd.first.size());
+                          } else {
+                            hdrs += hd.first;
+                            capitalize(hdrs, hdrs.size()-hd.first.size());
+                          }
+                          hdrs += ": ";
+                          hdrs += hd.second;
+                          hdrs += "\r\n";
+                        });
+}
 
 } // namespace http2
 
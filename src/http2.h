@@ -40,6 +40,26 @@ namespace http2 {
 
 const char* get_status_string(int status_code);
 
+// Tokens of the header names which the proxy looks up in every
+// request or response.
+enum {
+  HD_CONNECTION,
+  HD_CONTENT_LENGTH,
+  HD_EXPECT,
+  HD_HOST,
+  HD_HTTP2_SETTINGS,
+  HD_TE,
+  HD_TRANSFER_ENCODING,
+  HD_UPGRADE,
+  HD_VIA,
+  HD_X_FORWARDED_FOR,
+  HD_MAXIDX
+};
+
+// Returns the token of the lower-cased header |name|, or -1 if it is
+// not one of the above.
+int lookup_token(const std::string& name);
+
 void capitalize(std::string& s, size_t offset);
 
 void sanitize_header_value(std::string& s, size_t offset);
@@ -90,9 +110,19 @@ size_t copy_norm_headers_to_nv
 (const char **nv,
  const std::vector<std::pair<std::string, std::string>>& headers);
 
+// Returns the capitalized form of the well-known header |name|, which
+// must be lower-cased, or nullptr if |name| is not in the table. The
+// result is the same as capitalize() but needs no conversion.
+const char* get_capitalized_header_name(const std::string& name);
+
+// Returns the number of bytes build_http1_headers_from_norm_headers()
+// appends for |headers|.
+size_t count_http1_headers_length
+(const std::vector<std::pair<std::string, std::string>>& headers);
+
 // Appends HTTP/1.1 style header lines to |hdrs| from headers in
 // |headers|. Certain headers, which requires special handling
-// (i.e. via), are not appended.
+// (i.e. via), are not appended. |hdrs| is grown at most once.
 void build_http1_headers_from_norm_headers
 (std::string& hdrs,
  const std::vector<std::pair<std::string, std::string>>& headers);
@@ -24,6 +24,7 @@
  */
 #include "http2_test.h"
 
+#include <cstring>
 #include <iostream>
 
 #include <CUnit/CUnit.h>
@@ -163,4 +164,34 @@ void test_http2_build_http1_headers_from_norm_headers(void)
             "Zulu: 12\r\n");
 }
 
+void test_http2_get_capitalized_header_name(void)
+{
+  CU_ASSERT(0 == strcmp("Content-Length",
+                        http2::get_capitalized_header_name("content-length")));
+  CU_ASSERT(0 == strcmp("Www-Authenticate",
+                        http2::get_capitalized_header_name
+                        ("www-authenticate")));
+  CU_ASSERT(nullptr == http2::get_capitalized_header_name("x-custom"));
+  CU_ASSERT(nullptr == http2::get_capitalized_header_name("Content-Length"));
+}
+
+void test_http2_count_http1_headers_length(void)
+{
+  std::string hdrs;
+  http2::build_http1_headers_from_norm_headers(hdrs, headers);
+  CU_ASSERT(hdrs.size() == http2::count_http1_headers_length(headers));
+}
+
+void test_http2_lookup_token(void)
+{
+  CU_ASSERT(http2::HD_TE == http2::lookup_token("te"));
+  CU_ASSERT(http2::HD_CONTENT_LENGTH == http2::lookup_token("content-length"));
+  CU_ASSERT(http2::HD_HTTP2_SETTINGS == http2::lookup_token("http2-settings"));
+  CU_ASSERT(http2::HD_X_FORWARDED_FOR ==
+            http2::lookup_token("x-forwarded-for"));
+  CU_ASSERT(-1 == http2::lookup_token("x-forwarded-proto"));
+  CU_ASSERT(-1 == http2::lookup_token("Host"));
+  CU_ASSERT(-1 == http2::lookup_token(""));
+}
+
 } // namespace shrpx
@@ -0,0 +1,123 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2012 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+// Micro benchmark of DownstreamQueue against std::map, which it
+// replaced, with the stream counts typical for a busy HTTP/2.0
+// connection. Build with "make queuebench" in src directory.
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <map>
+#include <vector>
+#include <utility>
+
+#include "shrpx_config.h"
+#include "shrpx_downstream.h"
+#include "shrpx_downstream_queue.h"
+
+using namespace shrpx;
+
+namespace {
+const size_t NUM_FIND = 1000000;
+} // namespace
+
+namespace {
+double elapsed(clock_t start)
+{
+  return static_cast<double>(clock() - start) / CLOCKS_PER_SEC;
+}
+} // namespace
+
+namespace {
+// Returns the time of NUM_FIND lookups of |ids| in |find| in
+// nanoseconds per lookup.
+template<typename F>
+double bench_find(const std::vector<int32_t>& ids, F find)
+{
+  size_t misses = 0;
+  auto start = clock();
+  for(size_t i = 0; i < NUM_FIND; ++i) {
+    if(!find(ids[i % ids.size()])) {
+      ++misses;
+    }
+  }
+  auto t = elapsed(start);
+  if(misses) {
+    fprintf(stderr, "%zu lookups failed\n", misses);
+    exit(EXIT_FAILURE);
+  }
+  return t * 1e9 / NUM_FIND;
+}
+} // namespace
+
+namespace {
+void run(size_t n)
+{
+  std::vector<Downstream*> ds;
+  std::vector<int32_t> ids;
+  // Client initiated stream IDs
+  for(size_t i = 0; i < n; ++i) {
+    ds.push_back(new Downstream(nullptr, i * 2 + 1, 0));
+    ids.push_back(i * 2 + 1);
+  }
+  for(size_t i = n - 1; i >= 1; --i) {
+    size_t j = static_cast<size_t>((i + 1) * (rand() / (RAND_MAX + 1.0)));
+    std::swap(ids[i], ids[j]);
+  }
+
+  std::map<int32_t, Downstream*> map;
+  for(auto d : ds) {
+    map[d->get_stream_id()] = d;
+  }
+  auto t_map = bench_find(ids, [&map](int32_t stream_id)
+                          {
+                            auto i = map.find(stream_id);
+                            return i == std::end(map) ? nullptr :
+                              (*i).second;
+                          });
+
+  DownstreamQueue dq;
+  for(auto d : ds) {
+    dq.add(d);
+  }
+  auto t_dq = bench_find(ids, [&dq](int32_t stream_id)
+                         {
+                           return dq.find(stream_id);
+                         });
+  // dq deletes the Downstreams.
+
+  printf("%5zu streams: std::map find %6.1f ns/op, "
+         "DownstreamQueue find %6.1f ns/op\n", n, t_map, t_dq);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  create_config();
+  size_t nums[] = { 100, 1000 };
+  for(auto n : nums) {
+    run(n);
+  }
+  return 0;
+}
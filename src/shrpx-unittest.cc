@@ -30,8 +30,16 @@
 /* include test cases' include files here */
 #include "shrpx_ssl_test.h"
 #include "shrpx_downstream_test.h"
+#include "shrpx_worker_stat_test.h"
+#include "shrpx_downstream_connection_pool_test.h"
+#include "shrpx_downstream_balancer_test.h"
+#include "shrpx_spdy_session_pool_test.h"
+#include "shrpx_session_cache_test.h"
+#include "shrpx_downstream_queue_test.h"
+#include "shrpx_http_test.h"
 #include "http2_test.h"
 #include "util_test.h"
+#include "shrpx_config.h"
 
 static int init_suite1(void)
 {
@@ -53,6 +61,9 @@ int main(int argc, char* argv[])
    SSL_load_error_strings();
    SSL_library_init();
 
+   // The functions under test may log errors, which reads Config.
+   shrpx::create_config();
+
    /* initialize the CUnit test registry */
    if (CUE_SUCCESS != CU_initialize_registry())
       return CU_get_error();
@@ -69,6 +80,10 @@ int main(int argc, char* argv[])
                    shrpx::test_shrpx_ssl_create_lookup_tree) ||
       !CU_add_test(pSuite, "ssl_cert_lookup_tree_add_cert_from_file",
                    shrpx::test_shrpx_ssl_cert_lookup_tree_add_cert_from_file) ||
+      !CU_add_test(pSuite, "ssl_read_ticket_keys_file",
+                   shrpx::test_shrpx_ssl_read_ticket_keys_file) ||
+      !CU_add_test(pSuite, "ssl_generate_ticket_keys",
+                   shrpx::test_shrpx_ssl_generate_ticket_keys) ||
       !CU_add_test(pSuite, "http2_check_http2_headers",
                    shrpx::test_http2_check_http2_headers) ||
       !CU_add_test(pSuite, "http2_get_unique_header",
@@ -81,6 +96,12 @@ int main(int argc, char* argv[])
                    shrpx::test_http2_copy_norm_headers_to_nv) ||
       !CU_add_test(pSuite, "http2_build_http1_headers_from_norm_headers",
                    shrpx::test_http2_build_http1_headers_from_norm_headers) ||
+      !CU_add_test(pSuite, "http2_get_capitalized_header_name",
+                   shrpx::test_http2_get_capitalized_header_name) ||
+      !CU_add_test(pSuite, "http2_count_http1_headers_length",
+                   shrpx::test_http2_count_http1_headers_length) ||
+      !CU_add_test(pSuite, "http2_lookup_token",
+                   shrpx::test_http2_lookup_token) ||
       !CU_add_test(pSuite, "downstream_normalize_request_headers",
                    shrpx::test_downstream_normalize_request_headers) ||
       !CU_add_test(pSuite, "downstream_normalize_response_headers",
@@ -89,6 +110,36 @@ int main(int argc, char* argv[])
                    shrpx::test_downstream_get_norm_request_header) ||
       !CU_add_test(pSuite, "downstream_get_norm_response_header",
                    shrpx::test_downstream_get_norm_response_header) ||
+      !CU_add_test(pSuite, "downstream_get_norm_request_header_token",
+                   shrpx::test_downstream_get_norm_request_header_token) ||
+      !CU_add_test(pSuite, "downstream_get_norm_response_header_token",
+                   shrpx::test_downstream_get_norm_response_header_token) ||
+      !CU_add_test(pSuite, "downstream_queue_add_find_remove",
+                   shrpx::test_downstream_queue_add_find_remove) ||
+      !CU_add_test(pSuite, "downstream_queue_many",
+                   shrpx::test_downstream_queue_many) ||
+      !CU_add_test(pSuite, "http_parse_evbuffer",
+                   shrpx::test_http_parse_evbuffer) ||
+      !CU_add_test(pSuite, "worker_stat_select_least_loaded_worker",
+                   shrpx::test_worker_stat_select_least_loaded_worker) ||
+      !CU_add_test(pSuite, "downstream_connection_pool",
+                   shrpx::test_downstream_connection_pool) ||
+      !CU_add_test(pSuite, "downstream_balancer_round_robin",
+                   shrpx::test_downstream_balancer_round_robin) ||
+      !CU_add_test(pSuite, "downstream_balancer_least_outstanding",
+                   shrpx::test_downstream_balancer_least_outstanding) ||
+      !CU_add_test(pSuite, "downstream_balancer_header_hash",
+                   shrpx::test_downstream_balancer_header_hash) ||
+      !CU_add_test(pSuite, "spdy_session_pool_select_spdy_session",
+                   shrpx::test_spdy_session_pool_select_spdy_session) ||
+      !CU_add_test(pSuite, "session_cache_store_lookup",
+                   shrpx::test_session_cache_store_lookup) ||
+      !CU_add_test(pSuite, "session_cache_memcached",
+                   shrpx::test_session_cache_memcached) ||
+      !CU_add_test(pSuite, "session_cache_memcached_backoff",
+                   shrpx::test_session_cache_memcached_backoff) ||
+      !CU_add_test(pSuite, "session_cache_backend",
+                   shrpx::test_session_cache_backend) ||
       !CU_add_test(pSuite, "util_streq", shrpx::test_util_streq) ||
       !CU_add_test(pSuite, "util_inp_strlower",
                    shrpx::test_util_inp_strlower)) {
@@ -52,6 +52,7 @@
 #include "shrpx_config.h"
 #include "shrpx_listen_handler.h"
 #include "shrpx_ssl.h"
+#include "shrpx_session_cache.h"
 
 namespace shrpx {
 
@@ -125,7 +126,11 @@ void evlistener_errorcb(evconnlistener *listener, void *ptr)
 } // namespace
 
 namespace {
-evconnlistener* create_evlistener(ListenHandler *handler, int family)
+// Creates and binds listening socket for |family| on the frontend
+// address. If --reuseport is given, SO_REUSEPORT is set on the
+// socket so that the same address can be bound by the socket for
+// each worker. Returns the socket or -1 if it fails.
+evutil_socket_t create_listen_socket(int family)
 {
   // TODO Listen both IPv4 and IPv6
   addrinfo hints;
@@ -149,7 +154,7 @@ evconnlistener* create_evlistener(ListenHandler *handler, int family)
                 << " address for " << get_config()->host << ": "
                 << gai_strerror(r);
     }
-    return NULL;
+    return -1;
   }
   for(rp = res; rp; rp = rp->ai_next) {
     fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
@@ -162,6 +167,14 @@ evconnlistener* create_evlistener(ListenHandler *handler, int family)
       close(fd);
       continue;
     }
+#ifdef SO_REUSEPORT
+    if(get_config()->reuseport &&
+       setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &val,
+                  static_cast<socklen_t>(sizeof(val))) == -1) {
+      close(fd);
+      continue;
+    }
+#endif // SO_REUSEPORT
     evutil_make_socket_nonblocking(fd);
 #ifdef IPV6_V6ONLY
     if(family == AF_INET6) {
@@ -197,9 +210,19 @@ evconnlistener* create_evlistener(ListenHandler *handler, int family)
       LOG(INFO) << "Listening " << (family == AF_INET ? "IPv4" : "IPv6")
                 << " socket failed";
     }
-    return 0;
+    return -1;
   }
+  return fd;
+}
+} // namespace
 
+namespace {
+evconnlistener* create_evlistener(ListenHandler *handler, int family)
+{
+  auto fd = create_listen_socket(family);
+  if(fd == -1) {
+    return nullptr;
+  }
   evconnlistener *evlistener = evconnlistener_new
     (handler->get_evbase(),
      ssl_acceptcb,
@@ -245,6 +268,37 @@ void save_pid()
 }
 } // namespace
 
+namespace {
+void sigusr1_cb(evutil_socket_t sig, short events, void *arg)
+{
+  auto listener_handler = reinterpret_cast<ListenHandler*>(arg);
+  listener_handler->log_worker_stats();
+}
+} // namespace
+
+namespace {
+void ticket_key_rotation_cb(evutil_socket_t fd, short events, void *arg)
+{
+  std::shared_ptr<ssl::TicketKeys> keys;
+  if(get_config()->tls_ticket_key_file) {
+    // Another process replaces the file to rotate the keys shared by
+    // all instances.
+    keys = ssl::read_ticket_keys_file(get_config()->tls_ticket_key_file);
+  } else {
+    keys = ssl::generate_ticket_keys(ssl::get_ticket_keys());
+  }
+  if(!keys) {
+    LOG(WARNING) << "Session ticket keys were not rotated; keep using "
+                 << "the current ones";
+    return;
+  }
+  if(LOG_ENABLED(INFO)) {
+    LOG(INFO) << "Rotated session ticket keys";
+  }
+  ssl::set_ticket_keys(keys);
+}
+} // namespace
+
 namespace {
 int event_loop()
 {
@@ -275,13 +329,43 @@ int event_loop()
     save_pid();
   }
 
-  evconnlistener *evlistener6, *evlistener4;
-  evlistener6 = create_evlistener(listener_handler, AF_INET6);
-  evlistener4 = create_evlistener(listener_handler, AF_INET);
-  if(!evlistener6 && !evlistener4) {
-    LOG(FATAL) << "Failed to listen on address "
-               << get_config()->host << ", port " << get_config()->port;
-    exit(EXIT_FAILURE);
+  evconnlistener *evlistener6 = nullptr, *evlistener4 = nullptr;
+  // Listening sockets for each worker if --reuseport is used. Each
+  // worker takes IPv6 and IPv4 socket in this order. -1 is stored if
+  // the socket is not available.
+  std::vector<evutil_socket_t> worker_listen_fds;
+#ifndef SO_REUSEPORT
+  if(get_config()->reuseport) {
+    LOG(WARNING) << "SO_REUSEPORT is not available. --reuseport is ignored";
+    mod_config()->reuseport = false;
+  }
+#endif // !SO_REUSEPORT
+  if(get_config()->reuseport && get_config()->num_worker > 1) {
+    for(size_t i = 0; i < get_config()->num_worker; ++i) {
+      auto fd6 = create_listen_socket(AF_INET6);
+      auto fd4 = create_listen_socket(AF_INET);
+      if(fd6 == -1 && fd4 == -1) {
+        LOG(FATAL) << "Failed to listen on address "
+                   << get_config()->host << ", port " << get_config()->port;
+        exit(EXIT_FAILURE);
+      }
+      worker_listen_fds.push_back(fd6);
+      worker_listen_fds.push_back(fd4);
+    }
+  } else {
+    evlistener6 = create_evlistener(listener_handler, AF_INET6);
+    evlistener4 = create_evlistener(listener_handler, AF_INET);
+    if(!evlistener6 && !evlistener4) {
+      LOG(FATAL) << "Failed to listen on address "
+                 << get_config()->host << ", port " << get_config()->port;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if(get_config()->num_worker > 1) {
+    // Each worker gets its own SSL_CTX, which reads the private key
+    // again. Do it while we still have the root privileges.
+    listener_handler->create_worker_ssl_ctx(get_config()->num_worker);
   }
 
   // ListenHandler loads private key, and we listen on a priveleged port.
@@ -289,15 +373,39 @@ int event_loop()
   drop_privileges();
 
   if(get_config()->num_worker > 1) {
-    listener_handler->create_worker_thread(get_config()->num_worker);
+    listener_handler->create_worker_thread(get_config()->num_worker,
+                                           worker_listen_fds);
   } else if(get_config()->downstream_proto == PROTO_SPDY) {
-    listener_handler->create_spdy_session();
+    listener_handler->create_spdy_session_pool();
+  }
+
+  // SIGUSR1 dumps the load counters of the workers to the log.
+  auto sigusr1_event = evsignal_new(evbase, SIGUSR1, sigusr1_cb,
+                                    listener_handler);
+  if(!sigusr1_event || evsignal_add(sigusr1_event, nullptr) != 0) {
+    LOG(WARNING) << "Could not install SIGUSR1 handler";
+  }
+
+  event *ticket_key_event = nullptr;
+  if(sv_ssl_ctx) {
+    ticket_key_event = event_new(evbase, -1, EV_PERSIST,
+                                 ticket_key_rotation_cb, nullptr);
+    timeval tv = {get_config()->tls_ticket_key_rotation, 0};
+    if(!ticket_key_event || event_add(ticket_key_event, &tv) != 0) {
+      LOG(WARNING) << "Could not schedule session ticket key rotation";
+    }
   }
 
   if(LOG_ENABLED(INFO)) {
     LOG(INFO) << "Entering event loop";
   }
   event_base_loop(evbase, 0);
+  if(ticket_key_event) {
+    event_free(ticket_key_event);
+  }
+  if(sigusr1_event) {
+    event_free(sigusr1_event);
+  }
   if(evlistener4) {
     evconnlistener_free(evlistener4);
   }
@@ -354,6 +462,8 @@ void fill_default_config()
 
   // Timeout for pooled (idle) connections
   mod_config()->downstream_idle_read_timeout.tv_sec = 60;
+  mod_config()->downstream_max_idle_connections = 64;
+  mod_config()->downstream_spdy_max_sessions = 4;
 
   // window bits for HTTP/2.0 and SPDY upstream/downstream
   // connection. 2**16-1 = 64KiB-1, which is HTTP/2.0 default. Please
@@ -364,10 +474,10 @@ void fill_default_config()
   mod_config()->upstream_no_tls = false;
   mod_config()->downstream_no_tls = false;
 
-  set_config_str(&mod_config()->downstream_host, "127.0.0.1");
-  mod_config()->downstream_port = 80;
-  mod_config()->downstream_hostport = 0;
-  mod_config()->downstream_addrlen = 0;
+  parse_config(SHRPX_OPT_BACKEND, "127.0.0.1,80");
+  mod_config()->downstream_balance_method = BALANCE_ROUND_ROBIN;
+  mod_config()->downstream_balance_hash_header = 0;
+  mod_config()->downstream_eject_period = 10;
 
   mod_config()->num_worker = 1;
   mod_config()->spdy_max_concurrent_streams = 100;
@@ -380,6 +490,7 @@ void fill_default_config()
   mod_config()->use_syslog = false;
   // Default accept() backlog
   mod_config()->backlog = 256;
+  mod_config()->reuseport = false;
   mod_config()->ciphers = 0;
   mod_config()->honor_cipher_order = false;
   mod_config()->spdy_proxy = false;
@@ -396,6 +507,10 @@ void fill_default_config()
   mod_config()->backend_ipv6 = false;
   mod_config()->tty = isatty(fileno(stderr));
   mod_config()->cert_tree = 0;
+  mod_config()->tls_ticket_key_file = 0;
+  mod_config()->tls_ticket_key_rotation = 3600;
+  mod_config()->tls_session_cache_size = 20480;
+  mod_config()->tls_session_cache_memcached_host = 0;
   mod_config()->downstream_http_proxy_userinfo = 0;
   mod_config()->downstream_http_proxy_host = 0;
   mod_config()->downstream_http_proxy_port = 0;
@@ -435,11 +550,29 @@ void print_help(std::ostream& out)
       << "OPTIONS:\n"
       << "\n"
       << "  Connections:\n"
-      << "    -b, --backend=<HOST,PORT>\n"
-      << "                       Set backend host and port.\n"
+      << "    -b, --backend=<HOST,PORT>[;<HOST,PORT>...]\n"
+      << "                       Set backend host and port. Multiple\n"
+      << "                       backends can be given separated by ';'.\n"
       << "                       Default: '"
-      << get_config()->downstream_host << ","
-      << get_config()->downstream_port << "'\n"
+      << get_config()->downstream_addrs[0].host << ","
+      << get_config()->downstream_addrs[0].port << "'\n"
+      << "    --backend-balance=<METHOD>\n"
+      << "                       Set how a backend is chosen for a request\n"
+      << "                       if multiple backends are given. METHOD is\n"
+      << "                       one of 'round-robin', 'least-outstanding'\n"
+      << "                       and 'header-hash:<HEADER>'. The last one\n"
+      << "                       sends the requests with the same value of\n"
+      << "                       <HEADER> to the same backend, and falls\n"
+      << "                       back to round-robin if the header is\n"
+      << "                       missing. With HTTP/2.0 or SPDY backend, a\n"
+      << "                       backend is chosen per backend session.\n"
+      << "                       Default: round-robin\n"
+      << "    --backend-eject-period=<SEC>\n"
+      << "                       Do not choose a backend for this period\n"
+      << "                       after a connection to it failed, unless all\n"
+      << "                       backends are failing.\n"
+      << "                       Default: "
+      << get_config()->downstream_eject_period << "\n"
       << "    -f, --frontend=<HOST,PORT>\n"
       << "                       Set frontend host and port.\n"
       << "                       Default: '"
@@ -447,6 +580,12 @@ void print_help(std::ostream& out)
       << "    --backlog=<NUM>    Set listen backlog size.\n"
       << "                       Default: "
       << get_config()->backlog << "\n"
+      << "    --reuseport        Let each worker thread accept connections\n"
+      << "                       from its own listening socket bound with\n"
+      << "                       SO_REUSEPORT, instead of accepting them in\n"
+      << "                       the main thread and passing them to the\n"
+      << "                       workers. Effective only if -n is larger\n"
+      << "                       than 1.\n"
       << "    --backend-ipv4     Resolve backend hostname to IPv4 address\n"
       << "                       only.\n"
       << "    --backend-ipv6     Resolve backend hostname to IPv6 address\n"
@@ -454,9 +593,29 @@ void print_help(std::ostream& out)
       << "\n"
       << "  Performance:\n"
       << "    -n, --workers=<CORES>\n"
-      << "                       Set the number of worker threads.\n"
+      << "                       Set the number of worker threads. New\n"
+      << "                       connections are given to the least loaded\n"
+      << "                       worker. Send SIGUSR1 to log the load of\n"
+      << "                       each worker.\n"
       << "                       Default: "
       << get_config()->num_worker << "\n"
+      << "    --backend-max-idle-connections=<NUM>\n"
+      << "                       Set the maximum number of idle HTTP/1.1\n"
+      << "                       backend connections kept per backend\n"
+      << "                       address in each worker. They are shared\n"
+      << "                       by all frontend connections in the worker\n"
+      << "                       and closed after\n"
+      << "                       --backend-keep-alive-timeout.\n"
+      << "                       Default: "
+      << get_config()->downstream_max_idle_connections << "\n"
+      << "    --backend-spdy-max-sessions=<NUM>\n"
+      << "                       Set the maximum number of HTTP/2.0 or SPDY\n"
+      << "                       backend sessions per worker. Another\n"
+      << "                       session is opened when the streams on all\n"
+      << "                       sessions approach the backend's\n"
+      << "                       SETTINGS_MAX_CONCURRENT_STREAMS.\n"
+      << "                       Default: "
+      << get_config()->downstream_spdy_max_sessions << "\n"
       << "\n"
       << "  Timeout:\n"
       << "    --frontend-spdy-read-timeout=<SEC>\n"
@@ -534,7 +693,40 @@ void print_help(std::ostream& out)
       << "    --dh-param-file=<PATH>\n"
       << "                       Path to file that contains DH parameters in\n"
       << "                       PEM format. Without this option, DHE cipher\n"
-      << "                       suites are not available."
+      << "                       suites are not available.\n"
+      << "    --tls-ticket-key-file=<PATH>\n"
+      << "                       Path to file that contains the keys to\n"
+      << "                       encrypt and decrypt TLS session tickets.\n"
+      << "                       The file is a concatenation of 48 byte\n"
+      << "                       keys: 16 bytes key name, 16 bytes AES key\n"
+      << "                       and 16 bytes HMAC key. The first key\n"
+      << "                       encrypts new tickets and all keys decrypt\n"
+      << "                       them. Share the file among instances so\n"
+      << "                       that any of them can resume the session.\n"
+      << "                       Without this option, a random key is\n"
+      << "                       generated and rotated periodically.\n"
+      << "    --tls-ticket-key-rotation=<SEC>\n"
+      << "                       Generate a new session ticket key, or\n"
+      << "                       reread --tls-ticket-key-file, at this\n"
+      << "                       interval. Send SIGUSR1 to log the number\n"
+      << "                       of resumed and full handshakes.\n"
+      << "                       Default: "
+      << get_config()->tls_ticket_key_rotation << "\n"
+      << "    --tls-session-cache-size=<NUM>\n"
+      << "                       Set the maximum number of TLS sessions\n"
+      << "                       cached for clients which do not use\n"
+      << "                       session tickets. The cache is split\n"
+      << "                       into a shard per worker.\n"
+      << "                       Default: "
+      << get_config()->tls_session_cache_size << "\n"
+      << "    --tls-session-cache-memcached=<HOST,PORT>\n"
+      << "                       Also store TLS sessions in the memcached\n"
+      << "                       server at HOST and PORT, and look them up\n"
+      << "                       there if they are not cached locally, so\n"
+      << "                       that the sessions are shared among\n"
+      << "                       instances and survive restarts. The\n"
+      << "                       server should be close; each request\n"
+      << "                       waits at most 100ms.\n"
       << "\n"
       << "  HTTP/2.0 and SPDY:\n"
       << "    -c, --spdy-max-concurrent-streams=<NUM>\n"
@@ -667,6 +859,15 @@ int main(int argc, char **argv)
       {"backend-tls-sni-field", required_argument, &flag, 31},
       {"honor-cipher-order", no_argument, &flag, 32},
       {"dh-param-file", required_argument, &flag, 33},
+      {"reuseport", no_argument, &flag, 34},
+      {"backend-max-idle-connections", required_argument, &flag, 35},
+      {"backend-balance", required_argument, &flag, 36},
+      {"backend-eject-period", required_argument, &flag, 37},
+      {"backend-spdy-max-sessions", required_argument, &flag, 38},
+      {"tls-ticket-key-file", required_argument, &flag, 39},
+      {"tls-ticket-key-rotation", required_argument, &flag, 40},
+      {"tls-session-cache-size", required_argument, &flag, 41},
+      {"tls-session-cache-memcached", required_argument, &flag, 42},
       {nullptr, 0, nullptr, 0 }
     };
     int option_index = 0;
@@ -850,6 +1051,49 @@ int main(int argc, char **argv)
         // --dh-param-file
         cmdcfgs.push_back(std::make_pair(SHRPX_OPT_DH_PARAM_FILE, optarg));
         break;
+      case 34:
+        // --reuseport
+        cmdcfgs.push_back(std::make_pair(SHRPX_OPT_REUSEPORT, "yes"));
+        break;
+      case 35:
+        // --backend-max-idle-connections
+        cmdcfgs.push_back(std::make_pair
+                          (SHRPX_OPT_BACKEND_MAX_IDLE_CONNECTIONS, optarg));
+        break;
+      case 36:
+        // --backend-balance
+        cmdcfgs.push_back(std::make_pair(SHRPX_OPT_BACKEND_BALANCE, optarg));
+        break;
+      case 37:
+        // --backend-eject-period
+        cmdcfgs.push_back(std::make_pair(SHRPX_OPT_BACKEND_EJECT_PERIOD,
+                                         optarg));
+        break;
+      case 38:
+        // --backend-spdy-max-sessions
+        cmdcfgs.push_back(std::make_pair
+                          (SHRPX_OPT_BACKEND_SPDY_MAX_SESSIONS, optarg));
+        break;
+      case 39:
+        // --tls-ticket-key-file
+        cmdcfgs.push_back(std::make_pair(SHRPX_OPT_TLS_TICKET_KEY_FILE,
+                                         optarg));
+        break;
+      case 40:
+        // --tls-ticket-key-rotation
+        cmdcfgs.push_back(std::make_pair(SHRPX_OPT_TLS_TICKET_KEY_ROTATION,
+                                         optarg));
+        break;
+      case 41:
+        // --tls-session-cache-size
+        cmdcfgs.push_back(std::make_pair(SHRPX_OPT_TLS_SESSION_CACHE_SIZE,
+                                         optarg));
+        break;
+      case 42:
+        // --tls-session-cache-memcached
+        cmdcfgs.push_back(std::make_pair
+                          (SHRPX_OPT_TLS_SESSION_CACHE_MEMCACHED, optarg));
+        break;
       default:
         break;
       }
@@ -934,27 +1178,58 @@ int main(int argc, char **argv)
     }
   }
 
-  char hostport[NI_MAXHOST+16];
-  bool downstream_ipv6_addr =
-    is_ipv6_numeric_addr(get_config()->downstream_host);
-  snprintf(hostport, sizeof(hostport), "%s%s%s:%u",
-           downstream_ipv6_addr ? "[" : "",
-           get_config()->downstream_host,
-           downstream_ipv6_addr ? "]" : "",
-           get_config()->downstream_port);
-  set_config_str(&mod_config()->downstream_hostport, hostport);
+  if(!get_config()->client_mode && !get_config()->upstream_no_tls) {
+    std::shared_ptr<ssl::TicketKeys> keys;
+    if(get_config()->tls_ticket_key_file) {
+      keys = ssl::read_ticket_keys_file(get_config()->tls_ticket_key_file);
+    } else {
+      keys = ssl::generate_ticket_keys(nullptr);
+    }
+    if(!keys) {
+      LOG(FATAL) << "Failed to set up session ticket keys";
+      exit(EXIT_FAILURE);
+    }
+    ssl::set_ticket_keys(keys);
 
-  if(LOG_ENABLED(INFO)) {
-    LOG(INFO) << "Resolving backend address";
-  }
-  if(resolve_hostname(&mod_config()->downstream_addr,
-                      &mod_config()->downstream_addrlen,
-                      get_config()->downstream_host,
-                      get_config()->downstream_port,
-                      get_config()->backend_ipv4 ? AF_INET :
-                      (get_config()->backend_ipv6 ?
-                       AF_INET6 : AF_UNSPEC)) == -1) {
-    exit(EXIT_FAILURE);
+    const sockaddr_union *memcached_addr = nullptr;
+    if(get_config()->tls_session_cache_memcached_host) {
+      if(LOG_ENABLED(INFO)) {
+        LOG(INFO) << "Resolving memcached server address";
+      }
+      if(resolve_hostname(&mod_config()->tls_session_cache_memcached_addr,
+                          &mod_config()->tls_session_cache_memcached_addrlen,
+                          get_config()->tls_session_cache_memcached_host,
+                          get_config()->tls_session_cache_memcached_port,
+                          AF_UNSPEC) == -1) {
+        exit(EXIT_FAILURE);
+      }
+      memcached_addr = &get_config()->tls_session_cache_memcached_addr;
+    }
+    ssl::create_session_cache
+      (get_config()->num_worker, get_config()->tls_session_cache_size,
+       memcached_addr, get_config()->tls_session_cache_memcached_addrlen);
+  }
+
+  for(size_t i = 0; i < get_config()->num_downstream_addrs; ++i) {
+    auto addr = &mod_config()->downstream_addrs[i];
+    char hostport[NI_MAXHOST+16];
+    bool downstream_ipv6_addr = is_ipv6_numeric_addr(addr->host);
+    snprintf(hostport, sizeof(hostport), "%s%s%s:%u",
+             downstream_ipv6_addr ? "[" : "",
+             addr->host,
+             downstream_ipv6_addr ? "]" : "",
+             addr->port);
+    set_config_str(&addr->hostport, hostport);
+
+    if(LOG_ENABLED(INFO)) {
+      LOG(INFO) << "Resolving backend address " << addr->hostport;
+    }
+    if(resolve_hostname(&addr->addr, &addr->addrlen, addr->host, addr->port,
+                        get_config()->backend_ipv4 ? AF_INET :
+                        (get_config()->backend_ipv6 ?
+                         AF_INET6 : AF_UNSPEC)) == -1) {
+      exit(EXIT_FAILURE);
+    }
   }
 
   if(get_config()->downstream_http_proxy_host) {
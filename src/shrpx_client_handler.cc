@@ -34,6 +34,10 @@
 #include "shrpx_http_downstream_connection.h"
 #include "shrpx_spdy_downstream_connection.h"
 #include "shrpx_accesslog.h"
+#include "shrpx_worker_stat.h"
+#include "shrpx_downstream_connection_pool.h"
+#include "shrpx_downstream_balancer.h"
+#include "shrpx_ssl.h"
 
 #ifdef HAVE_SPDYLAY
 #include "shrpx_spdy_upstream.h"
@@ -107,6 +111,7 @@ void upstream_eventcb(bufferevent *bev, short events, void *arg)
         CLOG(INFO, handler) << "SSL/TLS handleshake completed";
       }
       handler->validate_next_proto();
+      ssl::count_handshake(handler->get_ssl());
       if(LOG_ENABLED(INFO)) {
         if(SSL_session_reused(handler->get_ssl())) {
           CLOG(INFO, handler) << "SSL/TLS session reused";
@@ -221,8 +226,12 @@ ClientHandler::ClientHandler(bufferevent *bev, int fd, SSL *ssl,
     upstream_(nullptr),
     ipaddr_(ipaddr),
     should_close_after_write_(false),
-    spdy_(nullptr),
-    left_connhd_len_(NGHTTP2_CLIENT_CONNECTION_HEADER_LEN)
+    spdy_pool_(nullptr),
+    http_dconn_pool_(nullptr),
+    balancer_(nullptr),
+    left_connhd_len_(NGHTTP2_CLIENT_CONNECTION_HEADER_LEN),
+    worker_stat_(nullptr),
+    output_cb_entry_(nullptr)
 {
   bufferevent_set_rate_limit(bev_, evbucket_cfg_);
   bufferevent_enable(bev_, EV_READ | EV_WRITE);
@@ -248,6 +257,13 @@ ClientHandler::~ClientHandler()
   if(ssl_) {
     SSL_shutdown(ssl_);
   }
+  if(worker_stat_) {
+    auto output = bufferevent_get_output(bev_);
+    evbuffer_remove_cb_entry(output, output_cb_entry_);
+    worker_stat_->pending_write_bytes.fetch_sub
+      (evbuffer_get_length(output), std::memory_order_relaxed);
+    worker_stat_->num_connections.fetch_sub(1, std::memory_order_relaxed);
+  }
   bufferevent_disable(bev_, EV_READ | EV_WRITE);
   bufferevent_free(bev_);
   ev_token_bucket_cfg_free(evbucket_cfg_);
@@ -365,27 +381,37 @@ void ClientHandler::pool_downstream_connection(DownstreamConnection *dconn)
   dconn_pool_.insert(dconn);
 }
 
-void ClientHandler::remove_downstream_connection(DownstreamConnection *dconn)
+DownstreamConnection* ClientHandler::get_downstream_connection
+(Downstream *downstream)
 {
-  if(LOG_ENABLED(INFO)) {
-    CLOG(INFO, this) << "Removing downstream connection DCONN:" << dconn
-                     << " from pool";
+  if(!spdy_pool_) {
+    auto addr_idx = balancer_->select_addr(downstream, time(nullptr));
+    auto addr = &get_config()->downstream_addrs[addr_idx].addr;
+    auto addrlen = get_config()->downstream_addrs[addr_idx].addrlen;
+    auto dconn = http_dconn_pool_->pop_downstream_connection(&addr->sa,
+                                                             addrlen);
+    if(dconn) {
+      if(LOG_ENABLED(INFO)) {
+        CLOG(INFO, this) << "Reuse downstream connection DCONN:" << dconn
+                         << " from pool";
+      }
+      dconn->set_client_handler(this);
+      return dconn;
+    }
+    if(LOG_ENABLED(INFO)) {
+      CLOG(INFO, this) << "Downstream connection pool is empty."
+                       << " Create new one";
+    }
+    dconn = new HttpDownstreamConnection(this, addr, addrlen);
+    dconn->set_balancer(balancer_, addr_idx);
+    return dconn;
   }
-  dconn_pool_.erase(dconn);
-}
-
-DownstreamConnection* ClientHandler::get_downstream_connection()
-{
   if(dconn_pool_.empty()) {
     if(LOG_ENABLED(INFO)) {
       CLOG(INFO, this) << "Downstream connection pool is empty."
                        << " Create new one";
     }
-    if(spdy_) {
-      return new SpdyDownstreamConnection(this);
-    } else {
-      return new HttpDownstreamConnection(this);
-    }
+    return new SpdyDownstreamConnection(this);
   } else {
     DownstreamConnection *dconn = *dconn_pool_.begin();
     dconn_pool_.erase(dconn);
@@ -408,14 +434,54 @@ SSL* ClientHandler::get_ssl() const
   return ssl_;
 }
 
-void ClientHandler::set_spdy_session(SpdySession *spdy)
+void ClientHandler::set_spdy_session_pool(SpdySessionPool *spdy_pool)
+{
+  spdy_pool_ = spdy_pool;
+}
+
+SpdySessionPool* ClientHandler::get_spdy_session_pool() const
+{
+  return spdy_pool_;
+}
+
+void ClientHandler::set_http_dconn_pool(DownstreamConnectionPool *pool)
+{
+  http_dconn_pool_ = pool;
+}
+
+DownstreamConnectionPool* ClientHandler::get_http_dconn_pool() const
+{
+  return http_dconn_pool_;
+}
+
+void ClientHandler::set_downstream_balancer(DownstreamBalancer *balancer)
+{
+  balancer_ = balancer;
+}
+
+namespace {
+void output_cb(evbuffer *buffer, const evbuffer_cb_info *info, void *arg)
+{
+  auto stat = reinterpret_cast<WorkerStat*>(arg);
+  stat->pending_write_bytes.fetch_add(info->n_added,
+                                      std::memory_order_relaxed);
+  stat->pending_write_bytes.fetch_sub(info->n_deleted,
+                                      std::memory_order_relaxed);
+}
+} // namespace
+
+void ClientHandler::set_worker_stat(WorkerStat *stat)
 {
-  spdy_ = spdy;
+  worker_stat_ = stat;
+  auto output = bufferevent_get_output(bev_);
+  worker_stat_->pending_write_bytes.fetch_add(evbuffer_get_length(output),
+                                              std::memory_order_relaxed);
+  output_cb_entry_ = evbuffer_add_cb(output, output_cb, worker_stat_);
 }
 
-SpdySession* ClientHandler::get_spdy_session() const
+WorkerStat* ClientHandler::get_worker_stat() const
 {
-  return spdy_;
+  return worker_stat_;
 }
 
 size_t ClientHandler::get_left_connhd_len() const
@@ -36,8 +36,12 @@ namespace shrpx {
 
 class Upstream;
 class DownstreamConnection;
-class SpdySession;
+class SpdySessionPool;
 class HttpsUpstream;
+class DownstreamConnectionPool;
+class DownstreamBalancer;
+class Downstream;
+struct WorkerStat;
 
 class ClientHandler {
 public:
@@ -57,13 +61,18 @@ public:
   void set_should_close_after_write(bool f);
   Upstream* get_upstream();
 
+  // Pools SPDY |dconn| in this object. HTTP/1.1 connections are
+  // pooled in DownstreamConnectionPool instead.
   void pool_downstream_connection(DownstreamConnection *dconn);
-  void remove_downstream_connection(DownstreamConnection *dconn);
-  DownstreamConnection* get_downstream_connection();
+  // Returns the connection to the backend chosen for |downstream|.
+  DownstreamConnection* get_downstream_connection(Downstream *downstream);
   size_t get_pending_write_length();
   SSL* get_ssl() const;
-  void set_spdy_session(SpdySession *spdy);
-  SpdySession* get_spdy_session() const;
+  void set_spdy_session_pool(SpdySessionPool *spdy_pool);
+  SpdySessionPool* get_spdy_session_pool() const;
+  void set_http_dconn_pool(DownstreamConnectionPool *pool);
+  DownstreamConnectionPool* get_http_dconn_pool() const;
+  void set_downstream_balancer(DownstreamBalancer *balancer);
   size_t get_left_connhd_len() const;
   void set_left_connhd_len(size_t left);
   // Call this function when HTTP/2.0 connection header is received at
@@ -74,6 +83,12 @@ public:
   // terminated. This function returns 0 if it succeeds, or -1.
   int perform_http2_upgrade(HttpsUpstream *http);
   bool get_http2_upgrade_allowed() const;
+  // Makes this connection accounted in |stat|. The connection must be
+  // already counted in WorkerStat::num_connections, and it is
+  // uncounted when this object is deleted. The bytes pending in the
+  // output buffer are tracked in WorkerStat::pending_write_bytes.
+  void set_worker_stat(WorkerStat *stat);
+  WorkerStat* get_worker_stat() const;
 private:
   bufferevent *bev_;
   ev_token_bucket_cfg *evbucket_cfg_;
@@ -83,11 +98,21 @@ private:
   std::string ipaddr_;
   bool should_close_after_write_;
   std::set<DownstreamConnection*> dconn_pool_;
-  // Shared SPDY session for each thread. NULL if backend is not
+  // Shared SPDY sessions for each thread. NULL if backend is not
   // SPDY. Not deleted by this object.
-  SpdySession *spdy_;
+  SpdySessionPool *spdy_pool_;
+  // Idle HTTP/1.1 backend connections shared in the same thread. Not
+  // deleted by this object.
+  DownstreamConnectionPool *http_dconn_pool_;
+  // Chooses the backend for HTTP/1.1 backend connections. Not deleted
+  // by this object.
+  DownstreamBalancer *balancer_;
   // The number of bytes of HTTP/2.0 client connection header to read
   size_t left_connhd_len_;
+  // Load counters of the worker thread. NULL if not multi-threaded.
+  WorkerStat *worker_stat_;
+  // The callback to track the output buffer in worker_stat_
+  evbuffer_cb_entry *output_cb_entry_;
 };
 
 } // namespace shrpx
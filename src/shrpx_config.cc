@@ -35,6 +35,8 @@
 #include <cerrno>
 #include <limits>
 #include <fstream>
+#include <vector>
+#include <string>
 
 #include <nghttp2/nghttp2.h>
 
@@ -87,6 +89,7 @@ const char SHRPX_OPT_USER[] = "user";
 const char SHRPX_OPT_SYSLOG[] = "syslog";
 const char SHRPX_OPT_SYSLOG_FACILITY[] = "syslog-facility";
 const char SHRPX_OPT_BACKLOG[] = "backlog";
+const char SHRPX_OPT_REUSEPORT[] = "reuseport";
 const char SHRPX_OPT_CIPHERS[] = "ciphers";
 const char SHRPX_OPT_HONOR_CIPHER_ORDER[] = "honor-cipher-order";
 const char SHRPX_OPT_CLIENT[] = "client";
@@ -95,6 +98,17 @@ const char SHRPX_OPT_CACERT[] = "cacert";
 const char SHRPX_OPT_BACKEND_IPV4[] = "backend-ipv4";
 const char SHRPX_OPT_BACKEND_IPV6[] = "backend-ipv6";
 const char SHRPX_OPT_BACKEND_HTTP_PROXY_URI[] = "backend-http-proxy-uri";
+const char
+SHRPX_OPT_BACKEND_MAX_IDLE_CONNECTIONS[] = "backend-max-idle-connections";
+const char SHRPX_OPT_BACKEND_BALANCE[] = "backend-balance";
+const char SHRPX_OPT_BACKEND_EJECT_PERIOD[] = "backend-eject-period";
+const char
+SHRPX_OPT_BACKEND_SPDY_MAX_SESSIONS[] = "backend-spdy-max-sessions";
+const char SHRPX_OPT_TLS_TICKET_KEY_FILE[] = "tls-ticket-key-file";
+const char SHRPX_OPT_TLS_TICKET_KEY_ROTATION[] = "tls-ticket-key-rotation";
+const char SHRPX_OPT_TLS_SESSION_CACHE_SIZE[] = "tls-session-cache-size";
+const char
+SHRPX_OPT_TLS_SESSION_CACHE_MEMCACHED[] = "tls-session-cache-memcached";
 
 namespace {
 Config *config = 0;
@@ -190,16 +204,54 @@ void set_config_str(char **destp, const char *val)
   *destp = strdup(val);
 }
 
+namespace {
+// Replaces the backends with ones in |hostports|.
+int set_downstream_addrs(const char *hostports)
+{
+  // Backends are separated by ';'.
+  std::vector<std::string> items;
+  for(const char *p = hostports;;) {
+    const char *end = strchr(p, ';');
+    if(!end) {
+      items.push_back(p);
+      break;
+    }
+    items.push_back(std::string(p, end));
+    p = end + 1;
+  }
+  auto addrs = new DownstreamAddr[items.size()];
+  memset(addrs, 0, sizeof(DownstreamAddr) * items.size());
+  for(size_t i = 0; i < items.size(); ++i) {
+    char host[NI_MAXHOST];
+    uint16_t port;
+    if(split_host_port(host, sizeof(host), &port, items[i].c_str()) == -1) {
+      for(size_t j = 0; j < i; ++j) {
+        free(addrs[j].host);
+      }
+      delete [] addrs;
+      return -1;
+    }
+    set_config_str(&addrs[i].host, host);
+    addrs[i].port = port;
+  }
+  for(size_t i = 0; i < get_config()->num_downstream_addrs; ++i) {
+    free(get_config()->downstream_addrs[i].host);
+    free(get_config()->downstream_addrs[i].hostport);
+  }
+  delete [] get_config()->downstream_addrs;
+  mod_config()->downstream_addrs = addrs;
+  mod_config()->num_downstream_addrs = items.size();
+  return 0;
+}
+} // namespace
+
 int parse_config(const char *opt, const char *optarg)
 {
   char host[NI_MAXHOST];
   uint16_t port;
   if(util::strieq(opt, SHRPX_OPT_BACKEND)) {
-    if(split_host_port(host, sizeof(host), &port, optarg) == -1) {
+    if(set_downstream_addrs(optarg) == -1) {
       return -1;
-    } else {
-      set_config_str(&mod_config()->downstream_host, host);
-      mod_config()->downstream_port = port;
     }
   } else if(util::strieq(opt, SHRPX_OPT_FRONTEND)) {
     if(split_host_port(host, sizeof(host), &port, optarg) == -1) {
@@ -249,6 +301,32 @@ int parse_config(const char *opt, const char *optarg)
   } else if(util::strieq(opt, SHRPX_OPT_BACKEND_KEEP_ALIVE_TIMEOUT)) {
     timeval tv = {strtol(optarg, 0, 10), 0};
     mod_config()->downstream_idle_read_timeout = tv;
+  } else if(util::strieq(opt, SHRPX_OPT_BACKEND_MAX_IDLE_CONNECTIONS)) {
+    mod_config()->downstream_max_idle_connections = strtoul(optarg, 0, 10);
+  } else if(util::strieq(opt, SHRPX_OPT_BACKEND_BALANCE)) {
+    static const char hash_prefix[] = "header-hash:";
+    if(util::strieq(optarg, "round-robin")) {
+      mod_config()->downstream_balance_method = BALANCE_ROUND_ROBIN;
+    } else if(util::strieq(optarg, "least-outstanding")) {
+      mod_config()->downstream_balance_method = BALANCE_LEAST_OUTSTANDING;
+    } else if(util::istartsWith(optarg, hash_prefix) &&
+              optarg[sizeof(hash_prefix) - 1] != '\0') {
+      mod_config()->downstream_balance_method = BALANCE_HEADER_HASH;
+      set_config_str(&mod_config()->downstream_balance_hash_header,
+                     optarg + sizeof(hash_prefix) - 1);
+    } else {
+      LOG(ERROR) << "Unknown backend balance method: " << optarg;
+      return -1;
+    }
+  } else if(util::strieq(opt, SHRPX_OPT_BACKEND_EJECT_PERIOD)) {
+    mod_config()->downstream_eject_period = strtol(optarg, 0, 10);
+  } else if(util::strieq(opt, SHRPX_OPT_BACKEND_SPDY_MAX_SESSIONS)) {
+    size_t n = strtoul(optarg, 0, 10);
+    if(n == 0) {
+      LOG(ERROR) << "--" << opt << ": specify at least 1";
+      return -1;
+    }
+    mod_config()->downstream_spdy_max_sessions = n;
   } else if(util::strieq(opt, SHRPX_OPT_FRONTEND_SPDY_WINDOW_BITS) ||
             util::strieq(opt, SHRPX_OPT_BACKEND_SPDY_WINDOW_BITS)) {
     size_t *resp;
@@ -299,6 +377,30 @@ int parse_config(const char *opt, const char *optarg)
     set_config_str(&mod_config()->cert_file, optarg);
   } else if(util::strieq(opt, SHRPX_OPT_DH_PARAM_FILE)) {
     set_config_str(&mod_config()->dh_param_file, optarg);
+  } else if(util::strieq(opt, SHRPX_OPT_TLS_TICKET_KEY_FILE)) {
+    set_config_str(&mod_config()->tls_ticket_key_file, optarg);
+  } else if(util::strieq(opt, SHRPX_OPT_TLS_TICKET_KEY_ROTATION)) {
+    time_t sec = strtol(optarg, 0, 10);
+    if(sec <= 0) {
+      LOG(ERROR) << "--" << opt << ": specify at least 1";
+      return -1;
+    }
+    mod_config()->tls_ticket_key_rotation = sec;
+  } else if(util::strieq(opt, SHRPX_OPT_TLS_SESSION_CACHE_SIZE)) {
+    size_t n = strtoul(optarg, 0, 10);
+    if(n == 0) {
+      LOG(ERROR) << "--" << opt << ": specify at least 1";
+      return -1;
+    }
+    mod_config()->tls_session_cache_size = n;
+  } else if(util::strieq(opt, SHRPX_OPT_TLS_SESSION_CACHE_MEMCACHED)) {
+    char host[NI_MAXHOST];
+    uint16_t port;
+    if(split_host_port(host, sizeof(host), &port, optarg) == -1) {
+      return -1;
+    }
+    set_config_str(&mod_config()->tls_session_cache_memcached_host, host);
+    mod_config()->tls_session_cache_memcached_port = port;
   } else if(util::strieq(opt, SHRPX_OPT_SUBCERT)) {
     // Private Key file and certificate file separated by ':'.
     const char *sp = strchr(optarg, ':');
@@ -325,6 +427,8 @@ int parse_config(const char *opt, const char *optarg)
     mod_config()->syslog_facility = facility;
   } else if(util::strieq(opt, SHRPX_OPT_BACKLOG)) {
     mod_config()->backlog = strtol(optarg, 0, 10);
+  } else if(util::strieq(opt, SHRPX_OPT_REUSEPORT)) {
+    mod_config()->reuseport = util::strieq(optarg, "yes");
   } else if(util::strieq(opt, SHRPX_OPT_CIPHERS)) {
     set_config_str(&mod_config()->ciphers, optarg);
   } else if(util::strieq(opt, SHRPX_OPT_HONOR_CIPHER_ORDER)) {
@@ -76,6 +76,7 @@ extern const char SHRPX_OPT_USER[];
 extern const char SHRPX_OPT_SYSLOG[];
 extern const char SHRPX_OPT_SYSLOG_FACILITY[];
 extern const char SHRPX_OPT_BACKLOG[];
+extern const char SHRPX_OPT_REUSEPORT[];
 extern const char SHRPX_OPT_CIPHERS[];
 extern const char SHRPX_OPT_HONOR_CIPHER_ORDER[];
 extern const char SHRPX_OPT_CLIENT[];
@@ -84,7 +85,15 @@ extern const char SHRPX_OPT_CACERT[];
 extern const char SHRPX_OPT_BACKEND_IPV4[];
 extern const char SHRPX_OPT_BACKEND_IPV6[];
 extern const char SHRPX_OPT_BACKEND_HTTP_PROXY_URI[];
+extern const char SHRPX_OPT_BACKEND_MAX_IDLE_CONNECTIONS[];
+extern const char SHRPX_OPT_BACKEND_BALANCE[];
+extern const char SHRPX_OPT_BACKEND_EJECT_PERIOD[];
+extern const char SHRPX_OPT_BACKEND_SPDY_MAX_SESSIONS[];
 extern const char SHRPX_OPT_BACKEND_TLS_SNI_FIELD[];
+extern const char SHRPX_OPT_TLS_TICKET_KEY_FILE[];
+extern const char SHRPX_OPT_TLS_TICKET_KEY_ROTATION[];
+extern const char SHRPX_OPT_TLS_SESSION_CACHE_SIZE[];
+extern const char SHRPX_OPT_TLS_SESSION_CACHE_MEMCACHED[];
 
 union sockaddr_union {
   sockaddr sa;
@@ -98,6 +107,25 @@ enum shrpx_proto {
   PROTO_HTTP
 };
 
+// How a backend is chosen from Config::downstream_addrs
+enum shrpx_balance_method {
+  BALANCE_ROUND_ROBIN,
+  // The backend with the fewest requests in flight
+  BALANCE_LEAST_OUTSTANDING,
+  // Rendezvous hashing on the value of the request header
+  // Config::downstream_balance_hash_header
+  BALANCE_HEADER_HASH
+};
+
+struct DownstreamAddr {
+  char *host;
+  uint16_t port;
+  // host:port form. IPv6 numeric address is enclosed by [].
+  char *hostport;
+  sockaddr_union addr;
+  size_t addrlen;
+};
+
 struct Config {
   bool verbose;
   bool daemon;
@@ -109,19 +137,44 @@ struct Config {
   char *dh_param_file;
   SSL_CTX *default_ssl_ctx;
   ssl::CertLookupTree *cert_tree;
+  // The file session ticket keys are read from. If NULL, the keys
+  // are generated randomly.
+  char *tls_ticket_key_file;
+  // Session ticket keys are rotated (or reread from
+  // tls_ticket_key_file) at this interval in seconds.
+  time_t tls_ticket_key_rotation;
+  // The maximum number of sessions kept in the session cache
+  size_t tls_session_cache_size;
+  // The memcached server to share the session cache with other
+  // instances. NULL if not used.
+  char *tls_session_cache_memcached_host;
+  uint16_t tls_session_cache_memcached_port;
+  sockaddr_union tls_session_cache_memcached_addr;
+  size_t tls_session_cache_memcached_addrlen;
   bool verify_client;
   const char *server_name;
-  char *downstream_host;
-  uint16_t downstream_port;
-  char *downstream_hostport;
-  sockaddr_union downstream_addr;
-  size_t downstream_addrlen;
+  // The backends given by --backend. There is at least one.
+  DownstreamAddr *downstream_addrs;
+  size_t num_downstream_addrs;
+  shrpx_balance_method downstream_balance_method;
+  // The header name hashed if downstream_balance_method is
+  // BALANCE_HEADER_HASH.
+  char *downstream_balance_hash_header;
+  // The backend which failed to connect is not chosen for this many
+  // seconds.
+  time_t downstream_eject_period;
   timeval spdy_upstream_read_timeout;
   timeval upstream_read_timeout;
   timeval upstream_write_timeout;
   timeval downstream_read_timeout;
   timeval downstream_write_timeout;
   timeval downstream_idle_read_timeout;
+  // The maximum number of idle HTTP/1.1 backend connections kept for
+  // each backend address in each thread.
+  size_t downstream_max_idle_connections;
+  // The maximum number of HTTP/2.0 or SPDY backend sessions opened
+  // by each thread.
+  size_t downstream_spdy_max_sessions;
   size_t num_worker;
   size_t spdy_max_concurrent_streams;
   bool spdy_proxy;
@@ -144,6 +197,9 @@ struct Config {
   // This member finally decides syslog is used or not
   bool use_syslog;
   int backlog;
+  // true if each worker thread accepts connections from its own
+  // listening socket bound with SO_REUSEPORT.
+  bool reuseport;
   char *ciphers;
   bool honor_cipher_order;
   bool client;
@@ -31,6 +31,7 @@
 #include "shrpx_config.h"
 #include "shrpx_error.h"
 #include "shrpx_downstream_connection.h"
+#include "shrpx_worker_stat.h"
 #include "util.h"
 
 using namespace nghttp2;
@@ -62,8 +63,18 @@ Downstream::Downstream(Upstream *upstream, int stream_id, int priority)
     response_header_key_prev_(false),
     response_body_buf_(nullptr),
     response_rst_stream_error_code_(NGHTTP2_NO_ERROR),
-    recv_window_size_(0)
-{}
+    recv_window_size_(0),
+    worker_stat_(nullptr)
+{
+  std::fill(std::begin(request_hdidx_), std::end(request_hdidx_), -1);
+  std::fill(std::begin(response_hdidx_), std::end(response_hdidx_), -1);
+  if(upstream_) {
+    worker_stat_ = upstream_->get_client_handler()->get_worker_stat();
+    if(worker_stat_) {
+      worker_stat_->num_downstreams.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
 
 Downstream::~Downstream()
 {
@@ -77,6 +88,9 @@ Downstream::~Downstream()
   if(dconn_) {
     delete dconn_;
   }
+  if(worker_stat_) {
+    worker_stat_->num_downstreams.fetch_sub(1, std::memory_order_relaxed);
+  }
   if(LOG_ENABLED(INFO)) {
     DLOG(INFO, this) << "Deleted";
   }
@@ -166,19 +180,44 @@ auto name_less = [](const Headers::value_type& lhs,
 } // namespace
 
 namespace {
-void normalize_headers(Headers& headers)
+// Lowercases and sorts |headers|, and records the index of the first
+// header of each token in |hdidx|.
+void normalize_headers(Headers& headers, int *hdidx)
 {
   for(auto& kv : headers) {
     util::inp_strlower(kv.first);
   }
   std::sort(std::begin(headers), std::end(headers), name_less);
+  std::fill(hdidx, hdidx + http2::HD_MAXIDX, -1);
+  for(size_t i = headers.size(); i > 0; --i) {
+    int token = http2::lookup_token(headers[i-1].first);
+    if(token != -1) {
+      hdidx[token] = i-1;
+    }
+  }
+}
+} // namespace
+
+namespace {
+Headers::const_iterator get_norm_header(const Headers& headers,
+                                        const int *hdidx, int token)
+{
+  if(hdidx[token] == -1) {
+    return std::end(headers);
+  }
+  return std::begin(headers) + hdidx[token];
 }
 } // namespace
 
 namespace {
 Headers::const_iterator get_norm_header(const Headers& headers,
+                                        const int *hdidx,
                                         const std::string& name)
 {
+  int token = http2::lookup_token(name);
+  if(token != -1) {
+    return get_norm_header(headers, hdidx, token);
+  }
   auto i = std::lower_bound(std::begin(headers), std::end(headers),
                             std::make_pair(name, std::string()), name_less);
   if(i != std::end(headers) && (*i).first == name) {
@@ -195,13 +234,18 @@ const Headers& Downstream::get_request_headers() const
 
 void Downstream::normalize_request_headers()
 {
-  normalize_headers(request_headers_);
+  normalize_headers(request_headers_, request_hdidx_);
 }
 
 Headers::const_iterator Downstream::get_norm_request_header
 (const std::string& name) const
 {
-  return get_norm_header(request_headers_, name);
+  return get_norm_header(request_headers_, request_hdidx_, name);
+}
+
+Headers::const_iterator Downstream::get_norm_request_header(int token) const
+{
+  return get_norm_header(request_headers_, request_hdidx_, token);
 }
 
 void Downstream::add_request_header(const std::string& name,
@@ -378,13 +422,18 @@ const Headers& Downstream::get_response_headers() const
 
 void Downstream::normalize_response_headers()
 {
-  normalize_headers(response_headers_);
+  normalize_headers(response_headers_, response_hdidx_);
 }
 
 Headers::const_iterator Downstream::get_norm_response_header
 (const std::string& name) const
 {
-  return get_norm_header(response_headers_, name);
+  return get_norm_header(response_headers_, response_hdidx_, name);
+}
+
+Headers::const_iterator Downstream::get_norm_response_header(int token) const
+{
+  return get_norm_header(response_headers_, response_hdidx_, token);
 }
 
 void Downstream::add_response_header(const std::string& name,
@@ -38,11 +38,13 @@
 #include <nghttp2/nghttp2.h>
 
 #include "shrpx_io_control.h"
+#include "http2.h"
 
 namespace shrpx {
 
 class Upstream;
 class DownstreamConnection;
+struct WorkerStat;
 
 typedef std::vector<std::pair<std::string, std::string> > Headers;
 
@@ -93,6 +95,9 @@ public:
   // called after calling normalize_request_headers().
   Headers::const_iterator get_norm_request_header
   (const std::string& name) const;
+  // Same as above, but looks up the header by its http2::HD_* |token|
+  // in constant time.
+  Headers::const_iterator get_norm_request_header(int token) const;
   void add_request_header(const std::string& name, const std::string& value);
   void set_last_request_header_value(const std::string& value);
 
@@ -138,6 +143,9 @@ public:
   // called after calling normalize_response_headers().
   Headers::const_iterator get_norm_response_header
   (const std::string& name) const;
+  // Same as above, but looks up the header by its http2::HD_* |token|
+  // in constant time.
+  Headers::const_iterator get_norm_response_header(int token) const;
   void add_response_header(const std::string& name, const std::string& value);
   void set_last_response_header_value(const std::string& value);
 
@@ -190,6 +198,9 @@ private:
   bool request_connection_close_;
   bool request_expect_100_continue_;
   Headers request_headers_;
+  // The index of the first header in request_headers_ for each
+  // http2::HD_* token, or -1. Built by normalize_request_headers().
+  int request_hdidx_[nghttp2::http2::HD_MAXIDX];
   bool request_header_key_prev_;
   // the length of request body
   int64_t request_bodylen_;
@@ -201,6 +212,8 @@ private:
   bool chunked_response_;
   bool response_connection_close_;
   Headers response_headers_;
+  // Same as request_hdidx_ for response_headers_
+  int response_hdidx_[nghttp2::http2::HD_MAXIDX];
   bool response_header_key_prev_;
   // This buffer is used to temporarily store downstream response
   // body. Spdylay reads data from this in the callback.
@@ -208,6 +221,9 @@ private:
   // RST_STREAM error_code from downstream SPDY connection
   nghttp2_error_code response_rst_stream_error_code_;
   int32_t recv_window_size_;
+  // Load counters of the worker thread this object belongs to. NULL
+  // if not multi-threaded.
+  WorkerStat *worker_stat_;
 };
 
 } // namespace shrpx
@@ -0,0 +1,163 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "shrpx_downstream_balancer.h"
+
+#include <stdint.h>
+
+#include "shrpx_downstream.h"
+#include "shrpx_log.h"
+#include "util.h"
+
+using namespace nghttp2;
+
+namespace shrpx {
+
+namespace {
+uint64_t fnv1a(const std::string& s)
+{
+  uint64_t h = 14695981039346656037ULL;
+  for(auto c : s) {
+    h ^= static_cast<uint8_t>(c);
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+} // namespace
+
+namespace {
+// The finalizer of SplitMix64
+uint64_t mix64(uint64_t x)
+{
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+} // namespace
+
+DownstreamBalancer::DownstreamBalancer(size_t num_addrs,
+                                       shrpx_balance_method method,
+                                       time_t eject_period)
+  : addrs_(num_addrs, AddrState{0, 0}),
+    method_(method),
+    eject_period_(eject_period),
+    next_(0)
+{}
+
+size_t DownstreamBalancer::select_addr(const std::string *hash_key,
+                                       time_t now)
+{
+  size_t n = addrs_.size();
+  if(n == 1) {
+    return 0;
+  }
+  bool all_ejected = true;
+  for(size_t i = 0; i < n; ++i) {
+    if(!ejected(i, now)) {
+      all_ejected = false;
+      break;
+    }
+  }
+  size_t best = n;
+  if(method_ == BALANCE_HEADER_HASH && hash_key) {
+    // Rendezvous hashing: only the keys on an ejected backend move.
+    uint64_t h = fnv1a(*hash_key);
+    uint64_t best_score = 0;
+    for(size_t i = 0; i < n; ++i) {
+      if(!all_ejected && ejected(i, now)) {
+        continue;
+      }
+      uint64_t score = mix64(h ^ mix64(i + 1));
+      if(best == n || score > best_score) {
+        best = i;
+        best_score = score;
+      }
+    }
+    return best;
+  }
+  size_t start = next_++;
+  for(size_t k = 0; k < n; ++k) {
+    size_t i = (start + k) % n;
+    if(!all_ejected && ejected(i, now)) {
+      continue;
+    }
+    if(method_ != BALANCE_LEAST_OUTSTANDING) {
+      return i;
+    }
+    if(best == n || addrs_[i].outstanding < addrs_[best].outstanding) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+size_t DownstreamBalancer::select_addr(const Downstream *downstream,
+                                       time_t now)
+{
+  if(method_ == BALANCE_HEADER_HASH) {
+    auto name = get_config()->downstream_balance_hash_header;
+    for(auto& nv : downstream->get_request_headers()) {
+      if(util::strieq(nv.first.c_str(), name)) {
+        return select_addr(&nv.second, now);
+      }
+    }
+  }
+  return select_addr(static_cast<const std::string*>(nullptr), now);
+}
+
+void DownstreamBalancer::on_request_start(size_t idx)
+{
+  ++addrs_[idx].outstanding;
+}
+
+void DownstreamBalancer::on_request_end(size_t idx)
+{
+  --addrs_[idx].outstanding;
+}
+
+void DownstreamBalancer::on_connect_success(size_t idx)
+{
+  addrs_[idx].eject_until = 0;
+}
+
+void DownstreamBalancer::on_connect_failure(size_t idx, time_t now)
+{
+  if(LOG_ENABLED(INFO)) {
+    LOG(INFO) << "Backend #" << idx << " failed to connect. Ejected for "
+              << eject_period_ << " seconds";
+  }
+  addrs_[idx].eject_until = now + eject_period_;
+}
+
+bool DownstreamBalancer::ejected(size_t idx, time_t now) const
+{
+  return now < addrs_[idx].eject_until;
+}
+
+size_t DownstreamBalancer::get_outstanding(size_t idx) const
+{
+  return addrs_[idx].outstanding;
+}
+
+} // namespace shrpx
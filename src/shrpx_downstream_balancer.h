@@ -0,0 +1,80 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef SHRPX_DOWNSTREAM_BALANCER_H
+#define SHRPX_DOWNSTREAM_BALANCER_H
+
+#include "shrpx.h"
+
+#include <sys/types.h>
+
+#include <vector>
+#include <string>
+
+#include "shrpx_config.h"
+
+namespace shrpx {
+
+class Downstream;
+
+// Chooses a backend from Config::downstream_addrs for each request
+// and tracks the requests in flight and connection failures for each
+// of them. There is one object per event loop; this object is not
+// thread-safe.
+class DownstreamBalancer {
+public:
+  // |num_addrs| is the number of backends. A backend which failed to
+  // connect is not chosen for |eject_period| seconds.
+  DownstreamBalancer(size_t num_addrs, shrpx_balance_method method,
+                     time_t eject_period);
+  // Returns the index of the backend to use at time |now|. |hash_key|
+  // is used by BALANCE_HEADER_HASH; if it is NULL, round-robin is
+  // used instead. The ejected backends are skipped unless all of them
+  // are ejected.
+  size_t select_addr(const std::string *hash_key, time_t now);
+  // Returns the index of the backend for |downstream|, taking the
+  // hash key from its request header if needed.
+  size_t select_addr(const Downstream *downstream, time_t now);
+  void on_request_start(size_t idx);
+  void on_request_end(size_t idx);
+  void on_connect_success(size_t idx);
+  void on_connect_failure(size_t idx, time_t now);
+  bool ejected(size_t idx, time_t now) const;
+  size_t get_outstanding(size_t idx) const;
+private:
+  struct AddrState {
+    // The number of requests in flight
+    size_t outstanding;
+    // The backend is not chosen until this time
+    time_t eject_until;
+  };
+  std::vector<AddrState> addrs_;
+  shrpx_balance_method method_;
+  time_t eject_period_;
+  size_t next_;
+};
+
+} // namespace shrpx
+
+#endif // SHRPX_DOWNSTREAM_BALANCER_H
@@ -0,0 +1,105 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "shrpx_downstream_balancer_test.h"
+
+#include <CUnit/CUnit.h>
+
+#include "shrpx_downstream_balancer.h"
+
+namespace shrpx {
+
+void test_downstream_balancer_round_robin(void)
+{
+  DownstreamBalancer balancer(3, BALANCE_ROUND_ROBIN, 10);
+  CU_ASSERT(0 == balancer.select_addr(static_cast<std::string*>(nullptr),
+                                      100));
+  CU_ASSERT(1 == balancer.select_addr(static_cast<std::string*>(nullptr),
+                                      100));
+  CU_ASSERT(2 == balancer.select_addr(static_cast<std::string*>(nullptr),
+                                      100));
+
+  balancer.on_connect_failure(1, 100);
+  CU_ASSERT(balancer.ejected(1, 109));
+  CU_ASSERT(!balancer.ejected(1, 110));
+  for(int i = 0; i < 6; ++i) {
+    CU_ASSERT(1 != balancer.select_addr(static_cast<std::string*>(nullptr),
+                                        105));
+  }
+
+  // All ejected: fall back to round-robin over all of them.
+  balancer.on_connect_failure(0, 100);
+  balancer.on_connect_failure(2, 100);
+  CU_ASSERT(0 == balancer.select_addr(static_cast<std::string*>(nullptr),
+                                      105));
+  CU_ASSERT(1 == balancer.select_addr(static_cast<std::string*>(nullptr),
+                                      105));
+
+  balancer.on_connect_success(1);
+  CU_ASSERT(!balancer.ejected(1, 105));
+}
+
+void test_downstream_balancer_least_outstanding(void)
+{
+  DownstreamBalancer balancer(3, BALANCE_LEAST_OUTSTANDING, 10);
+  balancer.on_request_start(0);
+  balancer.on_request_start(0);
+  balancer.on_request_start(2);
+  CU_ASSERT(1 == balancer.select_addr(static_cast<std::string*>(nullptr),
+                                      100));
+  balancer.on_request_start(1);
+  balancer.on_request_start(1);
+  CU_ASSERT(2 == balancer.select_addr(static_cast<std::string*>(nullptr),
+                                      100));
+  balancer.on_request_end(0);
+  balancer.on_request_end(0);
+  CU_ASSERT(0 == balancer.get_outstanding(0));
+  CU_ASSERT(0 == balancer.select_addr(static_cast<std::string*>(nullptr),
+                                      100));
+}
+
+void test_downstream_balancer_header_hash(void)
+{
+  DownstreamBalancer balancer(4, BALANCE_HEADER_HASH, 10);
+  std::string keys[] = { "alpha", "bravo", "charlie", "delta", "echo" };
+  size_t idx[5];
+  for(size_t i = 0; i < 5; ++i) {
+    idx[i] = balancer.select_addr(&keys[i], 100);
+    CU_ASSERT(idx[i] < 4);
+    CU_ASSERT(idx[i] == balancer.select_addr(&keys[i], 100));
+  }
+  // Only the keys on the ejected backend move elsewhere.
+  balancer.on_connect_failure(idx[0], 100);
+  for(size_t i = 0; i < 5; ++i) {
+    auto j = balancer.select_addr(&keys[i], 105);
+    if(idx[i] == idx[0]) {
+      CU_ASSERT(idx[0] != j);
+    } else {
+      CU_ASSERT(idx[i] == j);
+    }
+  }
+  CU_ASSERT(idx[0] == balancer.select_addr(&keys[0], 110));
+}
+
+} // namespace shrpx
@@ -42,6 +42,11 @@ ClientHandler* DownstreamConnection::get_client_handler()
   return client_handler_;
 }
 
+void DownstreamConnection::set_client_handler(ClientHandler *client_handler)
+{
+  client_handler_ = client_handler;
+}
+
 Downstream* DownstreamConnection::get_downstream()
 {
   return downstream_;
@@ -58,6 +58,7 @@ public:
   virtual void on_upstream_change(Upstream *uptream) = 0;
 
   ClientHandler* get_client_handler();
+  void set_client_handler(ClientHandler *client_handler);
   Downstream* get_downstream();
 protected:
   ClientHandler *client_handler_;
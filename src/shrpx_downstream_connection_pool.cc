@@ -0,0 +1,135 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "shrpx_downstream_connection_pool.h"
+
+#include <algorithm>
+
+#include "shrpx_http_downstream_connection.h"
+#include "shrpx_worker_stat.h"
+#include "shrpx_log.h"
+
+namespace shrpx {
+
+namespace {
+std::string make_addr_key(const sockaddr *addr, size_t addrlen)
+{
+  return std::string(reinterpret_cast<const char*>(addr), addrlen);
+}
+} // namespace
+
+DownstreamConnectionPool::DownstreamConnectionPool(size_t max_idle,
+                                                   WorkerStat *stat)
+  : max_idle_(max_idle),
+    num_idle_(0),
+    num_hits_(0),
+    num_misses_(0),
+    stat_(stat)
+{}
+
+DownstreamConnectionPool::~DownstreamConnectionPool()
+{
+  for(auto& kv : idle_) {
+    for(auto dconn : kv.second) {
+      delete dconn;
+    }
+  }
+}
+
+void DownstreamConnectionPool::add_downstream_connection
+(HttpDownstreamConnection *dconn)
+{
+  auto& conns = idle_[make_addr_key(&dconn->get_addr()->sa,
+                                    dconn->get_addrlen())];
+  if(conns.size() >= max_idle_) {
+    if(conns.empty()) {
+      // max_idle_ == 0
+      delete dconn;
+      return;
+    }
+    auto lru = conns.back();
+    conns.pop_back();
+    --num_idle_;
+    if(LOG_ENABLED(INFO)) {
+      DCLOG(INFO, lru) << "Too many idle connections. Deleting";
+    }
+    delete lru;
+  }
+  conns.push_front(dconn);
+  ++num_idle_;
+}
+
+void DownstreamConnectionPool::remove_downstream_connection
+(HttpDownstreamConnection *dconn)
+{
+  auto i = idle_.find(make_addr_key(&dconn->get_addr()->sa,
+                                    dconn->get_addrlen()));
+  if(i == idle_.end()) {
+    return;
+  }
+  auto& conns = (*i).second;
+  auto j = std::find(conns.begin(), conns.end(), dconn);
+  if(j != conns.end()) {
+    conns.erase(j);
+    --num_idle_;
+  }
+}
+
+HttpDownstreamConnection* DownstreamConnectionPool::pop_downstream_connection
+(const sockaddr *addr, size_t addrlen)
+{
+  auto i = idle_.find(make_addr_key(addr, addrlen));
+  if(i == idle_.end() || (*i).second.empty()) {
+    ++num_misses_;
+    if(stat_) {
+      stat_->backend_pool_misses.fetch_add(1, std::memory_order_relaxed);
+    }
+    return nullptr;
+  }
+  auto dconn = (*i).second.front();
+  (*i).second.pop_front();
+  --num_idle_;
+  ++num_hits_;
+  if(stat_) {
+    stat_->backend_pool_hits.fetch_add(1, std::memory_order_relaxed);
+  }
+  return dconn;
+}
+
+size_t DownstreamConnectionPool::get_num_idle() const
+{
+  return num_idle_;
+}
+
+uint64_t DownstreamConnectionPool::get_num_hits() const
+{
+  return num_hits_;
+}
+
+uint64_t DownstreamConnectionPool::get_num_misses() const
+{
+  return num_misses_;
+}
+
+} // namespace shrpx
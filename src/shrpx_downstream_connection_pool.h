@@ -0,0 +1,83 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef SHRPX_DOWNSTREAM_CONNECTION_POOL_H
+#define SHRPX_DOWNSTREAM_CONNECTION_POOL_H
+
+#include "shrpx.h"
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include <map>
+#include <list>
+#include <string>
+
+namespace shrpx {
+
+class HttpDownstreamConnection;
+struct WorkerStat;
+
+// Idle HTTP/1.1 backend connections shared by all ClientHandlers in
+// one event loop (a worker thread, or the main thread if
+// single-threaded). Connections are keyed by their backend address
+// and the most recently used one is reused first. This object is not
+// thread-safe.
+class DownstreamConnectionPool {
+public:
+  // At most |max_idle| idle connections are kept for each backend
+  // address. If |stat| is not NULL, hit/miss counters are also
+  // published to it.
+  DownstreamConnectionPool(size_t max_idle, WorkerStat *stat);
+  // Deletes all idle connections.
+  ~DownstreamConnectionPool();
+  // Adds idle |dconn| to the pool. If the pool for its backend
+  // address is full, the least recently used connection is deleted.
+  void add_downstream_connection(HttpDownstreamConnection *dconn);
+  // Removes |dconn| from the pool without deleting it.
+  void remove_downstream_connection(HttpDownstreamConnection *dconn);
+  // Removes and returns an idle connection to the backend |addr| of
+  // length |addrlen|, or returns NULL if there is none.
+  HttpDownstreamConnection* pop_downstream_connection(const sockaddr *addr,
+                                                      size_t addrlen);
+  size_t get_num_idle() const;
+  // The number of pop_downstream_connection() calls which found an
+  // idle connection.
+  uint64_t get_num_hits() const;
+  // The number of pop_downstream_connection() calls which did not.
+  uint64_t get_num_misses() const;
+private:
+  // Idle connections for each backend address, the most recently
+  // used first.
+  std::map<std::string, std::list<HttpDownstreamConnection*>> idle_;
+  size_t max_idle_;
+  size_t num_idle_;
+  uint64_t num_hits_;
+  uint64_t num_misses_;
+  WorkerStat *stat_;
+};
+
+} // namespace shrpx
+
+#endif // SHRPX_DOWNSTREAM_CONNECTION_POOL_H
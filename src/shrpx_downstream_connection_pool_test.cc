@@ -0,0 +1,86 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "shrpx_downstream_connection_pool_test.h"
+
+#include <cstring>
+
+#include <CUnit/CUnit.h>
+
+#include "shrpx_downstream_connection_pool.h"
+#include "shrpx_http_downstream_connection.h"
+#include "shrpx_worker_stat.h"
+
+namespace shrpx {
+
+void test_downstream_connection_pool(void)
+{
+  sockaddr_union addr1, addr2;
+  memset(&addr1, 0, sizeof(addr1));
+  memset(&addr2, 0, sizeof(addr2));
+  addr1.in.sin_family = AF_INET;
+  addr1.in.sin_port = htons(80);
+  addr2.in.sin_family = AF_INET;
+  addr2.in.sin_port = htons(8080);
+  auto addrlen = sizeof(addr1.in);
+  WorkerStat stat;
+  DownstreamConnectionPool pool(2, &stat);
+
+  CU_ASSERT(nullptr == pool.pop_downstream_connection(&addr1.sa, addrlen));
+  CU_ASSERT(1 == pool.get_num_misses());
+  CU_ASSERT(1 == stat.backend_pool_misses);
+
+  auto a = new HttpDownstreamConnection(nullptr, &addr1, addrlen);
+  auto b = new HttpDownstreamConnection(nullptr, &addr1, addrlen);
+  auto c = new HttpDownstreamConnection(nullptr, &addr1, addrlen);
+  auto d = new HttpDownstreamConnection(nullptr, &addr2, addrlen);
+  pool.add_downstream_connection(a);
+  pool.add_downstream_connection(b);
+  pool.add_downstream_connection(d);
+  CU_ASSERT(3 == pool.get_num_idle());
+
+  // The pool for addr1 is full. The least recently used one, a, is
+  // deleted.
+  pool.add_downstream_connection(c);
+  CU_ASSERT(3 == pool.get_num_idle());
+
+  // The most recently used one is reused first.
+  CU_ASSERT(c == pool.pop_downstream_connection(&addr1.sa, addrlen));
+  CU_ASSERT(1 == pool.get_num_hits());
+  CU_ASSERT(1 == stat.backend_pool_hits);
+
+  pool.remove_downstream_connection(b);
+  CU_ASSERT(1 == pool.get_num_idle());
+  CU_ASSERT(nullptr == pool.pop_downstream_connection(&addr1.sa, addrlen));
+  CU_ASSERT(2 == pool.get_num_misses());
+
+  CU_ASSERT(d == pool.pop_downstream_connection(&addr2.sa, addrlen));
+  CU_ASSERT(0 == pool.get_num_idle());
+
+  delete b;
+  delete c;
+  delete d;
+}
+
+} // namespace shrpx
@@ -30,35 +30,107 @@
 
 namespace shrpx {
 
+namespace {
+// The initial number of slots is 1 << INITIAL_BITS
+const size_t INITIAL_BITS = 4;
+} // namespace
+
 DownstreamQueue::DownstreamQueue()
+  : size_(0),
+    bits_(0)
 {}
 
 DownstreamQueue::~DownstreamQueue()
 {
-  for(std::map<int32_t, Downstream*>::iterator i = downstreams_.begin();
-      i != downstreams_.end(); ++i) {
-    delete (*i).second;
+  for(auto& ent : table_) {
+    delete ent.downstream;
+  }
+}
+
+size_t DownstreamQueue::bucket(int32_t stream_id) const
+{
+  // Fibonacci hashing. Stream IDs are sequential, and this spreads
+  // them evenly over the table.
+  return (static_cast<uint32_t>(stream_id) * 2654435769u) >> (32 - bits_);
+}
+
+size_t DownstreamQueue::lookup(int32_t stream_id) const
+{
+  size_t mask = table_.size() - 1;
+  for(size_t i = bucket(stream_id);; i = (i + 1) & mask) {
+    auto& ent = table_[i];
+    if(!ent.downstream || ent.stream_id == stream_id) {
+      return i;
+    }
+  }
+}
+
+void DownstreamQueue::resize(size_t bits)
+{
+  std::vector<Entry> table(static_cast<size_t>(1) << bits,
+                           Entry{0, nullptr});
+  table_.swap(table);
+  bits_ = bits;
+  for(auto& ent : table) {
+    if(ent.downstream) {
+      table_[lookup(ent.stream_id)] = ent;
+    }
   }
 }
 
 void DownstreamQueue::add(Downstream *downstream)
 {
-  downstreams_[downstream->get_stream_id()] = downstream;
+  if(table_.empty()) {
+    resize(INITIAL_BITS);
+  } else if((size_ + 1) * 2 > table_.size()) {
+    resize(bits_ + 1);
+  }
+  auto stream_id = downstream->get_stream_id();
+  auto& ent = table_[lookup(stream_id)];
+  if(!ent.downstream) {
+    ++size_;
+  }
+  ent.stream_id = stream_id;
+  ent.downstream = downstream;
 }
 
 void DownstreamQueue::remove(Downstream *downstream)
 {
-  downstreams_.erase(downstream->get_stream_id());
+  if(size_ == 0) {
+    return;
+  }
+  size_t i = lookup(downstream->get_stream_id());
+  if(!table_[i].downstream) {
+    return;
+  }
+  --size_;
+  // Shift the following entries of the probe sequence back into the
+  // hole, so that lookup() needs no tombstones.
+  size_t mask = table_.size() - 1;
+  for(size_t j = (i + 1) & mask; table_[j].downstream; j = (j + 1) & mask) {
+    size_t k = bucket(table_[j].stream_id);
+    // Move the entry at j to i unless its home slot k lies
+    // cyclically in (i, j].
+    if(i <= j ? (i < k && k <= j) : (i < k || k <= j)) {
+      continue;
+    }
+    table_[i] = table_[j];
+    i = j;
+  }
+  table_[i].downstream = nullptr;
 }
 
 Downstream* DownstreamQueue::find(int32_t stream_id)
 {
-  std::map<int32_t, Downstream*>::iterator i = downstreams_.find(stream_id);
-  if(i == downstreams_.end()) {
-    return 0;
-  } else {
-    return (*i).second;
+  if(size_ == 0) {
+    return nullptr;
   }
+  return table_[lookup(stream_id)].downstream;
+}
+
+size_t DownstreamQueue::size() const
+{
+  return size_;
 }
 
 } // namespace shrpx
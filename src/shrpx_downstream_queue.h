@@ -29,21 +29,47 @@
 
 #include <stdint.h>
 
-#include <map>
+#include <vector>
 
 namespace shrpx {
 
 class Downstream;
 
+// The Downstreams of an upstream connection, keyed by stream ID. This
+// is an open addressing hash table with linear probing, so that
+// find(), which is called for most frames received, touches a
+// contiguous array instead of the nodes of a tree.
 class DownstreamQueue {
 public:
   DownstreamQueue();
+  // Deletes all Downstreams still in this object.
   ~DownstreamQueue();
+  // Adds |downstream|. If a Downstream with the same stream ID is
+  // already added, it is replaced.
   void add(Downstream *downstream);
+  // Removes the Downstream with the stream ID of |downstream|.
   void remove(Downstream *downstream);
+  // Returns the Downstream with |stream_id|, or NULL.
   Downstream* find(int32_t stream_id);
+  size_t size() const;
 private:
-  std::map<int32_t, Downstream*> downstreams_;
+  struct Entry {
+    int32_t stream_id;
+    // NULL if the slot is empty
+    Downstream *downstream;
+  };
+  size_t bucket(int32_t stream_id) const;
+  // Returns the index of the slot which holds |stream_id|, or the
+  // empty slot where it would be inserted.
+  size_t lookup(int32_t stream_id) const;
+  // Rebuilds the table with 1 << |bits| slots.
+  void resize(size_t bits);
+  // The number of slots is a power of 2, and is kept at least twice
+  // the number of entries.
+  std::vector<Entry> table_;
+  size_t size_;
+  // The number of slots is 1 << bits_.
+  size_t bits_;
 };
 
 } // namespace shrpx
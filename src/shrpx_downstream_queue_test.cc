@@ -0,0 +1,92 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2012 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "shrpx_downstream_queue_test.h"
+
+#include <vector>
+
+#include <CUnit/CUnit.h>
+
+#include "shrpx_downstream_queue.h"
+#include "shrpx_downstream.h"
+
+namespace shrpx {
+
+void test_downstream_queue_add_find_remove(void)
+{
+  DownstreamQueue dq;
+  auto d1 = new Downstream(nullptr, 1, 0);
+  auto d3 = new Downstream(nullptr, 3, 0);
+  CU_ASSERT(nullptr == dq.find(1));
+  dq.add(d1);
+  dq.add(d3);
+  CU_ASSERT(2 == dq.size());
+  CU_ASSERT(d1 == dq.find(1));
+  CU_ASSERT(d3 == dq.find(3));
+  CU_ASSERT(nullptr == dq.find(5));
+  // Replaces the one with the same stream ID
+  auto d3b = new Downstream(nullptr, 3, 0);
+  dq.add(d3b);
+  CU_ASSERT(2 == dq.size());
+  CU_ASSERT(d3b == dq.find(3));
+  delete d3;
+  dq.remove(d1);
+  CU_ASSERT(1 == dq.size());
+  CU_ASSERT(nullptr == dq.find(1));
+  CU_ASSERT(d3b == dq.find(3));
+  // Removing again does nothing
+  dq.remove(d1);
+  CU_ASSERT(1 == dq.size());
+  delete d1;
+}
+
+void test_downstream_queue_many(void)
+{
+  DownstreamQueue dq;
+  std::vector<Downstream*> ds;
+  for(int32_t i = 0; i < 1000; ++i) {
+    ds.push_back(new Downstream(nullptr, i * 2 + 1, 0));
+    dq.add(ds.back());
+  }
+  CU_ASSERT(1000 == dq.size());
+  // Remove every third one, which moves the entries after them in
+  // their probe sequences.
+  for(size_t i = 0; i < ds.size(); i += 3) {
+    dq.remove(ds[i]);
+  }
+  bool ok = true;
+  for(size_t i = 0; i < ds.size(); ++i) {
+    auto found = dq.find(ds[i]->get_stream_id());
+    if(found != (i % 3 == 0 ? nullptr : ds[i])) {
+      ok = false;
+    }
+  }
+  CU_ASSERT(ok);
+  for(size_t i = 0; i < ds.size(); i += 3) {
+    delete ds[i];
+  }
+  CU_ASSERT(666 == dq.size());
+}
+
+} // namespace shrpx
@@ -30,6 +30,8 @@
 
 #include "shrpx_downstream.h"
 
+using namespace nghttp2;
+
 namespace shrpx {
 
 void test_downstream_normalize_request_headers(void)
@@ -110,4 +112,43 @@ void test_downstream_get_norm_response_header(void)
   CU_ASSERT(i == std::end(d.get_response_headers()));
 }
 
+void test_downstream_get_norm_request_header_token(void)
+{
+  Downstream d(nullptr, 0, 0);
+  d.add_request_header("X-Forwarded-For", "192.168.0.1");
+  d.add_request_header("Host", "example.org");
+  d.add_request_header("user-agent", "nghttp");
+  d.add_request_header("Via", "1.1 proxy");
+  d.normalize_request_headers();
+  auto i = d.get_norm_request_header(http2::HD_HOST);
+  CU_ASSERT(std::make_pair(std::string("host"),
+                           std::string("example.org")) == *i);
+  i = d.get_norm_request_header(http2::HD_VIA);
+  CU_ASSERT(std::make_pair(std::string("via"),
+                           std::string("1.1 proxy")) == *i);
+  i = d.get_norm_request_header(http2::HD_X_FORWARDED_FOR);
+  CU_ASSERT(std::make_pair(std::string("x-forwarded-for"),
+                           std::string("192.168.0.1")) == *i);
+  // The name of a token is looked up by the token
+  CU_ASSERT(i == d.get_norm_request_header("x-forwarded-for"));
+  CU_ASSERT(std::end(d.get_request_headers()) ==
+            d.get_norm_request_header(http2::HD_TE));
+  i = d.get_norm_request_header("user-agent");
+  CU_ASSERT(std::make_pair(std::string("user-agent"),
+                           std::string("nghttp")) == *i);
+}
+
+void test_downstream_get_norm_response_header_token(void)
+{
+  Downstream d(nullptr, 0, 0);
+  d.add_response_header("Server", "nghttpx");
+  d.add_response_header("Connection", "close");
+  d.normalize_response_headers();
+  auto i = d.get_norm_response_header(http2::HD_CONNECTION);
+  CU_ASSERT(std::make_pair(std::string("connection"),
+                           std::string("close")) == *i);
+  CU_ASSERT(std::end(d.get_response_headers()) ==
+            d.get_norm_response_header(http2::HD_VIA));
+}
+
 } // namespace shrpx
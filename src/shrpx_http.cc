@@ -24,6 +24,8 @@
  */
 #include "shrpx_http.h"
 
+#include <algorithm>
+
 #include "shrpx_config.h"
 #include "shrpx_log.h"
 #include "http2.h"
@@ -94,6 +96,49 @@ std::string colorizeHeaders(const char *hdrs)
   return nhdrs;
 }
 
+namespace {
+// The number of input buffer chains examined at a time in
+// parse_evbuffer()
+const int SHRPX_HTTP_INPUT_IOVCNT = 16;
+} // namespace
+
+size_t parse_evbuffer(http_parser *htp,
+                      const http_parser_settings *settings,
+                      evbuffer *input)
+{
+  size_t nread = 0;
+  for(;;) {
+    evbuffer_iovec vec[SHRPX_HTTP_INPUT_IOVCNT];
+    // Peeking exactly the buffered length stops before the empty
+    // chain left by evbuffer_reserve_space().
+    int nvec = std::min(evbuffer_peek(input, evbuffer_get_length(input),
+                                      nullptr, vec, SHRPX_HTTP_INPUT_IOVCNT),
+                        SHRPX_HTTP_INPUT_IOVCNT);
+    size_t nproc = 0;
+    bool stopped = false;
+    for(int i = 0; i < nvec; ++i) {
+      if(vec[i].iov_len == 0) {
+        continue;
+      }
+      size_t n = http_parser_execute(htp, settings,
+                                     reinterpret_cast<const char*>
+                                     (vec[i].iov_base),
+                                     vec[i].iov_len);
+      nproc += n;
+      if(n < vec[i].iov_len || HTTP_PARSER_ERRNO(htp) != HPE_OK) {
+        stopped = true;
+        break;
+      }
+    }
+    evbuffer_drain(input, nproc);
+    nread += nproc;
+    if(stopped || nproc == 0 || evbuffer_get_length(input) == 0) {
+      break;
+    }
+  }
+  return nread;
+}
+
 } // namespace http
 
 } // namespace shrpx
@@ -29,8 +29,17 @@
 
 #include <string>
 
+#include <event2/buffer.h>
+
+#include "http-parser/http_parser.h"
+
 namespace shrpx {
 
+// Room reserved for the request or status line and the header fields
+// nghttpx adds itself (e.g., Via, X-Forwarded-For), excluding the
+// values copied from the original headers.
+#define SHRPX_HTTP1_EXTRA_HEADERS_LENGTH 256
+
 namespace http {
 
 std::string create_error_html(int status_code);
@@ -40,6 +49,16 @@ std::string create_via_header_value(int major, int minor);
 // Adds ANSI color codes to HTTP headers |hdrs|.
 std::string colorizeHeaders(const char *hdrs);
 
+// Feeds |htp| the chains of |input| one by one, so that pipelined
+// requests and large request bodies are not copied into a contiguous
+// buffer first, and drains the bytes it consumed. Empty chains are
+// skipped because http-parser takes a zero length as EOF. Stops when
+// the parser pauses (e.g., after a complete message) or fails.
+// Returns the number of bytes consumed.
+size_t parse_evbuffer(http_parser *htp,
+                      const http_parser_settings *settings,
+                      evbuffer *input);
+
 } // namespace http
 
 } // namespace shrpx
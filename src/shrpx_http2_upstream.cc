@@ -27,6 +27,7 @@
 #include <netinet/tcp.h>
 #include <assert.h>
 #include <cerrno>
+#include <algorithm>
 #include <sstream>
 
 #include "shrpx_client_handler.h"
@@ -46,6 +47,8 @@ namespace shrpx {
 
 namespace {
 const size_t SHRPX_SPDY_UPSTREAM_OUTPUT_UPPER_THRES = 64*1024;
+// The length of the frame header passed to send_data_callback
+const size_t SHRPX_HTTP2_FRAME_HEAD_LENGTH = 8;
 } // namespace
 
 namespace {
@@ -73,6 +76,34 @@ ssize_t send_callback(nghttp2_session *session,
 }
 } // namespace
 
+namespace {
+// Sends the DATA frame whose payload is left in the response body
+// buffer by spdy_data_read_callback. The payload chains are moved to
+// the output buffer by reference, so only the frame header is
+// written. This never returns NGHTTP2_ERR_WOULDBLOCK: the library
+// calls this right after spdy_data_read_callback, and on retry the
+// Downstream in |source| might have been deleted. The output buffer
+// grows past SHRPX_SPDY_UPSTREAM_OUTPUT_UPPER_THRES by at most one
+// frame.
+int send_data_callback(nghttp2_session *session, const uint8_t *framehd,
+                       size_t length, int32_t stream_id,
+                       nghttp2_data_source *source, void *user_data)
+{
+  auto upstream = reinterpret_cast<Http2Upstream*>(user_data);
+  auto downstream = reinterpret_cast<Downstream*>(source->ptr);
+  auto output = bufferevent_get_output(upstream->get_client_handler()->
+                                       get_bev());
+  auto body = downstream->get_response_body_buf();
+  if(evbuffer_add(output, framehd, SHRPX_HTTP2_FRAME_HEAD_LENGTH) != 0 ||
+     evbuffer_remove_buffer(body, output, length) !=
+     static_cast<int>(length)) {
+    ULOG(FATAL, upstream) << "Could not move response body to output buffer";
+    return NGHTTP2_ERR_CALLBACK_FAILURE;
+  }
+  return 0;
+}
+} // namespace
+
 namespace {
 ssize_t recv_callback(nghttp2_session *session,
                       uint8_t *data, size_t len, int flags, void *user_data)
@@ -264,7 +295,8 @@ int on_frame_recv_callback
     downstream->add_request_header("host", http2::value_to_str(host));
     downstream->check_upgrade_request();
 
-    auto dconn = upstream->get_client_handler()->get_downstream_connection();
+    auto handler = upstream->get_client_handler();
+    auto dconn = handler->get_downstream_connection(downstream);
     int rv = dconn->attach_downstream(downstream);
     if(rv != 0) {
       // If downstream connection fails, issue RST_STREAM.
@@ -419,6 +451,7 @@ Http2Upstream::Http2Upstream(ClientHandler *handler)
   callbacks.on_frame_recv_parse_error_callback =
     on_frame_recv_parse_error_callback;
   callbacks.on_unknown_frame_recv_callback = on_unknown_frame_recv_callback;
+  callbacks.send_data_callback = send_data_callback;
 
   int rv;
   rv = nghttp2_session_server_new(&session_, &callbacks, this);
@@ -747,7 +780,12 @@ ssize_t spdy_data_read_callback(nghttp2_session *session,
   auto downstream = reinterpret_cast<Downstream*>(source->ptr);
   auto body = downstream->get_response_body_buf();
   assert(body);
-  int nread = evbuffer_remove(body, buf, length);
+  // The payload is not copied to |buf| here; send_data_callback
+  // moves it out of |body| later.
+  int nread = std::min(evbuffer_get_length(body), length);
+  if(nread > 0) {
+    *eof |= NGHTTP2_DATA_FLAG_NO_COPY;
+  }
   if(nread == 0 &&
      downstream->get_response_state() == Downstream::MSG_COMPLETE) {
     if(!downstream->get_upgraded()) {
@@ -764,7 +802,7 @@ ssize_t spdy_data_read_callback(nghttp2_session *session,
                            (downstream->get_response_rst_stream_error_code()));
     }
   }
-  if(nread == 0 && *eof != 1) {
+  if(nread == 0 && *eof == 0) {
     return NGHTTP2_ERR_DEFERRED;
   }
   return nread;
@@ -868,7 +906,7 @@ int Http2Upstream::on_downstream_header_complete(Downstream *downstream)
 
   hdidx += http2::copy_norm_headers_to_nv(&nv[hdidx],
                                           downstream->get_response_headers());
-  auto via = downstream->get_norm_response_header("via");
+  auto via = downstream->get_norm_response_header(http2::HD_VIA);
   if(get_config()->no_via) {
     if(via != end_headers) {
       nv[hdidx++] = "via";
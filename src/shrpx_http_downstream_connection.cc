@@ -25,6 +25,8 @@
 #include "shrpx_http_downstream_connection.h"
 
 #include "shrpx_client_handler.h"
+#include "shrpx_downstream_connection_pool.h"
+#include "shrpx_downstream_balancer.h"
 #include "shrpx_upstream.h"
 #include "shrpx_downstream.h"
 #include "shrpx_config.h"
@@ -44,9 +46,14 @@ timeval max_timeout = { 86400, 0 };
 } // namespace
 
 HttpDownstreamConnection::HttpDownstreamConnection
-(ClientHandler *client_handler)
+(ClientHandler *client_handler, const sockaddr_union *addr, size_t addrlen)
   : DownstreamConnection(client_handler),
     bev_(0),
+    addr_(addr),
+    addrlen_(addrlen),
+    conn_pool_(nullptr),
+    balancer_(nullptr),
+    addr_idx_(0),
     ioctrl_(0),
     response_htp_(new http_parser())
 {}
@@ -62,36 +69,58 @@ HttpDownstreamConnection::~HttpDownstreamConnection()
   // asynchronously.
   if(downstream_) {
     downstream_->set_downstream_connection(0);
+    if(balancer_) {
+      balancer_->on_request_end(addr_idx_);
+    }
   }
 }
 
+namespace {
+// Gets called on the first event after connecting to the backend, so
+// that the balancer learns whether the backend is reachable.
+void connect_eventcb(bufferevent *bev, short events, void *arg)
+{
+  auto dconn = reinterpret_cast<HttpDownstreamConnection*>(arg);
+  auto upstream = dconn->get_downstream()->get_upstream();
+  auto eventcb = upstream->get_downstream_eventcb();
+  dconn->on_connect_event(events);
+  eventcb(bev, events, arg);
+}
+} // namespace
+
 int HttpDownstreamConnection::attach_downstream(Downstream *downstream)
 {
   if(LOG_ENABLED(INFO)) {
     DCLOG(INFO, this) << "Attaching to DOWNSTREAM:" << downstream;
   }
   Upstream *upstream = downstream->get_upstream();
+  bool connecting = false;
+  conn_pool_ = nullptr;
   if(!bev_) {
     event_base *evbase = client_handler_->get_evbase();
     bev_ = bufferevent_socket_new
       (evbase, -1,
        BEV_OPT_CLOSE_ON_FREE | BEV_OPT_DEFER_CALLBACKS);
     int rv = bufferevent_socket_connect
-      (bev_,
-       // TODO maybe not thread-safe?
-       const_cast<sockaddr*>(&get_config()->downstream_addr.sa),
-       get_config()->downstream_addrlen);
+      (bev_, const_cast<sockaddr*>(&addr_->sa), addrlen_);
     if(rv != 0) {
       bufferevent_free(bev_);
       bev_ = 0;
+      if(balancer_) {
+        balancer_->on_connect_failure(addr_idx_, time(nullptr));
+      }
       return SHRPX_ERR_NETWORK;
     }
     if(LOG_ENABLED(INFO)) {
       DCLOG(INFO, this) << "Connecting to downstream server";
     }
+    connecting = true;
   }
   downstream->set_downstream_connection(this);
   downstream_ = downstream;
+  if(balancer_) {
+    balancer_->on_request_start(addr_idx_);
+  }
 
   ioctrl_.set_bev(bev_);
 
@@ -103,7 +132,9 @@ int HttpDownstreamConnection::attach_downstream(Downstream *downstream)
   bufferevent_setcb(bev_,
                     upstream->get_downstream_readcb(),
                     upstream->get_downstream_writecb(),
-                    upstream->get_downstream_eventcb(), this);
+                    connecting && balancer_ ?
+                    connect_eventcb : upstream->get_downstream_eventcb(),
+                    this);
   // HTTP request/response model, we first issue request to downstream
   // server, so just enable write timeout here.
   bufferevent_set_timeouts(bev_,
@@ -114,20 +145,37 @@ int HttpDownstreamConnection::attach_downstream(Downstream *downstream)
 
 int HttpDownstreamConnection::push_request_headers()
 {
-  std::string hdrs = downstream_->get_request_method();
+  downstream_->normalize_request_headers();
+  auto& headers = downstream_->get_request_headers();
+  auto end_headers = std::end(headers);
+  auto xff =
+    downstream_->get_norm_request_header(http2::HD_X_FORWARDED_FOR);
+  auto expect = downstream_->get_norm_request_header(http2::HD_EXPECT);
+  auto via = downstream_->get_norm_request_header(http2::HD_VIA);
+
+  // Allocate the whole header block at once: the request line, the
+  // headers from the client, and the ones added or extended below.
+  size_t hdrslen = downstream_->get_request_method().size() +
+    downstream_->get_request_path().size() +
+    http2::count_http1_headers_length(headers) +
+    SHRPX_HTTP1_EXTRA_HEADERS_LENGTH;
+  for(auto& hd : {xff, expect, via}) {
+    if(hd != end_headers) {
+      hdrslen += (*hd).second.size();
+    }
+  }
+  std::string hdrs;
+  hdrs.reserve(hdrslen);
+  hdrs += downstream_->get_request_method();
   hdrs += " ";
   hdrs += downstream_->get_request_path();
   hdrs += " ";
   hdrs += "HTTP/1.1\r\n";
-  downstream_->normalize_request_headers();
-  auto end_headers = std::end(downstream_->get_request_headers());
-  http2::build_http1_headers_from_norm_headers
-    (hdrs, downstream_->get_request_headers());
+  http2::build_http1_headers_from_norm_headers(hdrs, headers);
 
   if(downstream_->get_request_connection_close()) {
     hdrs += "Connection: close\r\n";
   }
-  auto xff = downstream_->get_norm_request_header("x-forwarded-for");
   if(get_config()->add_x_forwarded_for) {
     hdrs += "X-Forwarded-For: ";
     if(xff != end_headers) {
@@ -150,14 +198,12 @@ int HttpDownstreamConnection::push_request_headers()
     }
     hdrs += "\r\n";
   }
-  auto expect = downstream_->get_norm_request_header("expect");
   if(expect != end_headers &&
      !util::strifind((*expect).second.c_str(), "100-continue")) {
     hdrs += "Expect: ";
     hdrs += (*expect).second;
     hdrs += "\r\n";
   }
-  auto via = downstream_->get_norm_request_header("via");
   if(get_config()->no_via) {
     if(via != end_headers) {
       hdrs += "Via: ";
@@ -256,7 +302,8 @@ int HttpDownstreamConnection::end_upload_data()
 }
 
 namespace {
-// Gets called when DownstreamConnection is pooled in ClientHandler.
+// Gets called when DownstreamConnection is pooled in
+// DownstreamConnectionPool.
 void idle_eventcb(bufferevent *bev, short events, void *arg)
 {
   HttpDownstreamConnection *dconn;
@@ -282,8 +329,7 @@ void idle_eventcb(bufferevent *bev, short events, void *arg)
       DCLOG(INFO, dconn) << "Idle connection network error";
     }
   }
-  ClientHandler *client_handler = dconn->get_client_handler();
-  client_handler->remove_downstream_connection(dconn);
+  dconn->get_pool()->remove_downstream_connection(dconn);
   delete dconn;
 }
 } // namespace
@@ -295,6 +341,9 @@ void HttpDownstreamConnection::detach_downstream(Downstream *downstream)
   }
   downstream->set_downstream_connection(0);
   downstream_ = 0;
+  if(balancer_) {
+    balancer_->on_request_end(addr_idx_);
+  }
   ioctrl_.force_resume_read();
   bufferevent_enable(bev_, EV_READ);
   bufferevent_setcb(bev_, 0, 0, idle_eventcb, this);
@@ -303,7 +352,14 @@ void HttpDownstreamConnection::detach_downstream(Downstream *downstream)
   bufferevent_set_timeouts(bev_,
                            &get_config()->downstream_idle_read_timeout,
                            &get_config()->downstream_write_timeout);
-  client_handler_->pool_downstream_connection(this);
+  // Pool this connection in the worker, so that other clients can
+  // reuse it.
+  conn_pool_ = client_handler_->get_http_dconn_pool();
+  client_handler_ = nullptr;
+  if(LOG_ENABLED(INFO)) {
+    DCLOG(INFO, this) << "Pooling downstream connection";
+  }
+  conn_pool_->add_downstream_connection(this);
 }
 
 bufferevent* HttpDownstreamConnection::get_bev()
@@ -311,6 +367,42 @@ bufferevent* HttpDownstreamConnection::get_bev()
   return bev_;
 }
 
+const sockaddr_union* HttpDownstreamConnection::get_addr() const
+{
+  return addr_;
+}
+
+size_t HttpDownstreamConnection::get_addrlen() const
+{
+  return addrlen_;
+}
+
+DownstreamConnectionPool* HttpDownstreamConnection::get_pool() const
+{
+  return conn_pool_;
+}
+
+void HttpDownstreamConnection::set_balancer(DownstreamBalancer *balancer,
+                                            size_t addr_idx)
+{
+  balancer_ = balancer;
+  addr_idx_ = addr_idx;
+}
+
+void HttpDownstreamConnection::on_connect_event(short events)
+{
+  auto upstream = downstream_->get_upstream();
+  bufferevent_setcb(bev_,
+                    upstream->get_downstream_readcb(),
+                    upstream->get_downstream_writecb(),
+                    upstream->get_downstream_eventcb(), this);
+  if(events & BEV_EVENT_CONNECTED) {
+    balancer_->on_connect_success(addr_idx_);
+  } else {
+    balancer_->on_connect_failure(addr_idx_, time(nullptr));
+  }
+}
+
 void HttpDownstreamConnection::pause_read(IOCtrlReason reason)
 {
   ioctrl_.pause_read(reason);
@@ -34,12 +34,19 @@
 
 #include "shrpx_downstream_connection.h"
 #include "shrpx_io_control.h"
+#include "shrpx_config.h"
 
 namespace shrpx {
 
+class DownstreamConnectionPool;
+class DownstreamBalancer;
+
 class HttpDownstreamConnection : public DownstreamConnection {
 public:
-  HttpDownstreamConnection(ClientHandler *client_handler);
+  // The connection is made to the backend |addr| of length
+  // |addrlen|. |addr| must outlive this object.
+  HttpDownstreamConnection(ClientHandler *client_handler,
+                           const sockaddr_union *addr, size_t addrlen);
   virtual ~HttpDownstreamConnection();
   virtual int attach_downstream(Downstream *downstream);
   virtual void detach_downstream(Downstream *downstream);
@@ -60,8 +67,22 @@ public:
   virtual void on_upstream_change(Upstream *upstream);
 
   bufferevent* get_bev();
+  const sockaddr_union* get_addr() const;
+  size_t get_addrlen() const;
+  DownstreamConnectionPool* get_pool() const;
+  // Reports the requests and the connection result of this object to
+  // |balancer| as the backend |addr_idx|.
+  void set_balancer(DownstreamBalancer *balancer, size_t addr_idx);
+  // Called on the first event after connecting to the backend
+  void on_connect_event(short events);
 private:
   bufferevent *bev_;
+  const sockaddr_union *addr_;
+  size_t addrlen_;
+  // The pool this object is idle in. NULL if it is not idle.
+  DownstreamConnectionPool *conn_pool_;
+  DownstreamBalancer *balancer_;
+  size_t addr_idx_;
   IOControl ioctrl_;
   http_parser *response_htp_;
 };
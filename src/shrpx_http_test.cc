@@ -0,0 +1,129 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2012 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "shrpx_http_test.h"
+
+#include <cstring>
+#include <string>
+
+#include <CUnit/CUnit.h>
+
+#include "shrpx_http.h"
+
+namespace shrpx {
+
+namespace {
+struct ParseResult {
+  std::string url;
+  std::string headers;
+  bool complete;
+};
+} // namespace
+
+namespace {
+int urlcb(http_parser *htp, const char *data, size_t len)
+{
+  reinterpret_cast<ParseResult*>(htp->data)->url.append(data, len);
+  return 0;
+}
+} // namespace
+
+namespace {
+int hdrcb(http_parser *htp, const char *data, size_t len)
+{
+  reinterpret_cast<ParseResult*>(htp->data)->headers.append(data, len);
+  return 0;
+}
+} // namespace
+
+namespace {
+int msg_completecb(http_parser *htp)
+{
+  reinterpret_cast<ParseResult*>(htp->data)->complete = true;
+  http_parser_pause(htp, 1);
+  return 0;
+}
+} // namespace
+
+void test_http_parse_evbuffer(void)
+{
+  http_parser_settings settings;
+  memset(&settings, 0, sizeof(settings));
+  settings.on_url = urlcb;
+  settings.on_header_field = hdrcb;
+  settings.on_header_value = hdrcb;
+  settings.on_message_complete = msg_completecb;
+
+  ParseResult res{"", "", false};
+  http_parser htp;
+  http_parser_init(&htp, HTTP_REQUEST);
+  htp.data = &res;
+
+  auto input = evbuffer_new();
+  // A chain which cannot be appended to, so that the request spans
+  // several chains.
+  const char p1[] = "GET /alpha HTTP/1.1\r\nHo";
+  evbuffer_add_reference(input, p1, sizeof(p1) - 1, nullptr, nullptr);
+  const char p2[] = "st: exam";
+  evbuffer_add(input, p2, sizeof(p2) - 1);
+  // Reserve 2 vectors and commit only the first one, as
+  // bufferevent_openssl does, which leaves an empty chain at the end
+  // while the request is still incomplete.
+  const char p3[] = "ple.org\r\n";
+  evbuffer_iovec vec[2];
+  CU_ASSERT(2 == evbuffer_reserve_space(input, 8192, vec, 2));
+  memcpy(vec[0].iov_base, p3, sizeof(p3) - 1);
+  vec[0].iov_len = sizeof(p3) - 1;
+  evbuffer_commit_space(input, vec, 1);
+
+  auto nread = http::parse_evbuffer(&htp, &settings, input);
+  CU_ASSERT(HPE_OK == HTTP_PARSER_ERRNO(&htp));
+  CU_ASSERT(!res.complete);
+  CU_ASSERT(sizeof(p1) - 1 + sizeof(p2) - 1 + sizeof(p3) - 1 == nread);
+  CU_ASSERT(0 == evbuffer_get_length(input));
+
+  // The end of the request and a pipelined one
+  const char p4[] = "\r\nGET /bravo HTTP/1.1\r\n\r\n";
+  evbuffer_add(input, p4, sizeof(p4) - 1);
+  nread = http::parse_evbuffer(&htp, &settings, input);
+  CU_ASSERT(HPE_PAUSED == HTTP_PARSER_ERRNO(&htp));
+  CU_ASSERT(res.complete);
+  CU_ASSERT("/alpha" == res.url);
+  CU_ASSERT("Hostexample.org" == res.headers);
+  CU_ASSERT(2 == nread);
+  CU_ASSERT(sizeof(p4) - 1 - 2 == evbuffer_get_length(input));
+
+  res.url.clear();
+  res.complete = false;
+  http_parser_pause(&htp, 0);
+  http::parse_evbuffer(&htp, &settings, input);
+  CU_ASSERT(HPE_PAUSED == HTTP_PARSER_ERRNO(&htp));
+  CU_ASSERT(res.complete);
+  CU_ASSERT("/bravo" == res.url);
+  CU_ASSERT(0 == evbuffer_get_length(input));
+
+  evbuffer_free(input);
+}
+
+} // namespace shrpx
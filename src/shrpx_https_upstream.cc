@@ -25,6 +25,7 @@
 #include "shrpx_https_upstream.h"
 
 #include <cassert>
+#include <algorithm>
 #include <set>
 #include <sstream>
 
@@ -46,6 +47,8 @@ namespace shrpx {
 namespace {
 const size_t SHRPX_HTTPS_UPSTREAM_OUTPUT_UPPER_THRES = 64*1024;
 const size_t SHRPX_HTTPS_MAX_HEADER_LENGTH = 64*1024;
+// The number of input buffer chains examined at a time in on_read()
+const int SHRPX_HTTPS_INPUT_IOVCNT = 16;
 } // namespace
 
 HttpsUpstream::HttpsUpstream(ClientHandler *handler)
@@ -174,7 +177,8 @@ int htp_hdrs_completecb(http_parser *htp)
   }
 
   DownstreamConnection *dconn;
-  dconn = upstream->get_client_handler()->get_downstream_connection();
+  auto handler = upstream->get_client_handler();
+  dconn = handler->get_downstream_connection(downstream);
 
   if(downstream->get_expect_100_continue()) {
     static const char reply_100[] = "HTTP/1.1 100 Continue\r\n\r\n";
@@ -260,19 +264,40 @@ int HttpsUpstream::on_read()
 {
   bufferevent *bev = handler_->get_bev();
   evbuffer *input = bufferevent_get_input(bev);
-  size_t inputlen = evbuffer_get_length(input);
-  unsigned char *mem = evbuffer_pullup(input, -1);
 
-  if(inputlen == 0) {
+  if(evbuffer_get_length(input) == 0) {
     return 0;
   }
   auto downstream = get_downstream();
   // downstream can be nullptr here, because it is initialized in the
   // callback chain called by http_parser_execute()
   if(downstream && downstream->get_upgraded()) {
-    int rv = downstream->push_upload_data_chunk
-      (reinterpret_cast<const uint8_t*>(mem), inputlen);
-    evbuffer_drain(input, inputlen);
+    // Forward the chains of the input buffer as they are, without
+    // linearizing them first. Peeking exactly the buffered length
+    // stops before the empty chain left by evbuffer_reserve_space().
+    int rv = 0;
+    while(rv == 0 && evbuffer_get_length(input) > 0) {
+      evbuffer_iovec vec[SHRPX_HTTPS_INPUT_IOVCNT];
+      int nvec = std::min(evbuffer_peek(input, evbuffer_get_length(input),
+                                        nullptr, vec,
+                                        SHRPX_HTTPS_INPUT_IOVCNT),
+                          SHRPX_HTTPS_INPUT_IOVCNT);
+      size_t nproc = 0;
+      for(int i = 0; i < nvec && rv == 0; ++i) {
+        if(vec[i].iov_len == 0) {
+          continue;
+        }
+        rv = downstream->push_upload_data_chunk
+          (reinterpret_cast<const uint8_t*>(vec[i].iov_base),
+           vec[i].iov_len);
+        nproc += vec[i].iov_len;
+      }
+      if(nproc == 0) {
+        break;
+      }
+      evbuffer_drain(input, nproc);
+    }
+    evbuffer_drain(input, evbuffer_get_length(input));
     if(rv != 0) {
       return -1;
     }
@@ -285,10 +310,7 @@ int HttpsUpstream::on_read()
     return 0;
   }
 
-  size_t nread = http_parser_execute(htp_, &htp_hooks,
-                                     reinterpret_cast<const char*>(mem),
-                                     inputlen);
-  evbuffer_drain(input, nread);
+  size_t nread = http::parse_evbuffer(htp_, &htp_hooks, input);
   // Well, actually header length + some body bytes
   current_header_length_ += nread;
   // Get downstream again because it may be initialized in http parser
@@ -655,17 +677,28 @@ int HttpsUpstream::on_downstream_header_complete(Downstream *downstream)
   if(LOG_ENABLED(INFO)) {
     DLOG(INFO, downstream) << "HTTP response header completed";
   }
+  downstream->normalize_response_headers();
+  auto& headers = downstream->get_response_headers();
+  auto end_headers = std::end(headers);
+  auto via = downstream->get_norm_response_header(http2::HD_VIA);
+
+  // Allocate the whole header block at once: the status line, the
+  // headers from the backend, and the ones added or extended below.
+  size_t hdrslen = http2::count_http1_headers_length(headers) +
+    SHRPX_HTTP1_EXTRA_HEADERS_LENGTH;
+  if(via != end_headers) {
+    hdrslen += (*via).second.size();
+  }
+  std::string hdrs;
+  hdrs.reserve(hdrslen);
   char temp[16];
   snprintf(temp, sizeof(temp), "HTTP/%d.%d ",
            downstream->get_request_major(),
            downstream->get_request_minor());
-  std::string hdrs = temp;
+  hdrs += temp;
   hdrs += http2::get_status_string(downstream->get_response_http_status());
   hdrs += "\r\n";
-  downstream->normalize_response_headers();
-  auto end_headers = std::end(downstream->get_response_headers());
-  http2::build_http1_headers_from_norm_headers
-    (hdrs, downstream->get_response_headers());
+  http2::build_http1_headers_from_norm_headers(hdrs, headers);
 
   // We check downstream->get_response_connection_close() in case when
   // the Content-Length is not available.
@@ -679,7 +712,6 @@ int HttpsUpstream::on_downstream_header_complete(Downstream *downstream)
   } else {
     hdrs += "Connection: close\r\n";
   }
-  auto via = downstream->get_norm_response_header("via");
   if(get_config()->no_via) {
     if(via != end_headers) {
       hdrs += "Via: ";
@@ -35,9 +35,12 @@
 #include "shrpx_client_handler.h"
 #include "shrpx_thread_event_receiver.h"
 #include "shrpx_ssl.h"
+#include "shrpx_session_cache.h"
 #include "shrpx_worker.h"
 #include "shrpx_config.h"
-#include "shrpx_spdy_session.h"
+#include "shrpx_spdy_session_pool.h"
+#include "shrpx_downstream_connection_pool.h"
+#include "shrpx_downstream_balancer.h"
 
 namespace shrpx {
 
@@ -49,26 +52,103 @@ ListenHandler::ListenHandler(event_base *evbase, SSL_CTX *sv_ssl_ctx,
     worker_round_robin_cnt_(0),
     workers_(nullptr),
     num_worker_(0),
-    spdy_(nullptr)
+    flush_event_(nullptr),
+    flush_scheduled_(false),
+    spdy_pool_(nullptr),
+    http_dconn_pool_(new DownstreamConnectionPool
+                     (get_config()->downstream_max_idle_connections,
+                      nullptr)),
+    balancer_(new DownstreamBalancer
+              (get_config()->num_downstream_addrs,
+               get_config()->downstream_balance_method,
+               get_config()->downstream_eject_period)),
+    tls_session_cache_(new BackendSessionCache
+                       (get_config()->num_downstream_addrs, nullptr))
 {}
 
 ListenHandler::~ListenHandler()
-{}
+{
+  if(flush_event_) {
+    event_free(flush_event_);
+  }
+  delete http_dconn_pool_;
+  delete balancer_;
+  delete tls_session_cache_;
+}
+
+namespace {
+void flushcb(evutil_socket_t fd, short events, void *arg)
+{
+  auto handler = reinterpret_cast<ListenHandler*>(arg);
+  handler->flush_pending_events();
+}
+} // namespace
+
+namespace {
+void close_listen_fds(WorkerInfo *info)
+{
+  for(size_t i = 0; i < 2; ++i) {
+    if(info->listen_fds[i] != -1) {
+      close(info->listen_fds[i]);
+    }
+  }
+}
+} // namespace
 
-void ListenHandler::create_worker_thread(size_t num)
+namespace {
+void worker_eventcb(bufferevent *bev, short events, void *arg)
+{
+  auto handler = reinterpret_cast<ListenHandler*>(arg);
+  if(events & (BEV_EVENT_EOF | BEV_EVENT_ERROR)) {
+    LLOG(ERROR, handler) << "Connection to worker thread lost";
+    bufferevent_disable(bev, EV_READ);
+  }
+}
+} // namespace
+
+void ListenHandler::create_worker_ssl_ctx(size_t num)
+{
+  // Give each worker its own SSL_CTX, so that the handshakes in
+  // different workers do not contend on the locks of a shared one.
+  // The sessions are still shared through the session cache and the
+  // ticket keys.
+  for(size_t i = 0; i < num; ++i) {
+    auto sv_ssl_ctx = sv_ssl_ctx_ ?
+      ssl::create_ssl_context(get_config()->private_key_file,
+                              get_config()->cert_file) : nullptr;
+    auto cl_ssl_ctx = cl_ssl_ctx_ ? ssl::create_ssl_client_context() :
+      nullptr;
+    worker_ssl_ctxs_.push_back(std::make_pair(sv_ssl_ctx, cl_ssl_ctx));
+  }
+}
+
+void ListenHandler::create_worker_thread
+(size_t num, const std::vector<evutil_socket_t>& listen_fds)
 {
   workers_ = new WorkerInfo[num];
   num_worker_ = 0;
+  flush_event_ = event_new(evbase_, -1, 0, flushcb, this);
   for(size_t i = 0; i < num; ++i) {
     int rv;
     auto info = &workers_[num_worker_];
+    for(size_t j = 0; j < 2; ++j) {
+      info->listen_fds[j] = listen_fds.empty() ? -1 : listen_fds[i * 2 + j];
+    }
     rv = socketpair(AF_UNIX, SOCK_STREAM, 0, info->sv);
     if(rv == -1) {
       LLOG(ERROR, this) << "socketpair() failed: errno=" << errno;
+      close_listen_fds(info);
       continue;
     }
-    info->sv_ssl_ctx = sv_ssl_ctx_;
-    info->cl_ssl_ctx = cl_ssl_ctx_;
+    // Fall back to the shared SSL_CTXs if create_worker_ssl_ctx()
+    // was not called.
+    if(i < worker_ssl_ctxs_.size()) {
+      info->sv_ssl_ctx = worker_ssl_ctxs_[i].first;
+      info->cl_ssl_ctx = worker_ssl_ctxs_[i].second;
+    } else {
+      info->sv_ssl_ctx = sv_ssl_ctx_;
+      info->cl_ssl_ctx = cl_ssl_ctx_;
+    }
     try {
       auto thread = std::thread{start_threaded_worker, info};
       thread.detach();
@@ -78,11 +158,20 @@ void ListenHandler::create_worker_thread(size_t num)
       for(size_t j = 0; j < 2; ++j) {
         close(info->sv[j]);
       }
+      close_listen_fds(info);
       continue;
     }
     auto bev = bufferevent_socket_new(evbase_, info->sv[0],
                                       BEV_OPT_DEFER_CALLBACKS);
     info->bev = bev;
+    if(!listen_fds.empty()) {
+      // The main thread has no listener in this case. Watch the
+      // channel so that the event loop in the main thread keeps
+      // running while the worker is alive.
+      bufferevent_setcb(bev, nullptr, nullptr, worker_eventcb, this);
+      bufferevent_enable(bev, EV_READ);
+    }
+    worker_stats_.push_back(&info->stat);
     if(LOG_ENABLED(INFO)) {
       LLOG(INFO, this) << "Created thread #" << num_worker_;
     }
@@ -99,35 +188,129 @@ int ListenHandler::accept_connection(evutil_socket_t fd,
   if(num_worker_ == 0) {
     auto client = ssl::accept_connection(evbase_, sv_ssl_ctx_,
                                          fd, addr, addrlen);
-    client->set_spdy_session(spdy_);
+    client->set_spdy_session_pool(spdy_pool_);
+    client->set_http_dconn_pool(http_dconn_pool_);
+    client->set_downstream_balancer(balancer_);
   } else {
-    size_t idx = worker_round_robin_cnt_ % num_worker_;
+    // Start the scan at the next worker in round-robin order so that
+    // equally loaded workers take turns.
+    size_t idx = select_least_loaded_worker(worker_stats_.data(),
+                                            num_worker_,
+                                            worker_round_robin_cnt_);
     ++worker_round_robin_cnt_;
+    if(LOG_ENABLED(INFO)) {
+      LLOG(INFO, this) << "Dispatch connection to worker #" << idx
+                       << ", load=" << worker_load(worker_stats_[idx]);
+    }
     WorkerEvent wev;
     memset(&wev, 0, sizeof(wev));
     wev.client_fd = fd;
     memcpy(&wev.client_addr, addr, addrlen);
     wev.client_addrlen = addrlen;
-    auto output = bufferevent_get_output(workers_[idx].bev);
-    if(evbuffer_add(output, &wev, sizeof(wev)) != 0) {
-      LLOG(FATAL, this) << "evbuffer_add() failed";
-      return -1;
+    // evconnlistener calls us for each connection while it drains the
+    // backlog. Queue the connection here and hand the whole batch to
+    // each worker in one write after the listener callback returns.
+    workers_[idx].pending_events.push_back(wev);
+    // The worker decrements this when the connection is closed.
+    worker_stats_[idx]->num_connections.fetch_add
+      (1, std::memory_order_relaxed);
+    if(!flush_scheduled_) {
+      flush_scheduled_ = true;
+      event_active(flush_event_, 0, 0);
     }
   }
   return 0;
 }
 
+void ListenHandler::flush_pending_events()
+{
+  flush_scheduled_ = false;
+  for(size_t i = 0; i < num_worker_; ++i) {
+    auto& events = workers_[i].pending_events;
+    if(events.empty()) {
+      continue;
+    }
+    if(LOG_ENABLED(INFO)) {
+      LLOG(INFO, this) << "Hand " << events.size()
+                       << " connection(s) to worker #" << i;
+    }
+    auto output = bufferevent_get_output(workers_[i].bev);
+    if(evbuffer_add(output, events.data(),
+                    events.size() * sizeof(WorkerEvent)) != 0) {
+      LLOG(FATAL, this) << "evbuffer_add() failed";
+      for(auto& wev : events) {
+        close(wev.client_fd);
+      }
+      workers_[i].stat.num_connections.fetch_sub
+        (events.size(), std::memory_order_relaxed);
+    }
+    events.clear();
+  }
+}
+
 event_base* ListenHandler::get_evbase() const
 {
   return evbase_;
 }
 
-int ListenHandler::create_spdy_session()
+void ListenHandler::log_worker_stats()
+{
+  for(size_t i = 0; i < num_worker_; ++i) {
+    auto stat = worker_stats_[i];
+    LLOG(WARNING, this)
+      << "Worker #" << i
+      << ": connections="
+      << stat->num_connections.load(std::memory_order_relaxed)
+      << ", downstreams="
+      << stat->num_downstreams.load(std::memory_order_relaxed)
+      << ", pending_write_bytes="
+      << stat->pending_write_bytes.load(std::memory_order_relaxed)
+      << ", backend_pool_hits="
+      << stat->backend_pool_hits.load(std::memory_order_relaxed)
+      << ", backend_pool_misses="
+      << stat->backend_pool_misses.load(std::memory_order_relaxed)
+      << ", backend_tls_resumed="
+      << stat->backend_tls_resumed.load(std::memory_order_relaxed)
+      << ", backend_tls_full="
+      << stat->backend_tls_full.load(std::memory_order_relaxed)
+      << ", load=" << worker_load(stat);
+  }
+  if(num_worker_ == 0 && cl_ssl_ctx_) {
+    LLOG(WARNING, this) << "Backend TLS handshakes: resumed="
+                        << tls_session_cache_->get_num_resumed()
+                        << ", full=" << tls_session_cache_->get_num_full();
+  }
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+  // Newer OpenSSL does its own locking, and the counters never move.
+  if(sv_ssl_ctx_ || cl_ssl_ctx_) {
+    auto ls = ssl::get_lock_stat();
+    LLOG(WARNING, this) << "OpenSSL locks: acquired=" << ls.num_acquired
+                        << ", contended=" << ls.num_contended;
+  }
+#endif // OPENSSL_VERSION_NUMBER < 0x10100000L
+  if(sv_ssl_ctx_) {
+    auto hs = ssl::get_handshake_stat();
+    LLOG(WARNING, this) << "TLS handshakes: full=" << hs.num_full
+                        << ", resumed=" << hs.num_resumed
+                        << ", ticket_key_misses="
+                        << hs.num_ticket_key_misses;
+    auto cache = ssl::get_session_cache();
+    if(cache) {
+      LLOG(WARNING, this) << "TLS session cache: hits="
+                          << cache->get_num_hits()
+                          << " (memcached="
+                          << cache->get_num_remote_hits()
+                          << "), misses=" << cache->get_num_misses();
+    }
+  }
+}
+
+int ListenHandler::create_spdy_session_pool()
 {
-  int rv;
-  spdy_ = new SpdySession(evbase_, cl_ssl_ctx_);
-  rv = spdy_->init_notification();
-  return rv;
+  spdy_pool_ = new SpdySessionPool(evbase_, cl_ssl_ctx_, balancer_,
+                                   tls_session_cache_,
+                                   get_config()->downstream_spdy_max_sessions);
+  return spdy_pool_->init();
 }
 
 } // namespace shrpx
@@ -30,29 +30,61 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 
+#include <vector>
+#include <utility>
+
 #include <openssl/ssl.h>
 
 #include <event.h>
 
+#include "shrpx_worker_stat.h"
+#include "shrpx_thread_event_receiver.h"
+
 namespace shrpx {
 
 struct WorkerInfo {
   int sv[2];
+  // Listening sockets, IPv6 and IPv4 in this order, from which the
+  // worker accepts connections by itself. -1 if not used.
+  evutil_socket_t listen_fds[2];
   SSL_CTX *sv_ssl_ctx;
   SSL_CTX *cl_ssl_ctx;
   bufferevent *bev;
+  // Load counters published by the worker
+  WorkerStat stat;
+  // Connections dispatched to the worker in the current event loop
+  // iteration, not yet written to the channel.
+  std::vector<WorkerEvent> pending_events;
 };
 
-class SpdySession;
+class SpdySessionPool;
+class DownstreamConnectionPool;
+class DownstreamBalancer;
+class BackendSessionCache;
 
 class ListenHandler {
 public:
   ListenHandler(event_base *evbase, SSL_CTX *sv_ssl_ctx, SSL_CTX *cl_ssl_ctx);
   ~ListenHandler();
   int accept_connection(evutil_socket_t fd, sockaddr *addr, int addrlen);
-  void create_worker_thread(size_t num);
+  // Creates the SSL_CTXs for |num| workers. This reads the private
+  // key and certificate again, so it must be called before the root
+  // privileges are dropped.
+  void create_worker_ssl_ctx(size_t num);
+  // Starts |num| worker threads. If |listen_fds| is not empty, it
+  // contains 2 listening sockets (IPv6 and IPv4) for each worker, and
+  // the worker accepts connections from them instead of receiving
+  // them from the main thread.
+  void create_worker_thread(size_t num,
+                            const std::vector<evutil_socket_t>& listen_fds);
   event_base* get_evbase() const;
-  int create_spdy_session();
+  int create_spdy_session_pool();
+  // Writes the load counters of each worker and the TLS handshake
+  // counters to the log.
+  void log_worker_stats();
+  // Writes the connections queued by accept_connection() to each
+  // worker's channel, one write for each worker.
+  void flush_pending_events();
 private:
   event_base *evbase_;
   // The frontend server SSL_CTX
@@ -61,10 +93,26 @@ private:
   SSL_CTX *cl_ssl_ctx_;
   unsigned int worker_round_robin_cnt_;
   WorkerInfo *workers_;
+  // Pointers to the stat of each started worker, indexed by worker
+  std::vector<WorkerStat*> worker_stats_;
+  // The frontend and backend SSL_CTXs created for each worker by
+  // create_worker_ssl_ctx(), indexed by worker.
+  std::vector<std::pair<SSL_CTX*, SSL_CTX*>> worker_ssl_ctxs_;
   size_t num_worker_;
-  // Shared backend SPDY session. NULL if multi-threaded. In
+  // Event to call flush_pending_events() once the listener finishes
+  // draining the accept backlog.
+  event *flush_event_;
+  bool flush_scheduled_;
+  // Shared backend SPDY sessions. NULL if multi-threaded. In
+  // multi-threaded case, see shrpx_worker.cc.
+  SpdySessionPool *spdy_pool_;
+  // Idle HTTP/1.1 backend connections if single-threaded. In
   // multi-threaded case, see shrpx_worker.cc.
-  SpdySession *spdy_;
+  DownstreamConnectionPool *http_dconn_pool_;
+  // Chooses backends if single-threaded
+  DownstreamBalancer *balancer_;
+  // TLS sessions with the backends if single-threaded
+  BackendSessionCache *tls_session_cache_;
 };
 
 } // namespace shrpx
@@ -0,0 +1,624 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "shrpx_session_cache.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#include "shrpx_log.h"
+#include "shrpx_worker_stat.h"
+#include "util.h"
+
+using namespace nghttp2;
+
+namespace shrpx {
+
+namespace {
+// Seconds to wait before connecting again to the memcached server
+// which could not be reached.
+const time_t MEMCACHED_RETRY_INTERVAL = 5;
+} // namespace
+
+MemcachedClient::MemcachedClient(const sockaddr_union *addr, size_t addrlen,
+                                 const timeval& timeout)
+  : addrlen_(addrlen),
+    timeout_(timeout),
+    fd_(-1),
+    retry_time_(0)
+{
+  memcpy(&addr_, addr, addrlen);
+}
+
+MemcachedClient::~MemcachedClient()
+{
+  disconnect();
+}
+
+int MemcachedClient::connect_server()
+{
+  if(fd_ != -1) {
+    return 0;
+  }
+  auto now = time(nullptr);
+  if(now < retry_time_) {
+    return -1;
+  }
+  fd_ = socket(addr_.storage.ss_family, SOCK_STREAM, 0);
+  if(fd_ == -1) {
+    fail();
+    return -1;
+  }
+  // Blocking socket with timeouts. The requests are small and the
+  // server is supposed to be near.
+  if(setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout_,
+                sizeof(timeout_)) == -1 ||
+     setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &timeout_,
+                sizeof(timeout_)) == -1 ||
+     connect(fd_, &addr_.sa, addrlen_) == -1) {
+    LOG(WARNING) << "Could not connect to memcached server: errno="
+                 << errno;
+    fail();
+    return -1;
+  }
+  int val = 1;
+  setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+  return 0;
+}
+
+void MemcachedClient::disconnect()
+{
+  if(fd_ != -1) {
+    close(fd_);
+    fd_ = -1;
+  }
+  rbuf_.clear();
+}
+
+void MemcachedClient::fail()
+{
+  disconnect();
+  retry_time_ = time(nullptr) + MEMCACHED_RETRY_INTERVAL;
+}
+
+int MemcachedClient::write_all(const std::string& data)
+{
+  size_t off = 0;
+  while(off < data.size()) {
+    auto n = write(fd_, data.c_str() + off, data.size() - off);
+    if(n == -1) {
+      if(errno == EINTR) {
+        continue;
+      }
+      fail();
+      return -1;
+    }
+    off += n;
+  }
+  return 0;
+}
+
+int MemcachedClient::read_line(std::string& line)
+{
+  for(;;) {
+    auto pos = rbuf_.find("\r\n");
+    if(pos != std::string::npos) {
+      line.assign(rbuf_, 0, pos);
+      rbuf_.erase(0, pos + 2);
+      return 0;
+    }
+    char buf[4096];
+    auto n = read(fd_, buf, sizeof(buf));
+    if(n == -1 && errno == EINTR) {
+      continue;
+    }
+    if(n <= 0) {
+      fail();
+      return -1;
+    }
+    rbuf_.append(buf, n);
+  }
+}
+
+int MemcachedClient::read_bytes(std::string& out, size_t len)
+{
+  while(rbuf_.size() < len) {
+    char buf[4096];
+    auto n = read(fd_, buf, sizeof(buf));
+    if(n == -1 && errno == EINTR) {
+      continue;
+    }
+    if(n <= 0) {
+      fail();
+      return -1;
+    }
+    rbuf_.append(buf, n);
+  }
+  out.assign(rbuf_, 0, len);
+  rbuf_.erase(0, len);
+  return 0;
+}
+
+int MemcachedClient::set(const std::string& key, const std::string& value,
+                         time_t exptime)
+{
+  if(connect_server() != 0) {
+    return -1;
+  }
+  std::string req = "set ";
+  req += key;
+  req += " 0 ";
+  req += util::utos(exptime);
+  req += " ";
+  req += util::utos(value.size());
+  req += " noreply\r\n";
+  req += value;
+  req += "\r\n";
+  return write_all(req);
+}
+
+int MemcachedClient::get(const std::string& key, std::string& value)
+{
+  if(connect_server() != 0) {
+    return -1;
+  }
+  std::string req = "get ";
+  req += key;
+  req += "\r\n";
+  if(write_all(req) != 0) {
+    return -1;
+  }
+  std::string line;
+  if(read_line(line) != 0) {
+    return -1;
+  }
+  if(line == "END") {
+    return -1;
+  }
+  // VALUE <key> <flags> <bytes>
+  if(!util::startsWith(line, "VALUE ")) {
+    LOG(WARNING) << "Unexpected response from memcached server: " << line;
+    fail();
+    return -1;
+  }
+  auto sp = line.rfind(' ');
+  auto len = strtoul(line.c_str() + sp + 1, nullptr, 10);
+  std::string data;
+  if(read_bytes(data, len + 2) != 0 || read_line(line) != 0) {
+    return -1;
+  }
+  if(line != "END") {
+    fail();
+    return -1;
+  }
+  data.resize(len);
+  value.swap(data);
+  return 0;
+}
+
+int MemcachedClient::del(const std::string& key)
+{
+  if(connect_server() != 0) {
+    return -1;
+  }
+  std::string req = "delete ";
+  req += key;
+  req += " noreply\r\n";
+  return write_all(req);
+}
+
+namespace {
+// Timeout of each memcached request. The handshake is stalled while
+// waiting, so keep it short.
+const timeval MEMCACHED_TIMEOUT = { 0, 100000 };
+} // namespace
+
+namespace {
+std::atomic<uint64_t> session_cache_serial(0);
+} // namespace
+
+SessionCache::SessionCache(size_t num_shards, size_t max_entries,
+                           const sockaddr_union *memcached_addr,
+                           size_t memcached_addrlen)
+  : serial_(++session_cache_serial),
+    shards_(new Shard[num_shards]),
+    num_shards_(num_shards),
+    max_entries_per_shard_(std::max(max_entries / num_shards,
+                                    static_cast<size_t>(1))),
+    memcached_addrlen_(memcached_addr ? memcached_addrlen : 0),
+    num_hits_(0),
+    num_remote_hits_(0),
+    num_misses_(0)
+{
+  if(memcached_addr) {
+    memcpy(&memcached_addr_, memcached_addr, memcached_addrlen);
+  }
+}
+
+namespace {
+std::string memcached_key(const std::string& id)
+{
+  return "nghttpx:tls-session:" +
+    util::format_hex(reinterpret_cast<const unsigned char*>(id.c_str()),
+                     id.size());
+}
+} // namespace
+
+size_t SessionCache::get_shard_index(const unsigned char *id,
+                                     size_t idlen) const
+{
+  // Session IDs are random, so a few bytes are enough to spread them.
+  uint32_t h = 0;
+  for(size_t i = 0; i < idlen && i < 4; ++i) {
+    h = (h << 8) | id[i];
+  }
+  return h % num_shards_;
+}
+
+MemcachedClient* SessionCache::get_memcached_client()
+{
+  // Each thread talks to the server over its own connection.
+  static thread_local std::unique_ptr<MemcachedClient> client;
+  static thread_local uint64_t owner = 0;
+  if(memcached_addrlen_ == 0) {
+    return nullptr;
+  }
+  if(owner != serial_) {
+    client.reset(new MemcachedClient(&memcached_addr_, memcached_addrlen_,
+                                     MEMCACHED_TIMEOUT));
+    owner = serial_;
+  }
+  return client.get();
+}
+
+void SessionCache::store_local(const std::string& key, const std::string& der,
+                               time_t expiry)
+{
+  auto& shard = shards_[get_shard_index
+                        (reinterpret_cast<const unsigned char*>(key.c_str()),
+                         key.size())];
+  std::lock_guard<std::mutex> g(shard.mutex);
+  auto i = shard.entries.find(key);
+  if(i != shard.entries.end()) {
+    shard.lru.erase((*i).second.lru_pos);
+    shard.entries.erase(i);
+  }
+  while(shard.entries.size() >= max_entries_per_shard_) {
+    shard.entries.erase(shard.lru.back());
+    shard.lru.pop_back();
+  }
+  shard.lru.push_front(key);
+  auto& ent = shard.entries[key];
+  ent.der = der;
+  ent.expiry = expiry;
+  ent.lru_pos = shard.lru.begin();
+}
+
+bool SessionCache::lookup_local(const std::string& key, std::string& der,
+                                time_t now)
+{
+  auto& shard = shards_[get_shard_index
+                        (reinterpret_cast<const unsigned char*>(key.c_str()),
+                         key.size())];
+  std::lock_guard<std::mutex> g(shard.mutex);
+  auto i = shard.entries.find(key);
+  if(i == shard.entries.end()) {
+    return false;
+  }
+  auto& ent = (*i).second;
+  if(ent.expiry <= now) {
+    shard.lru.erase(ent.lru_pos);
+    shard.entries.erase(i);
+    return false;
+  }
+  shard.lru.splice(shard.lru.begin(), shard.lru, ent.lru_pos);
+  der = ent.der;
+  return true;
+}
+
+void SessionCache::store(const unsigned char *id, size_t idlen,
+                         const std::string& der, time_t expiry)
+{
+  std::string key(reinterpret_cast<const char*>(id), idlen);
+  store_local(key, der, expiry);
+  auto mc = get_memcached_client();
+  if(mc) {
+    auto ttl = expiry - time(nullptr);
+    if(ttl > 0) {
+      mc->set(memcached_key(key), der, ttl);
+    }
+  }
+}
+
+bool SessionCache::lookup(const unsigned char *id, size_t idlen,
+                          std::string& der)
+{
+  std::string key(reinterpret_cast<const char*>(id), idlen);
+  auto now = time(nullptr);
+  if(lookup_local(key, der, now)) {
+    num_hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  auto mc = get_memcached_client();
+  if(mc && mc->get(memcached_key(key), der) == 0) {
+    // The server expires the entry. Keep the local copy for the
+    // default session timeout at most; OpenSSL checks the real
+    // expiry of the session anyway.
+    store_local(key, der, now + 300);
+    num_hits_.fetch_add(1, std::memory_order_relaxed);
+    num_remote_hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  num_misses_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void SessionCache::remove(const unsigned char *id, size_t idlen)
+{
+  std::string key(reinterpret_cast<const char*>(id), idlen);
+  {
+    auto& shard = shards_[get_shard_index(id, idlen)];
+    std::lock_guard<std::mutex> g(shard.mutex);
+    auto i = shard.entries.find(key);
+    if(i != shard.entries.end()) {
+      shard.lru.erase((*i).second.lru_pos);
+      shard.entries.erase(i);
+    }
+  }
+  auto mc = get_memcached_client();
+  if(mc) {
+    mc->del(memcached_key(key));
+  }
+}
+
+size_t SessionCache::get_num_shards() const
+{
+  return num_shards_;
+}
+
+uint64_t SessionCache::get_num_hits() const
+{
+  return num_hits_.load(std::memory_order_relaxed);
+}
+
+uint64_t SessionCache::get_num_remote_hits() const
+{
+  return num_remote_hits_.load(std::memory_order_relaxed);
+}
+
+uint64_t SessionCache::get_num_misses() const
+{
+  return num_misses_.load(std::memory_order_relaxed);
+}
+
+BackendSessionCache::BackendSessionCache(size_t num_addrs, WorkerStat *stat)
+  : sessions_(num_addrs, nullptr),
+    num_resumed_(0),
+    num_full_(0),
+    stat_(stat)
+{}
+
+BackendSessionCache::~BackendSessionCache()
+{
+  for(auto session : sessions_) {
+    if(session) {
+      SSL_SESSION_free(session);
+    }
+  }
+}
+
+SSL_SESSION* BackendSessionCache::get_session(size_t idx)
+{
+  auto session = sessions_[idx];
+  if(!session) {
+    return nullptr;
+  }
+  if(SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session) <=
+     time(nullptr)) {
+    remove_session(idx);
+    return nullptr;
+  }
+  return session;
+}
+
+void BackendSessionCache::set_session(size_t idx, SSL_SESSION *session)
+{
+  if(sessions_[idx]) {
+    SSL_SESSION_free(sessions_[idx]);
+  }
+  sessions_[idx] = session;
+}
+
+void BackendSessionCache::remove_session(size_t idx)
+{
+  set_session(idx, nullptr);
+}
+
+void BackendSessionCache::count_handshake(bool resumed)
+{
+  if(resumed) {
+    ++num_resumed_;
+    if(stat_) {
+      stat_->backend_tls_resumed.fetch_add(1, std::memory_order_relaxed);
+    }
+  } else {
+    ++num_full_;
+    if(stat_) {
+      stat_->backend_tls_full.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+uint64_t BackendSessionCache::get_num_resumed() const
+{
+  return num_resumed_;
+}
+
+uint64_t BackendSessionCache::get_num_full() const
+{
+  return num_full_;
+}
+
+namespace ssl {
+
+namespace {
+// ex_data indices of SSL to find the BackendSessionCache and the
+// backend index from new_backend_session_cb().
+int backend_cache_index = -1;
+int backend_addr_index = -1;
+} // namespace
+
+namespace {
+int new_backend_session_cb(SSL *ssl, SSL_SESSION *session)
+{
+  auto cache = reinterpret_cast<BackendSessionCache*>
+    (SSL_get_ex_data(ssl, backend_cache_index));
+  if(!cache) {
+    return 0;
+  }
+  auto idx = reinterpret_cast<uintptr_t>
+    (SSL_get_ex_data(ssl, backend_addr_index));
+  // Returning 1 hands the reference of |session| to us.
+  cache->set_session(idx, session);
+  return 1;
+}
+} // namespace
+
+void setup_backend_session_cache(SSL_CTX *ssl_ctx)
+{
+  if(backend_cache_index == -1) {
+    backend_cache_index = SSL_get_ex_new_index(0, nullptr, nullptr,
+                                               nullptr, nullptr);
+    backend_addr_index = SSL_get_ex_new_index(0, nullptr, nullptr,
+                                              nullptr, nullptr);
+  }
+  // OpenSSL does not look up client sessions by itself. Only let it
+  // tell us about the new ones, including the tickets received after
+  // the handshake.
+  SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_CLIENT |
+                                 SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ssl_ctx, new_backend_session_cb);
+}
+
+void attach_backend_session_cache(SSL *ssl, BackendSessionCache *cache,
+                                  size_t idx)
+{
+  SSL_set_ex_data(ssl, backend_cache_index, cache);
+  SSL_set_ex_data(ssl, backend_addr_index, reinterpret_cast<void*>(idx));
+  auto session = cache->get_session(idx);
+  if(session) {
+    SSL_set_session(ssl, session);
+  }
+}
+
+namespace {
+SessionCache *session_cache = nullptr;
+} // namespace
+
+void create_session_cache(size_t num_shards, size_t max_entries,
+                          const sockaddr_union *memcached_addr,
+                          size_t memcached_addrlen)
+{
+  session_cache = new SessionCache(num_shards, max_entries,
+                                   memcached_addr, memcached_addrlen);
+}
+
+SessionCache* get_session_cache()
+{
+  return session_cache;
+}
+
+namespace {
+int new_session_cb(SSL *ssl, SSL_SESSION *session)
+{
+  if(!session_cache) {
+    return 0;
+  }
+  int len = i2d_SSL_SESSION(session, nullptr);
+  if(len <= 0) {
+    return 0;
+  }
+  std::string der(len, '\0');
+  auto p = reinterpret_cast<unsigned char*>(&der[0]);
+  i2d_SSL_SESSION(session, &p);
+  unsigned int idlen;
+  auto id = SSL_SESSION_get_id(session, &idlen);
+  auto expiry = SSL_SESSION_get_time(session) +
+    SSL_SESSION_get_timeout(session);
+  session_cache->store(id, idlen, der, expiry);
+  // We do not keep the reference to |session|.
+  return 0;
+}
+} // namespace
+
+namespace {
+SSL_SESSION* get_session_cb(SSL *ssl, const unsigned char *id, int idlen,
+                            int *copy)
+{
+  *copy = 0;
+  if(!session_cache) {
+    return nullptr;
+  }
+  std::string der;
+  if(!session_cache->lookup(id, idlen, der)) {
+    return nullptr;
+  }
+  auto p = reinterpret_cast<const unsigned char*>(der.c_str());
+  return d2i_SSL_SESSION(nullptr, &p, der.size());
+}
+} // namespace
+
+namespace {
+void remove_session_cb(SSL_CTX *ssl_ctx, SSL_SESSION *session)
+{
+  if(!session_cache) {
+    return;
+  }
+  unsigned int idlen;
+  auto id = SSL_SESSION_get_id(session, &idlen);
+  session_cache->remove(id, idlen);
+}
+} // namespace
+
+void setup_session_cache(SSL_CTX *ssl_ctx)
+{
+  // Bypass OpenSSL's internal cache, which all threads share under a
+  // global lock.
+  SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_SERVER |
+                                 SSL_SESS_CACHE_NO_INTERNAL);
+  SSL_CTX_sess_set_new_cb(ssl_ctx, new_session_cb);
+  SSL_CTX_sess_set_get_cb(ssl_ctx, get_session_cb);
+  SSL_CTX_sess_set_remove_cb(ssl_ctx, remove_session_cb);
+}
+
+} // namespace ssl
+
+} // namespace shrpx
@@ -0,0 +1,211 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef SHRPX_SESSION_CACHE_H
+#define SHRPX_SESSION_CACHE_H
+
+#include "shrpx.h"
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include <ctime>
+#include <string>
+#include <list>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <openssl/ssl.h>
+
+#include "shrpx_config.h"
+
+namespace shrpx {
+
+// A client of the memcached text protocol, used as the out-of-process
+// store of TLS sessions. The calls block for at most |timeout|, so
+// the server is expected to be close (e.g., on the same host). If
+// the server cannot be reached, the client does not try again for a
+// few seconds. This object is not thread-safe.
+class MemcachedClient {
+public:
+  MemcachedClient(const sockaddr_union *addr, size_t addrlen,
+                  const timeval& timeout);
+  ~MemcachedClient();
+  // Stores |value| under |key| for |exptime| seconds. The reply is
+  // not waited for. Returns 0 if the request is sent, or -1.
+  int set(const std::string& key, const std::string& value, time_t exptime);
+  // Fetches the value of |key| into |value|. Returns 0 if it is
+  // found, or -1.
+  int get(const std::string& key, std::string& value);
+  // Deletes |key|. The reply is not waited for.
+  int del(const std::string& key);
+private:
+  int connect_server();
+  void disconnect();
+  // Closes the connection after an error, and does not connect again
+  // for MEMCACHED_RETRY_INTERVAL seconds, so that a dead or stalled
+  // server does not delay every handshake by the timeout.
+  void fail();
+  int write_all(const std::string& data);
+  // Reads a line terminated by CRLF into |line| without CRLF.
+  int read_line(std::string& line);
+  int read_bytes(std::string& out, size_t len);
+  sockaddr_union addr_;
+  size_t addrlen_;
+  timeval timeout_;
+  // Bytes read from the server but not consumed yet
+  std::string rbuf_;
+  int fd_;
+  // Do not try to connect until this time after a failure.
+  time_t retry_time_;
+};
+
+// The server side TLS session cache, which replaces OpenSSL's
+// internal one. The sessions are kept in |num_shards| shards chosen
+// by the session ID, each one with its own lock and LRU list, so
+// that worker threads rarely contend. If the memcached server is
+// configured, the sessions are also written there and looked up
+// there if they are not found locally, so that they are shared
+// among instances and survive restarts.
+class SessionCache {
+public:
+  // At most |max_entries| sessions are kept in total.
+  // |memcached_addr| may be NULL.
+  SessionCache(size_t num_shards, size_t max_entries,
+               const sockaddr_union *memcached_addr,
+               size_t memcached_addrlen);
+  // Stores the serialized session |der| with |id| until |expiry|.
+  void store(const unsigned char *id, size_t idlen,
+             const std::string& der, time_t expiry);
+  // Looks up the session with |id| and stores it in |der|. Returns
+  // true if it is found and not expired.
+  bool lookup(const unsigned char *id, size_t idlen, std::string& der);
+  void remove(const unsigned char *id, size_t idlen);
+  size_t get_num_shards() const;
+  // The index of the shard which keeps the session with |id|.
+  size_t get_shard_index(const unsigned char *id, size_t idlen) const;
+  uint64_t get_num_hits() const;
+  // The number of hits in the memcached server, which are also
+  // counted in get_num_hits().
+  uint64_t get_num_remote_hits() const;
+  uint64_t get_num_misses() const;
+private:
+  struct Entry {
+    std::string der;
+    time_t expiry;
+    // Position in Shard::lru
+    std::list<std::string>::iterator lru_pos;
+  };
+  struct Shard {
+    std::mutex mutex;
+    std::map<std::string, Entry> entries;
+    // Session IDs, the most recently used first
+    std::list<std::string> lru;
+  };
+  void store_local(const std::string& key, const std::string& der,
+                   time_t expiry);
+  bool lookup_local(const std::string& key, std::string& der, time_t now);
+  MemcachedClient* get_memcached_client();
+  // Distinguishes this object from the ones created before, so that
+  // the per-thread memcached connection is not reused by mistake.
+  uint64_t serial_;
+  std::unique_ptr<Shard[]> shards_;
+  size_t num_shards_;
+  size_t max_entries_per_shard_;
+  sockaddr_union memcached_addr_;
+  size_t memcached_addrlen_;
+  std::atomic<uint64_t> num_hits_;
+  std::atomic<uint64_t> num_remote_hits_;
+  std::atomic<uint64_t> num_misses_;
+};
+
+struct WorkerStat;
+
+// The last TLS session established with each backend, offered when
+// connecting to the same backend again so that the handshake is
+// abbreviated. The backends are identified by their index in
+// Config::downstream_addrs. This object is not thread-safe; each
+// event loop has its own.
+class BackendSessionCache {
+public:
+  // If |stat| is not NULL, the handshake counters are also published
+  // to it.
+  BackendSessionCache(size_t num_addrs, WorkerStat *stat);
+  // Frees all sessions.
+  ~BackendSessionCache();
+  // Returns the session for the backend |idx|, or NULL if there is
+  // none or it has expired. The returned session is still owned by
+  // this object.
+  SSL_SESSION* get_session(size_t idx);
+  // Replaces the session for the backend |idx| with |session|, taking
+  // over its reference.
+  void set_session(size_t idx, SSL_SESSION *session);
+  // Forgets the session for the backend |idx|, e.g., because the
+  // handshake offering it failed.
+  void remove_session(size_t idx);
+  // Counts a completed handshake, which resumed a session if
+  // |resumed| is true.
+  void count_handshake(bool resumed);
+  uint64_t get_num_resumed() const;
+  uint64_t get_num_full() const;
+private:
+  std::vector<SSL_SESSION*> sessions_;
+  uint64_t num_resumed_;
+  uint64_t num_full_;
+  WorkerStat *stat_;
+};
+
+namespace ssl {
+
+// Makes the client |ssl_ctx| store each new session in the
+// BackendSessionCache attached to its SSL object.
+void setup_backend_session_cache(SSL_CTX *ssl_ctx);
+
+// Offers the session cached in |cache| for the backend |idx| on
+// |ssl|, and arranges that the session established on |ssl| replaces
+// it. This must be called before the handshake starts.
+void attach_backend_session_cache(SSL *ssl, BackendSessionCache *cache,
+                                  size_t idx);
+
+// Installs the callbacks which keep the sessions of |ssl_ctx| in
+// the session cache created by create_session_cache().
+void setup_session_cache(SSL_CTX *ssl_ctx);
+
+// Creates the session cache used by all threads. This must be
+// called before any connection is accepted.
+void create_session_cache(size_t num_shards, size_t max_entries,
+                          const sockaddr_union *memcached_addr,
+                          size_t memcached_addrlen);
+
+// Returns the session cache, or NULL if it has not been created.
+SessionCache* get_session_cache();
+
+} // namespace ssl
+
+} // namespace shrpx
+
+#endif // SHRPX_SESSION_CACHE_H
@@ -0,0 +1,313 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "shrpx_session_cache_test.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <map>
+#include <string>
+
+#include <CUnit/CUnit.h>
+
+#include "shrpx_session_cache.h"
+#include "shrpx_worker_stat.h"
+
+namespace shrpx {
+
+void test_session_cache_store_lookup(void)
+{
+  // 2 sessions per shard
+  SessionCache cache(2, 4, nullptr, 0);
+  auto now = time(nullptr);
+  std::string der;
+  const unsigned char id1[] = "\x00\x00\x00\x00" "a";
+  const unsigned char id2[] = "\x00\x00\x00\x02" "b";
+  const unsigned char id3[] = "\x00\x00\x00\x04" "c";
+  const unsigned char id4[] = "\x00\x00\x00\x01" "d";
+
+  CU_ASSERT(0 == cache.get_shard_index(id1, 5));
+  CU_ASSERT(0 == cache.get_shard_index(id2, 5));
+  CU_ASSERT(0 == cache.get_shard_index(id3, 5));
+  CU_ASSERT(1 == cache.get_shard_index(id4, 5));
+
+  CU_ASSERT(!cache.lookup(id1, 5, der));
+  CU_ASSERT(1 == cache.get_num_misses());
+
+  cache.store(id1, 5, "session1", now + 300);
+  cache.store(id2, 5, "session2", now + 300);
+  cache.store(id4, 5, "session4", now + 300);
+  CU_ASSERT(cache.lookup(id1, 5, der));
+  CU_ASSERT("session1" == der);
+  CU_ASSERT(1 == cache.get_num_hits());
+
+  // The shard 0 is full. id2 is the least recently used one.
+  cache.store(id3, 5, "session3", now + 300);
+  CU_ASSERT(!cache.lookup(id2, 5, der));
+  CU_ASSERT(cache.lookup(id1, 5, der));
+  CU_ASSERT(cache.lookup(id3, 5, der));
+  CU_ASSERT("session3" == der);
+  // The other shard is not affected.
+  CU_ASSERT(cache.lookup(id4, 5, der));
+  CU_ASSERT("session4" == der);
+
+  // Expired session
+  cache.store(id4, 5, "session4", now - 1);
+  CU_ASSERT(!cache.lookup(id4, 5, der));
+
+  cache.remove(id1, 5);
+  CU_ASSERT(!cache.lookup(id1, 5, der));
+  CU_ASSERT(0 == cache.get_num_remote_hits());
+}
+
+namespace {
+// Serves set, get and delete of the memcached text protocol for
+// |fd| using |store|.
+void serve_memcached_connection(int fd,
+                                std::map<std::string, std::string>& store)
+{
+  std::string buf;
+  for(;;) {
+    auto eol = buf.find("\r\n");
+    if(eol == std::string::npos) {
+      char b[4096];
+      auto n = read(fd, b, sizeof(b));
+      if(n <= 0) {
+        break;
+      }
+      buf.append(b, n);
+      continue;
+    }
+    std::string line(buf, 0, eol);
+    char cmd[16], key[256];
+    unsigned int flags;
+    unsigned long exptime, len;
+    if(sscanf(line.c_str(), "set %255s %u %lu %lu", key, &flags, &exptime,
+              &len) == 4) {
+      if(buf.size() < eol + 2 + len + 2) {
+        char b[4096];
+        auto n = read(fd, b, sizeof(b));
+        if(n <= 0) {
+          break;
+        }
+        buf.append(b, n);
+        continue;
+      }
+      store[key] = buf.substr(eol + 2, len);
+      buf.erase(0, eol + 2 + len + 2);
+      continue;
+    }
+    buf.erase(0, eol + 2);
+    if(sscanf(line.c_str(), "%15s %255s", cmd, key) != 2) {
+      break;
+    }
+    std::string res;
+    if(strcmp(cmd, "get") == 0) {
+      auto i = store.find(key);
+      if(i != store.end()) {
+        res += "VALUE ";
+        res += key;
+        res += " 0 ";
+        res += std::to_string((*i).second.size());
+        res += "\r\n";
+        res += (*i).second;
+        res += "\r\n";
+      }
+      res += "END\r\n";
+    } else if(strcmp(cmd, "delete") == 0) {
+      store.erase(key);
+    }
+    if(!res.empty() && write(fd, res.c_str(), res.size()) == -1) {
+      break;
+    }
+  }
+}
+} // namespace
+
+namespace {
+// Accepts connections from |lfd| one at a time until |lfd| is shut
+// down. The connection being served is stored in |conn_fd|.
+void run_memcached_server(int lfd, std::atomic<int> *conn_fd)
+{
+  std::map<std::string, std::string> store;
+  for(;;) {
+    int fd = accept(lfd, nullptr, nullptr);
+    if(fd == -1) {
+      break;
+    }
+    conn_fd->store(fd);
+    serve_memcached_connection(fd, store);
+    conn_fd->store(-1);
+    close(fd);
+  }
+}
+} // namespace
+
+void test_session_cache_memcached(void)
+{
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  CU_ASSERT_FATAL(lfd != -1);
+  sockaddr_union addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.in.sin_family = AF_INET;
+  addr.in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addrlen = sizeof(addr.in);
+  CU_ASSERT_FATAL(bind(lfd, &addr.sa, addrlen) == 0);
+  CU_ASSERT_FATAL(listen(lfd, 1) == 0);
+  CU_ASSERT_FATAL(getsockname(lfd, &addr.sa, &addrlen) == 0);
+  std::atomic<int> conn_fd(-1);
+  std::thread server(run_memcached_server, lfd, &conn_fd);
+
+  auto now = time(nullptr);
+  std::string der;
+  const unsigned char id[] = "\x01\x02\x03\x04\x05\x06\x07\x08";
+  {
+    // One instance stores the session...
+    SessionCache cache(1, 16, &addr, addrlen);
+    cache.store(id, 8, std::string("session\0\r\n", 10), now + 300);
+    CU_ASSERT(cache.lookup(id, 8, der));
+    CU_ASSERT(0 == cache.get_num_remote_hits());
+  }
+  {
+    // ...and another one finds it in the memcached server.
+    SessionCache cache(1, 16, &addr, addrlen);
+    CU_ASSERT(cache.lookup(id, 8, der));
+    CU_ASSERT(std::string("session\0\r\n", 10) == der);
+    CU_ASSERT(1 == cache.get_num_remote_hits());
+    // It is cached locally after that.
+    CU_ASSERT(cache.lookup(id, 8, der));
+    CU_ASSERT(1 == cache.get_num_remote_hits());
+
+    cache.remove(id, 8);
+  }
+  {
+    SessionCache cache(1, 16, &addr, addrlen);
+    CU_ASSERT(!cache.lookup(id, 8, der));
+    CU_ASSERT(1 == cache.get_num_misses());
+  }
+  // Each SessionCache above replaced the connection of this thread
+  // with its own one. The last one is still open.
+  shutdown(lfd, SHUT_RDWR);
+  int fd = conn_fd.load();
+  if(fd != -1) {
+    shutdown(fd, SHUT_RDWR);
+  }
+  server.join();
+  close(lfd);
+}
+
+void test_session_cache_memcached_backoff(void)
+{
+  // The server never accepts nor answers. The kernel completes the
+  // connection, so the request times out while reading the reply.
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  CU_ASSERT_FATAL(lfd != -1);
+  sockaddr_union addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.in.sin_family = AF_INET;
+  addr.in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addrlen = sizeof(addr.in);
+  CU_ASSERT_FATAL(bind(lfd, &addr.sa, addrlen) == 0);
+  CU_ASSERT_FATAL(listen(lfd, 4) == 0);
+  CU_ASSERT_FATAL(getsockname(lfd, &addr.sa, &addrlen) == 0);
+
+  timeval timeout = { 0, 100000 };
+  MemcachedClient client(&addr, addrlen, timeout);
+  std::string value;
+
+  auto t = std::chrono::steady_clock::now();
+  CU_ASSERT(-1 == client.get("key", value));
+  auto elapsed = std::chrono::steady_clock::now() - t;
+  CU_ASSERT(elapsed >= std::chrono::milliseconds(90));
+
+  // The timeout puts the client in the backoff. It fails at once and
+  // does not connect again.
+  t = std::chrono::steady_clock::now();
+  CU_ASSERT(-1 == client.get("key", value));
+  CU_ASSERT(-1 == client.set("key", "value", 300));
+  CU_ASSERT(-1 == client.del("key"));
+  elapsed = std::chrono::steady_clock::now() - t;
+  CU_ASSERT(elapsed < std::chrono::milliseconds(20));
+
+  // Only the connection of the first request is in the backlog.
+  fcntl(lfd, F_SETFL, fcntl(lfd, F_GETFL) | O_NONBLOCK);
+  int num_conns = 0;
+  for(int fd; (fd = accept(lfd, nullptr, nullptr)) != -1;) {
+    ++num_conns;
+    close(fd);
+  }
+  CU_ASSERT(1 == num_conns);
+  close(lfd);
+}
+
+void test_session_cache_backend(void)
+{
+  WorkerStat stat;
+  BackendSessionCache cache(2, &stat);
+  CU_ASSERT(nullptr == cache.get_session(0));
+
+  auto now = time(nullptr);
+  auto a = SSL_SESSION_new();
+  SSL_SESSION_set_time(a, now);
+  SSL_SESSION_set_timeout(a, 300);
+  cache.set_session(0, a);
+  CU_ASSERT(a == cache.get_session(0));
+  CU_ASSERT(nullptr == cache.get_session(1));
+
+  // The new session replaces the old one.
+  auto b = SSL_SESSION_new();
+  SSL_SESSION_set_time(b, now);
+  SSL_SESSION_set_timeout(b, 300);
+  cache.set_session(0, b);
+  CU_ASSERT(b == cache.get_session(0));
+  cache.remove_session(0);
+  CU_ASSERT(nullptr == cache.get_session(0));
+
+  // Expired session is not offered.
+  auto c = SSL_SESSION_new();
+  SSL_SESSION_set_time(c, now - 600);
+  SSL_SESSION_set_timeout(c, 300);
+  cache.set_session(1, c);
+  CU_ASSERT(nullptr == cache.get_session(1));
+
+  cache.count_handshake(false);
+  cache.count_handshake(true);
+  cache.count_handshake(true);
+  CU_ASSERT(2 == cache.get_num_resumed());
+  CU_ASSERT(1 == cache.get_num_full());
+  CU_ASSERT(2 == stat.backend_tls_resumed);
+  CU_ASSERT(1 == stat.backend_tls_full);
+}
+
+} // namespace shrpx
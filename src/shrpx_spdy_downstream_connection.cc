@@ -39,6 +39,7 @@
 #include "shrpx_error.h"
 #include "shrpx_http.h"
 #include "shrpx_spdy_session.h"
+#include "shrpx_spdy_session_pool.h"
 #include "http2.h"
 #include "util.h"
 
@@ -49,7 +50,7 @@ namespace shrpx {
 SpdyDownstreamConnection::SpdyDownstreamConnection
 (ClientHandler *client_handler)
   : DownstreamConnection(client_handler),
-    spdy_(client_handler->get_spdy_session()),
+    spdy_(nullptr),
     request_body_buf_(0),
     sd_(0),
     recv_window_size_(0)
@@ -68,7 +69,9 @@ SpdyDownstreamConnection::~SpdyDownstreamConnection()
       spdy_->notify();
     }
   }
-  spdy_->remove_downstream_connection(this);
+  if(spdy_) {
+    spdy_->remove_downstream_connection(this);
+  }
   // Downstream and DownstreamConnection may be deleted
   // asynchronously.
   if(downstream_) {
@@ -106,6 +109,10 @@ int SpdyDownstreamConnection::attach_downstream(Downstream *downstream)
   if(init_request_body_buf() == -1) {
     return -1;
   }
+  spdy_ = client_handler_->get_spdy_session_pool()->get_session();
+  if(!spdy_) {
+    return -1;
+  }
   spdy_->add_downstream_connection(this);
   if(spdy_->get_state() == SpdySession::DISCONNECTED) {
     spdy_->notify();
@@ -124,6 +131,9 @@ void SpdyDownstreamConnection::detach_downstream(Downstream *downstream)
   if(submit_rst_stream(downstream) == 0) {
     spdy_->notify();
   }
+  // The next Downstream may be assigned to another session.
+  spdy_->remove_downstream_connection(this);
+  spdy_ = nullptr;
   downstream->set_downstream_connection(0);
   downstream_ = 0;
 
@@ -286,7 +296,7 @@ int SpdyDownstreamConnection::push_request_headers()
   hdidx += http2::copy_norm_headers_to_nv(&nv[hdidx],
                                           downstream_->get_request_headers());
 
-  auto host = downstream_->get_norm_request_header("host");
+  auto host = downstream_->get_norm_request_header(http2::HD_HOST);
   if(host == end_headers) {
     if(LOG_ENABLED(INFO)) {
       DCLOG(INFO, this) << "host header field missing";
@@ -297,11 +307,12 @@ int SpdyDownstreamConnection::push_request_headers()
   nv[hdidx++] = (*host).second.c_str();
 
   bool content_length = false;
-  if(downstream_->get_norm_request_header("content-length") != end_headers) {
+  if(downstream_->get_norm_request_header(http2::HD_CONTENT_LENGTH) !=
+     end_headers) {
     content_length = true;
   }
 
-  auto expect = downstream_->get_norm_request_header("expect");
+  auto expect = downstream_->get_norm_request_header(http2::HD_EXPECT);
   if(expect != end_headers &&
      !util::strifind((*expect).second.c_str(), "100-continue")) {
     nv[hdidx++] = "expect";
@@ -310,13 +321,14 @@ int SpdyDownstreamConnection::push_request_headers()
 
   bool chunked_encoding = false;
   auto transfer_encoding =
-    downstream_->get_norm_request_header("transfer-encoding");
+    downstream_->get_norm_request_header(http2::HD_TRANSFER_ENCODING);
   if(transfer_encoding != end_headers &&
      util::strieq((*transfer_encoding).second.c_str(), "chunked")) {
     chunked_encoding = true;
   }
 
-  auto xff = downstream_->get_norm_request_header("x-forwarded-for");
+  auto xff =
+    downstream_->get_norm_request_header(http2::HD_X_FORWARDED_FOR);
   if(get_config()->add_x_forwarded_for) {
     nv[hdidx++] = "x-forwarded-for";
     if(xff != end_headers) {
@@ -331,7 +343,7 @@ int SpdyDownstreamConnection::push_request_headers()
     nv[hdidx++] = (*xff).second.c_str();
   }
 
-  auto via = downstream_->get_norm_request_header("via");
+  auto via = downstream_->get_norm_request_header(http2::HD_VIA);
   if(get_config()->no_via) {
     if(via != end_headers) {
       nv[hdidx++] = "via";
@@ -409,7 +421,7 @@ int SpdyDownstreamConnection::end_upload_data()
 int SpdyDownstreamConnection::resume_read(IOCtrlReason reason)
 {
   int rv;
-  if(spdy_->get_state() == SpdySession::CONNECTED &&
+  if(spdy_ && spdy_->get_state() == SpdySession::CONNECTED &&
      spdy_->get_flow_control() &&
      downstream_ && downstream_->get_downstream_stream_id() != -1 &&
      recv_window_size_ >= spdy_->get_initial_window_size()/2) {
@@ -73,6 +73,8 @@ public:
   int32_t get_recv_window_size() const;
   void inc_recv_window_size(int32_t amount);
 private:
+  // The session of the attached Downstream, chosen from the pool in
+  // attach_downstream(). NULL while detached.
   SpdySession *spdy_;
   evbuffer *request_body_buf_;
   StreamData *sd_;
@@ -43,12 +43,16 @@
 #include "http2.h"
 #include "util.h"
 #include "base64.h"
+#include "shrpx_downstream_balancer.h"
+#include "shrpx_session_cache.h"
 
 using namespace nghttp2;
 
 namespace shrpx {
 
-SpdySession::SpdySession(event_base *evbase, SSL_CTX *ssl_ctx)
+SpdySession::SpdySession(event_base *evbase, SSL_CTX *ssl_ctx,
+                         DownstreamBalancer *balancer,
+                         BackendSessionCache *tls_session_cache)
   : evbase_(evbase),
     ssl_ctx_(ssl_ctx),
     ssl_(nullptr),
@@ -60,7 +64,12 @@ SpdySession::SpdySession(event_base *evbase, SSL_CTX *ssl_ctx)
     wrbev_(nullptr),
     rdbev_(nullptr),
     flow_control_(false),
-    proxy_htp_(0)
+    proxy_htp_(0),
+    balancer_(balancer),
+    tls_session_cache_(tls_session_cache),
+    addr_idx_(0),
+    addr_(&get_config()->downstream_addrs[0]),
+    max_concurrent_streams_(NGHTTP2_INITIAL_MAX_CONCURRENT_STREAMS)
 {}
 
 SpdySession::~SpdySession()
@@ -115,6 +124,7 @@ int SpdySession::disconnect()
 
   notified_ = false;
   state_ = DISCONNECTED;
+  max_concurrent_streams_ = NGHTTP2_INITIAL_MAX_CONCURRENT_STREAMS;
 
   // Delete all client handler associated to Downstream. When deleting
   // SpdyDownstreamConnection, it calls this object's
@@ -250,6 +260,7 @@ void eventcb(bufferevent *bev, short events, void *ptr)
       SSLOG(INFO, spdy) << "Connection established";
     }
     spdy->set_state(SpdySession::CONNECTED);
+    spdy->report_connect_result(true);
     if((!get_config()->downstream_no_tls &&
         !get_config()->insecure && spdy->check_cert() != 0) ||
        spdy->on_connect() != 0) {
@@ -276,6 +287,9 @@ void eventcb(bufferevent *bev, short events, void *ptr)
         SSLOG(INFO, spdy) << "Timeout";
       }
     }
+    if(spdy->get_state() == SpdySession::CONNECTING) {
+      spdy->report_connect_result(false);
+    }
     spdy->disconnect();
   }
 }
@@ -297,6 +311,8 @@ void proxy_readcb(bufferevent *bev, void *ptr)
       }
       break;
     case SpdySession::PROXY_FAILED:
+      // The proxy could not reach the backend.
+      spdy->report_connect_result(false);
       spdy->disconnect();
       break;
     }
@@ -315,9 +331,9 @@ void proxy_eventcb(bufferevent *bev, short events, void *ptr)
       SSLOG(INFO, spdy) << "Connected to the proxy";
     }
     std::string req = "CONNECT ";
-    req += get_config()->downstream_hostport;
+    req += spdy->get_addr()->hostport;
     req += " HTTP/1.1\r\nHost: ";
-    req += get_config()->downstream_host;
+    req += spdy->get_addr()->host;
     req += "\r\n";
     if(get_config()->downstream_http_proxy_userinfo) {
       req += "Proxy-Authorization: Basic ";
@@ -354,12 +370,20 @@ void proxy_eventcb(bufferevent *bev, short events, void *ptr)
 
 int SpdySession::check_cert()
 {
-  return ssl::check_cert(ssl_);
+  return ssl::check_cert(ssl_, addr_);
 }
 
 int SpdySession::initiate_connection()
 {
   int rv = 0;
+  if(state_ == DISCONNECTED) {
+    addr_idx_ = balancer_->select_addr(static_cast<const std::string*>
+                                       (nullptr), time(nullptr));
+    addr_ = &get_config()->downstream_addrs[addr_idx_];
+    if(LOG_ENABLED(INFO)) {
+      SSLOG(INFO, this) << "Using backend " << addr_->hostport;
+    }
+  }
   if(get_config()->downstream_http_proxy_host && state_ == DISCONNECTED) {
     if(LOG_ENABLED(INFO)) {
       SSLOG(INFO, this) << "Connecting to the proxy "
@@ -409,7 +433,7 @@ int SpdySession::initiate_connection()
         sni_name = get_config()->backend_tls_sni_name;
       }
       else {
-        sni_name = get_config()->downstream_host;
+        sni_name = addr_->host;
       }
 
       if(!ssl::numeric_host(sni_name)) {
@@ -418,23 +442,19 @@ int SpdySession::initiate_connection()
         // at the time of this writing).
         SSL_set_tlsext_host_name(ssl_, sni_name);
       }
+      ssl::attach_backend_session_cache(ssl_, tls_session_cache_, addr_idx_);
       // If state_ == PROXY_CONNECTED, we has connected to the proxy
       // using fd_ and tunnel has been established.
       bev_ = bufferevent_openssl_socket_new(evbase_, fd_, ssl_,
                                             BUFFEREVENT_SSL_CONNECTING,
                                             BEV_OPT_DEFER_CALLBACKS);
       rv = bufferevent_socket_connect
-        (bev_,
-         // TODO maybe not thread-safe?
-         const_cast<sockaddr*>(&get_config()->downstream_addr.sa),
-         get_config()->downstream_addrlen);
+        (bev_, const_cast<sockaddr*>(&addr_->addr.sa), addr_->addrlen);
     } else if(state_ == DISCONNECTED) {
       // Without TLS and proxy.
       bev_ = bufferevent_socket_new(evbase_, -1, BEV_OPT_DEFER_CALLBACKS);
       rv = bufferevent_socket_connect
-        (bev_,
-         const_cast<sockaddr*>(&get_config()->downstream_addr.sa),
-         get_config()->downstream_addrlen);
+        (bev_, const_cast<sockaddr*>(&addr_->addr.sa), addr_->addrlen);
     } else {
       assert(state_ == PROXY_CONNECTED);
       // Without TLS but with proxy.
@@ -450,6 +470,7 @@ int SpdySession::initiate_connection()
     if(rv != 0) {
       bufferevent_free(bev_);
       bev_ = 0;
+      report_connect_result(false);
       return SHRPX_ERR_NETWORK;
     }
 
@@ -879,6 +900,14 @@ int on_frame_recv_callback
     }
     break;
   }
+  case NGHTTP2_SETTINGS:
+    for(size_t i = 0; i < frame->settings.niv; ++i) {
+      if(frame->settings.iv[i].settings_id ==
+         NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS) {
+        spdy->set_max_concurrent_streams(frame->settings.iv[i].value);
+      }
+    }
+    break;
   case NGHTTP2_PUSH_PROMISE:
     if(LOG_ENABLED(INFO)) {
       SSLOG(INFO, spdy) << "Received downstream PUSH_PROMISE stream_id="
@@ -1194,4 +1223,43 @@ void SpdySession::set_state(int state)
   state_ = state;
 }
 
+const DownstreamAddr* SpdySession::get_addr() const
+{
+  return addr_;
+}
+
+void SpdySession::report_connect_result(bool success)
+{
+  if(success) {
+    balancer_->on_connect_success(addr_idx_);
+    if(ssl_) {
+      tls_session_cache_->count_handshake(SSL_session_reused(ssl_));
+    }
+  } else {
+    balancer_->on_connect_failure(addr_idx_, time(nullptr));
+    if(ssl_) {
+      // The backend may have rejected the session we offered.
+      tls_session_cache_->remove_session(addr_idx_);
+    }
+  }
+}
+
+size_t SpdySession::get_num_dconns() const
+{
+  return dconns_.size();
+}
+
+uint32_t SpdySession::get_max_concurrent_streams() const
+{
+  return max_concurrent_streams_;
+}
+
+void SpdySession::set_max_concurrent_streams(uint32_t n)
+{
+  if(LOG_ENABLED(INFO)) {
+    SSLOG(INFO, this) << "Backend SETTINGS_MAX_CONCURRENT_STREAMS=" << n;
+  }
+  max_concurrent_streams_ = n;
+}
+
 } // namespace shrpx
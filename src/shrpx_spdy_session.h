@@ -41,6 +41,9 @@
 namespace shrpx {
 
 class SpdyDownstreamConnection;
+class DownstreamBalancer;
+class BackendSessionCache;
+struct DownstreamAddr;
 
 struct StreamData {
   SpdyDownstreamConnection *dconn;
@@ -48,7 +51,12 @@ struct StreamData {
 
 class SpdySession {
 public:
-  SpdySession(event_base *evbase, SSL_CTX *ssl_ctx);
+  // |balancer| chooses the backend each time the session connects.
+  // The last TLS session with each backend is kept in
+  // |tls_session_cache| to resume it on reconnect.
+  SpdySession(event_base *evbase, SSL_CTX *ssl_ctx,
+              DownstreamBalancer *balancer,
+              BackendSessionCache *tls_session_cache);
   ~SpdySession();
 
   int init_notification();
@@ -95,6 +103,18 @@ public:
   int get_state() const;
   void set_state(int state);
 
+  // Returns the backend chosen for the current connection.
+  const DownstreamAddr* get_addr() const;
+  // Tells the balancer whether connecting to the backend succeeded.
+  // The cached TLS session is dropped if it did not.
+  void report_connect_result(bool success);
+
+  // Returns the number of requests attached to this session.
+  size_t get_num_dconns() const;
+  // Returns SETTINGS_MAX_CONCURRENT_STREAMS the backend announced.
+  uint32_t get_max_concurrent_streams() const;
+  void set_max_concurrent_streams(uint32_t n);
+
   enum {
     // Disconnected
     DISCONNECTED,
@@ -130,6 +150,15 @@ private:
   bool flow_control_;
   // Used to parse the response from HTTP proxy
   http_parser *proxy_htp_;
+  // Not deleted by this object.
+  DownstreamBalancer *balancer_;
+  // Not deleted by this object.
+  BackendSessionCache *tls_session_cache_;
+  // The backend chosen for the current connection
+  size_t addr_idx_;
+  const DownstreamAddr *addr_;
+  // SETTINGS_MAX_CONCURRENT_STREAMS received from the backend
+  uint32_t max_concurrent_streams_;
 };
 
 } // namespace shrpx
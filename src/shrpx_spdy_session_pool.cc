@@ -0,0 +1,125 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "shrpx_spdy_session_pool.h"
+
+#include "shrpx_spdy_session.h"
+#include "shrpx_log.h"
+
+namespace shrpx {
+
+SpdySessionPool::SpdySessionPool(event_base *evbase, SSL_CTX *ssl_ctx,
+                                 DownstreamBalancer *balancer,
+                                 BackendSessionCache *tls_session_cache,
+                                 size_t max_sessions)
+  : evbase_(evbase),
+    ssl_ctx_(ssl_ctx),
+    balancer_(balancer),
+    tls_session_cache_(tls_session_cache),
+    max_sessions_(max_sessions)
+{}
+
+SpdySessionPool::~SpdySessionPool()
+{
+  for(auto spdy : sessions_) {
+    delete spdy;
+  }
+}
+
+int SpdySessionPool::init()
+{
+  if(create_session() == nullptr) {
+    return -1;
+  }
+  return 0;
+}
+
+SpdySession* SpdySessionPool::create_session()
+{
+  auto spdy = new SpdySession(evbase_, ssl_ctx_, balancer_,
+                              tls_session_cache_);
+  if(spdy->init_notification() == -1) {
+    delete spdy;
+    return nullptr;
+  }
+  sessions_.push_back(spdy);
+  if(LOG_ENABLED(INFO)) {
+    LOG(INFO) << "Created backend session #" << sessions_.size() - 1;
+  }
+  return spdy;
+}
+
+SpdySession* SpdySessionPool::get_session()
+{
+  size_t n = sessions_.size();
+  std::vector<size_t> num_streams(n);
+  std::vector<uint32_t> max_streams(n);
+  for(size_t i = 0; i < n; ++i) {
+    num_streams[i] = sessions_[i]->get_num_dconns();
+    max_streams[i] = sessions_[i]->get_max_concurrent_streams();
+  }
+  auto idx = select_spdy_session(num_streams.data(), max_streams.data(), n,
+                                 max_sessions_);
+  if(idx < n) {
+    return sessions_[idx];
+  }
+  auto spdy = create_session();
+  if(spdy) {
+    return spdy;
+  }
+  LOG(WARNING) << "Could not create another backend session";
+  if(n == 0) {
+    return nullptr;
+  }
+  return sessions_[select_spdy_session(num_streams.data(), max_streams.data(),
+                                       n, n)];
+}
+
+size_t SpdySessionPool::get_num_sessions() const
+{
+  return sessions_.size();
+}
+
+size_t select_spdy_session(const size_t *num_streams,
+                           const uint32_t *max_streams, size_t n,
+                           size_t max_sessions)
+{
+  size_t best = n;
+  int64_t best_room = 0;
+  for(size_t i = 0; i < n; ++i) {
+    int64_t room = static_cast<int64_t>(max_streams[i]) - num_streams[i];
+    if(best == n || room > best_room) {
+      best = i;
+      best_room = room;
+    }
+  }
+  if(n < max_sessions &&
+     (best == n ||
+      num_streams[best] >= max_streams[best] - max_streams[best] / 4)) {
+    return n;
+  }
+  return best;
+}
+
+} // namespace shrpx
@@ -0,0 +1,87 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef SHRPX_SPDY_SESSION_POOL_H
+#define SHRPX_SPDY_SESSION_POOL_H
+
+#include "shrpx.h"
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <openssl/ssl.h>
+
+#include <event.h>
+
+namespace shrpx {
+
+class SpdySession;
+class DownstreamBalancer;
+class BackendSessionCache;
+
+// HTTP/2.0 or SPDY backend sessions of one event loop. Each new
+// stream goes to the session with the most room left below the
+// backend's SETTINGS_MAX_CONCURRENT_STREAMS, and another session is
+// opened when all of them are nearly full. This object is not
+// thread-safe.
+class SpdySessionPool {
+public:
+  // At most |max_sessions| sessions are opened. |balancer| and
+  // |tls_session_cache| are passed to each session to choose its
+  // backend and to resume TLS sessions with it.
+  SpdySessionPool(event_base *evbase, SSL_CTX *ssl_ctx,
+                  DownstreamBalancer *balancer,
+                  BackendSessionCache *tls_session_cache,
+                  size_t max_sessions);
+  // Deletes all sessions.
+  ~SpdySessionPool();
+  // Creates the first session. Returns 0 if it succeeds, or -1.
+  int init();
+  // Returns the session the next stream should be assigned to.
+  SpdySession* get_session();
+  size_t get_num_sessions() const;
+private:
+  SpdySession* create_session();
+  std::vector<SpdySession*> sessions_;
+  event_base *evbase_;
+  SSL_CTX *ssl_ctx_;
+  DownstreamBalancer *balancer_;
+  BackendSessionCache *tls_session_cache_;
+  size_t max_sessions_;
+};
+
+// Returns the index of the session in which a new stream should be
+// opened, given the number of streams |num_streams| and the
+// SETTINGS_MAX_CONCURRENT_STREAMS |max_streams| of each of the |n|
+// sessions. If every session has used 3/4 of its streams and |n| is
+// less than |max_sessions|, returns |n| to indicate a new session
+// should be opened.
+size_t select_spdy_session(const size_t *num_streams,
+                           const uint32_t *max_streams, size_t n,
+                           size_t max_sessions);
+
+} // namespace shrpx
+
+#endif // SHRPX_SPDY_SESSION_POOL_H
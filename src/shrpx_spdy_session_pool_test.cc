@@ -0,0 +1,65 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "shrpx_spdy_session_pool_test.h"
+
+#include <CUnit/CUnit.h>
+
+#include "shrpx_spdy_session_pool.h"
+
+namespace shrpx {
+
+void test_spdy_session_pool_select_spdy_session(void)
+{
+  size_t num_streams[3] = {};
+  uint32_t max_streams[3] = { 100, 100, 100 };
+
+  // No session yet
+  CU_ASSERT(0 == select_spdy_session(num_streams, max_streams, 0, 4));
+
+  // The session with the most room is chosen.
+  num_streams[0] = 10;
+  num_streams[1] = 5;
+  num_streams[2] = 30;
+  CU_ASSERT(1 == select_spdy_session(num_streams, max_streams, 3, 4));
+
+  // A session which announced a larger limit has more room.
+  max_streams[2] = 1000;
+  CU_ASSERT(2 == select_spdy_session(num_streams, max_streams, 3, 4));
+
+  // Every session is nearly full: open another one.
+  num_streams[0] = 75;
+  num_streams[1] = 80;
+  num_streams[2] = 750;
+  CU_ASSERT(3 == select_spdy_session(num_streams, max_streams, 3, 4));
+  // ... unless the limit is reached.
+  CU_ASSERT(2 == select_spdy_session(num_streams, max_streams, 3, 3));
+
+  // The backend has not sent SETTINGS yet, so the limit is unknown.
+  max_streams[0] = (1U << 31) - 1;
+  num_streams[0] = 1000;
+  CU_ASSERT(0 == select_spdy_session(num_streams, max_streams, 1, 4));
+}
+
+} // namespace shrpx
@@ -219,7 +219,8 @@ void on_ctrl_recv_callback
     }
 
     DownstreamConnection *dconn;
-    dconn = upstream->get_client_handler()->get_downstream_connection();
+    auto handler = upstream->get_client_handler();
+    dconn = handler->get_downstream_connection(downstream);
     int rv = dconn->attach_downstream(downstream);
     if(rv != 0) {
       // If downstream connection fails, issue RST_STREAM.
@@ -31,10 +31,15 @@
 
 #include <vector>
 #include <string>
+#include <fstream>
+#include <mutex>
+#include <atomic>
 
 #include <openssl/crypto.h>
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
+#include <openssl/rand.h>
+#include <openssl/hmac.h>
 
 #include <event2/bufferevent.h>
 #include <event2/bufferevent_ssl.h>
@@ -45,6 +50,7 @@
 #include "shrpx_client_handler.h"
 #include "shrpx_config.h"
 #include "shrpx_accesslog.h"
+#include "shrpx_session_cache.h"
 #include "util.h"
 
 using namespace nghttp2;
@@ -118,7 +124,9 @@ int servername_callback(SSL *ssl, int *al, void *arg)
     if(hostname) {
       SSL_CTX *ssl_ctx = cert_lookup_tree_lookup(get_config()->cert_tree,
                                                  hostname, strlen(hostname));
-      if(ssl_ctx) {
+      // The default certificate is also served by the per-worker
+      // copies of default_ssl_ctx, so keep the current one.
+      if(ssl_ctx && ssl_ctx != get_config()->default_ssl_ctx) {
         SSL_set_SSL_CTX(ssl, ssl_ctx);
       }
     }
@@ -127,6 +135,135 @@ int servername_callback(SSL *ssl, int *al, void *arg)
 }
 } // namespace
 
+namespace {
+std::mutex ticket_keys_mutex;
+std::shared_ptr<TicketKeys> ticket_keys;
+} // namespace
+
+void set_ticket_keys(std::shared_ptr<TicketKeys> keys)
+{
+  std::lock_guard<std::mutex> g(ticket_keys_mutex);
+  ticket_keys = std::move(keys);
+}
+
+std::shared_ptr<TicketKeys> get_ticket_keys()
+{
+  std::lock_guard<std::mutex> g(ticket_keys_mutex);
+  return ticket_keys;
+}
+
+std::shared_ptr<TicketKeys> read_ticket_keys_file(const char *path)
+{
+  std::ifstream f(path, std::ios::binary);
+  if(!f) {
+    LOG(ERROR) << "Could not open session ticket key file " << path;
+    return nullptr;
+  }
+  auto keys = std::make_shared<TicketKeys>();
+  for(;;) {
+    TicketKey key;
+    f.read(reinterpret_cast<char*>(&key), sizeof(key));
+    if(f.gcount() == 0) {
+      break;
+    }
+    if(f.gcount() != sizeof(key)) {
+      LOG(ERROR) << "Session ticket key file " << path
+                 << " is not a multiple of " << sizeof(key) << " bytes";
+      return nullptr;
+    }
+    keys->keys.push_back(key);
+  }
+  if(keys->keys.empty()) {
+    LOG(ERROR) << "No session ticket key found in " << path;
+    return nullptr;
+  }
+  return keys;
+}
+
+std::shared_ptr<TicketKeys>
+generate_ticket_keys(const std::shared_ptr<TicketKeys>& old)
+{
+  auto keys = std::make_shared<TicketKeys>();
+  TicketKey key;
+  if(RAND_bytes(reinterpret_cast<unsigned char*>(&key), sizeof(key)) != 1) {
+    LOG(ERROR) << "RAND_bytes() failed: "
+               << ERR_error_string(ERR_get_error(), nullptr);
+    return nullptr;
+  }
+  keys->keys.push_back(key);
+  if(old && !old->keys.empty()) {
+    keys->keys.push_back(old->keys[0]);
+  }
+  return keys;
+}
+
+namespace {
+std::atomic<uint64_t> num_full_handshakes(0);
+std::atomic<uint64_t> num_resumed_handshakes(0);
+std::atomic<uint64_t> num_ticket_key_misses(0);
+} // namespace
+
+void count_handshake(SSL *ssl)
+{
+  if(SSL_session_reused(ssl)) {
+    num_resumed_handshakes.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    num_full_handshakes.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+HandshakeStat get_handshake_stat()
+{
+  HandshakeStat stat;
+  stat.num_full = num_full_handshakes.load(std::memory_order_relaxed);
+  stat.num_resumed = num_resumed_handshakes.load(std::memory_order_relaxed);
+  stat.num_ticket_key_misses =
+    num_ticket_key_misses.load(std::memory_order_relaxed);
+  return stat;
+}
+
+namespace {
+int ticket_key_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv,
+                  EVP_CIPHER_CTX *ctx, HMAC_CTX *hctx, int enc)
+{
+  auto keys = get_ticket_keys();
+  if(!keys || keys->keys.empty()) {
+    // No ticket is issued or accepted.
+    return enc ? -1 : 0;
+  }
+  if(enc) {
+    auto& key = keys->keys[0];
+    if(RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1) {
+      return -1;
+    }
+    memcpy(key_name, key.name, sizeof(key.name));
+    EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), nullptr, key.aes_key, iv);
+    HMAC_Init_ex(hctx, key.hmac_key, sizeof(key.hmac_key), EVP_sha256(),
+                 nullptr);
+    return 1;
+  }
+  size_t i;
+  for(i = 0; i < keys->keys.size(); ++i) {
+    if(memcmp(key_name, keys->keys[i].name, sizeof(keys->keys[i].name))
+       == 0) {
+      break;
+    }
+  }
+  if(i == keys->keys.size()) {
+    // Unknown or expired key. Fall back to full handshake.
+    num_ticket_key_misses.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+  }
+  auto& key = keys->keys[i];
+  HMAC_Init_ex(hctx, key.hmac_key, sizeof(key.hmac_key), EVP_sha256(),
+               nullptr);
+  EVP_DecryptInit_ex(ctx, EVP_aes_128_cbc(), nullptr, key.aes_key, iv);
+  // Ask the client to replace the ticket if it was not issued with
+  // the current key.
+  return i == 0 ? 1 : 2;
+}
+} // namespace
+
 SSL_CTX* create_ssl_context(const char *private_key_file,
                             const char *cert_file)
 {
@@ -139,12 +276,11 @@ SSL_CTX* create_ssl_context(const char *private_key_file,
   SSL_CTX_set_options(ssl_ctx,
                       SSL_OP_ALL | SSL_OP_NO_SSLv2 | SSL_OP_NO_COMPRESSION |
                       SSL_OP_NO_SESSION_RESUMPTION_ON_RENEGOTIATION |
-                      SSL_OP_SINGLE_ECDH_USE | SSL_OP_SINGLE_DH_USE |
-                      SSL_OP_NO_TICKET);
+                      SSL_OP_SINGLE_ECDH_USE | SSL_OP_SINGLE_DH_USE);
 
   const unsigned char sid_ctx[] = "shrpx";
   SSL_CTX_set_session_id_context(ssl_ctx, sid_ctx, sizeof(sid_ctx)-1);
-  SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_SERVER);
+  setup_session_cache(ssl_ctx);
 
   if(get_config()->ciphers) {
     if(SSL_CTX_set_cipher_list(ssl_ctx, get_config()->ciphers) == 0) {
@@ -217,7 +353,7 @@ SSL_CTX* create_ssl_context(const char *private_key_file,
                        verify_callback);
   }
   SSL_CTX_set_tlsext_servername_callback(ssl_ctx, servername_callback);
-
+  SSL_CTX_set_tlsext_ticket_key_cb(ssl_ctx, ticket_key_cb);
 
   const char *protos[] = { NGHTTP2_PROTO_VERSION_ID,
 #ifdef HAVE_SPDYLAY
@@ -257,6 +393,12 @@ SSL_CTX* create_ssl_client_context()
   SSL_CTX_set_options(ssl_ctx,
                       SSL_OP_ALL | SSL_OP_NO_SSLv2 | SSL_OP_NO_COMPRESSION |
                       SSL_OP_NO_SESSION_RESUMPTION_ON_RENEGOTIATION);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+  // Backends are often restarted without sending close_notify. Such
+  // an EOF would otherwise make the cached session unresumable,
+  // although HTTP/2.0 framing detects truncation by itself.
+  SSL_CTX_set_options(ssl_ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif // SSL_OP_IGNORE_UNEXPECTED_EOF
 
   if(get_config()->ciphers) {
     if(SSL_CTX_set_cipher_list(ssl_ctx, get_config()->ciphers) == 0) {
@@ -285,6 +427,7 @@ SSL_CTX* create_ssl_client_context()
   }
 
   SSL_CTX_set_next_proto_select_cb(ssl_ctx, select_next_proto_cb, 0);
+  setup_backend_session_cache(ssl_ctx);
   return ssl_ctx;
 }
 
@@ -486,7 +629,7 @@ void get_altnames(X509 *cert,
   }
 }
 
-int check_cert(SSL *ssl)
+int check_cert(SSL *ssl, const DownstreamAddr *addr)
 {
   X509 *cert = SSL_get_peer_certificate(ssl);
   if(!cert) {
@@ -504,9 +647,7 @@ int check_cert(SSL *ssl)
   std::vector<std::string> dns_names;
   std::vector<std::string> ip_addrs;
   get_altnames(cert, dns_names, ip_addrs, common_name);
-  if(verify_hostname(get_config()->downstream_host,
-                     &get_config()->downstream_addr,
-                     get_config()->downstream_addrlen,
+  if(verify_hostname(addr->host, &addr->addr, addr->addrlen,
                      dns_names, ip_addrs, common_name) != 0) {
     LOG(ERROR) << "Certificate verification failed: hostname does not match";
     return -1;
@@ -514,6 +655,13 @@ int check_cert(SSL *ssl)
   return 0;
 }
 
+namespace {
+std::atomic<uint64_t> num_lock_acquired(0);
+std::atomic<uint64_t> num_lock_contended(0);
+} // namespace
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+
 namespace {
 pthread_mutex_t *ssl_locks;
 } // namespace
@@ -522,7 +670,14 @@ namespace {
 void ssl_locking_cb(int mode, int type, const char *file, int line)
 {
   if(mode & CRYPTO_LOCK) {
-    pthread_mutex_lock(&(ssl_locks[type]));
+    auto lock = &ssl_locks[type];
+    // Try first so that the time spent waiting for other threads is
+    // visible in the lock stat.
+    if(pthread_mutex_trylock(lock) != 0) {
+      num_lock_contended.fetch_add(1, std::memory_order_relaxed);
+      pthread_mutex_lock(lock);
+    }
+    num_lock_acquired.fetch_add(1, std::memory_order_relaxed);
   } else {
     pthread_mutex_unlock(&(ssl_locks[type]));
   }
@@ -551,6 +706,26 @@ void teardown_ssl_lock()
   delete [] ssl_locks;
 }
 
+#else // OPENSSL_VERSION_NUMBER >= 0x10100000L
+
+// OpenSSL 1.1.0 and later lock by themselves and ignore the locking
+// callback.
+void setup_ssl_lock()
+{}
+
+void teardown_ssl_lock()
+{}
+
+#endif // OPENSSL_VERSION_NUMBER >= 0x10100000L
+
+LockStat get_lock_stat()
+{
+  LockStat stat;
+  stat.num_acquired = num_lock_acquired.load(std::memory_order_relaxed);
+  stat.num_contended = num_lock_contended.load(std::memory_order_relaxed);
+  return stat;
+}
+
 CertLookupTree* cert_lookup_tree_new()
 {
   CertLookupTree *tree = new CertLookupTree();
@@ -28,6 +28,7 @@
 #include "shrpx.h"
 
 #include <vector>
+#include <memory>
 
 #include <openssl/ssl.h>
 #include <openssl/err.h>
@@ -37,6 +38,7 @@
 namespace shrpx {
 
 class ClientHandler;
+struct DownstreamAddr;
 
 namespace ssl {
 
@@ -51,7 +53,66 @@ ClientHandler* accept_connection(event_base *evbase, SSL_CTX *ssl_ctx,
 
 bool numeric_host(const char *hostname);
 
-int check_cert(SSL *ssl);
+// Verifies the certificate presented by the backend |addr| over
+// |ssl|.
+int check_cert(SSL *ssl, const DownstreamAddr *addr);
+
+// A session ticket key. |name| identifies the key in the tickets it
+// issued.
+struct TicketKey {
+  unsigned char name[16];
+  unsigned char aes_key[16];
+  unsigned char hmac_key[16];
+};
+
+struct TicketKeys {
+  // The first key encrypts new tickets. All of them decrypt.
+  std::vector<TicketKey> keys;
+};
+
+// Reads session ticket keys from |path|. The file is the
+// concatenation of one or more 48-byte keys: 16 bytes name, 16 bytes
+// AES key and 16 bytes HMAC key. Returns NULL if the file cannot be
+// read or is malformed.
+std::shared_ptr<TicketKeys> read_ticket_keys_file(const char *path);
+
+// Returns new keys with a random key first, followed by the first
+// key of |old| if it is not NULL, so that the tickets issued just
+// before the rotation are still accepted. Returns NULL if random
+// bytes cannot be generated.
+std::shared_ptr<TicketKeys>
+generate_ticket_keys(const std::shared_ptr<TicketKeys>& old);
+
+// Replaces the session ticket keys used by all threads.
+void set_ticket_keys(std::shared_ptr<TicketKeys> keys);
+std::shared_ptr<TicketKeys> get_ticket_keys();
+
+struct HandshakeStat {
+  // The number of handshakes which did not resume a session
+  uint64_t num_full;
+  // The number of handshakes which resumed a session, either from
+  // the session cache or from a ticket.
+  uint64_t num_resumed;
+  // The number of tickets presented with an unknown key
+  uint64_t num_ticket_key_misses;
+};
+
+// Counts the handshake completed on |ssl|. Thread-safe.
+void count_handshake(SSL *ssl);
+
+HandshakeStat get_handshake_stat();
+
+struct LockStat {
+  // The number of locks taken by OpenSSL
+  uint64_t num_acquired;
+  // The number of them which were held by another thread at the time
+  uint64_t num_contended;
+};
+
+// Returns the counters of ssl_locking_cb. The callback is only
+// installed with OpenSSL older than 1.1.0, which leaves locking to
+// the application; otherwise both counters stay 0.
+LockStat get_lock_stat();
 
 void setup_ssl_lock();
 
@@ -24,6 +24,11 @@
  */
 #include "shrpx_ssl_test.h"
 
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+
 #include <CUnit/CUnit.h>
 
 #include "shrpx_ssl.h"
@@ -130,4 +135,52 @@ void test_shrpx_ssl_cert_lookup_tree_add_cert_from_file(void)
   SSL_CTX_free(ssl_ctx);
 }
 
+void test_shrpx_ssl_read_ticket_keys_file(void)
+{
+  char path[] = "/tmp/nghttpx-unittest-ticket-keys.XXXXXX";
+  int fd = mkstemp(path);
+  CU_ASSERT_FATAL(fd != -1);
+  unsigned char data[48 * 2 + 1];
+  for(size_t i = 0; i < sizeof(data); ++i) {
+    data[i] = i;
+  }
+  // Two keys
+  CU_ASSERT(48 * 2 == write(fd, data, 48 * 2));
+  auto keys = ssl::read_ticket_keys_file(path);
+  CU_ASSERT_FATAL(keys != nullptr);
+  CU_ASSERT(2 == keys->keys.size());
+  CU_ASSERT(0 == memcmp(data, keys->keys[0].name, 16));
+  CU_ASSERT(0 == memcmp(data + 16, keys->keys[0].aes_key, 16));
+  CU_ASSERT(0 == memcmp(data + 32, keys->keys[0].hmac_key, 16));
+  CU_ASSERT(0 == memcmp(data + 48, keys->keys[1].name, 16));
+  // Truncated key
+  CU_ASSERT(1 == write(fd, data + 48 * 2, 1));
+  CU_ASSERT(nullptr == ssl::read_ticket_keys_file(path));
+  // Empty file
+  CU_ASSERT(0 == ftruncate(fd, 0));
+  CU_ASSERT(nullptr == ssl::read_ticket_keys_file(path));
+  close(fd);
+  unlink(path);
+
+  CU_ASSERT(nullptr == ssl::read_ticket_keys_file(path));
+}
+
+void test_shrpx_ssl_generate_ticket_keys(void)
+{
+  auto keys = ssl::generate_ticket_keys(nullptr);
+  CU_ASSERT_FATAL(keys != nullptr);
+  CU_ASSERT(1 == keys->keys.size());
+  auto next = ssl::generate_ticket_keys(keys);
+  CU_ASSERT_FATAL(next != nullptr);
+  CU_ASSERT(2 == next->keys.size());
+  CU_ASSERT(0 != memcmp(next->keys[0].name, keys->keys[0].name, 16));
+  CU_ASSERT(0 == memcmp(&next->keys[1], &keys->keys[0],
+                        sizeof(ssl::TicketKey)));
+  // Only the previous current key is kept.
+  auto last = ssl::generate_ticket_keys(next);
+  CU_ASSERT(2 == last->keys.size());
+  CU_ASSERT(0 == memcmp(&last->keys[1], &next->keys[0],
+                        sizeof(ssl::TicketKey)));
+}
+
 } // namespace shrpx
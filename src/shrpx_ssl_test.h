@@ -29,6 +29,8 @@ namespace shrpx {
 
 void test_shrpx_ssl_create_lookup_tree(void);
 void test_shrpx_ssl_cert_lookup_tree_add_cert_from_file(void);
+void test_shrpx_ssl_read_ticket_keys_file(void);
+void test_shrpx_ssl_generate_ticket_keys(void);
 
 } // namespace shrpx
 
@@ -26,16 +26,25 @@
 
 #include <unistd.h>
 
+#include <cstring>
+
 #include "shrpx_ssl.h"
 #include "shrpx_log.h"
 #include "shrpx_client_handler.h"
-#include "shrpx_spdy_session.h"
+#include "shrpx_spdy_session_pool.h"
+#include "shrpx_worker_stat.h"
 
 namespace shrpx {
 
-ThreadEventReceiver::ThreadEventReceiver(SSL_CTX *ssl_ctx, SpdySession *spdy)
+ThreadEventReceiver::ThreadEventReceiver
+(SSL_CTX *ssl_ctx, SpdySessionPool *spdy_pool,
+ DownstreamConnectionPool *http_dconn_pool, DownstreamBalancer *balancer,
+ WorkerStat *stat)
   : ssl_ctx_(ssl_ctx),
-    spdy_(spdy)
+    spdy_pool_(spdy_pool),
+    http_dconn_pool_(http_dconn_pool),
+    balancer_(balancer),
+    stat_(stat)
 {}
 
 ThreadEventReceiver::~ThreadEventReceiver()
@@ -44,36 +53,63 @@ ThreadEventReceiver::~ThreadEventReceiver()
 void ThreadEventReceiver::on_read(bufferevent *bev)
 {
   evbuffer *input = bufferevent_get_input(bev);
-  while(evbuffer_get_length(input) >= sizeof(WorkerEvent)) {
+  // The main thread writes a batch of WorkerEvents at once. Process
+  // all complete ones with a single pullup and drain.
+  size_t num = evbuffer_get_length(input) / sizeof(WorkerEvent);
+  if(num == 0) {
+    return;
+  }
+  size_t len = num * sizeof(WorkerEvent);
+  auto buf = evbuffer_pullup(input, len);
+  if(!buf) {
+    TLOG(FATAL, this) << "evbuffer_pullup() failed";
+    return;
+  }
+  if(LOG_ENABLED(INFO)) {
+    TLOG(INFO, this) << "Received " << num << " WorkerEvent(s)";
+  }
+  event_base *evbase = bufferevent_get_base(bev);
+  for(size_t i = 0; i < num; ++i) {
     WorkerEvent wev;
-    int nread = evbuffer_remove(input, &wev, sizeof(wev));
-    if(nread != sizeof(wev)) {
-      TLOG(FATAL, this) << "evbuffer_remove() removed fewer bytes. Expected:"
-                        << sizeof(wev) << " Actual:" << nread;
-      continue;
-    }
+    // buf is not necessarily aligned for WorkerEvent
+    memcpy(&wev, buf + i * sizeof(wev), sizeof(wev));
     if(LOG_ENABLED(INFO)) {
       TLOG(INFO, this) << "WorkerEvent: client_fd=" << wev.client_fd
                        << ", addrlen=" << wev.client_addrlen;
     }
-    event_base *evbase = bufferevent_get_base(bev);
-    ClientHandler *client_handler;
-    client_handler = ssl::accept_connection(evbase, ssl_ctx_,
-                                            wev.client_fd,
-                                            &wev.client_addr.sa,
-                                            wev.client_addrlen);
-    if(client_handler) {
-      client_handler->set_spdy_session(spdy_);
-      if(LOG_ENABLED(INFO)) {
-        TLOG(INFO, this) << "CLIENT_HANDLER:" << client_handler << " created";
-      }
-    } else {
-      if(LOG_ENABLED(INFO)) {
-        TLOG(ERROR, this) << "ClientHandler creation failed";
-      }
-      close(wev.client_fd);
+    accept_connection(evbase, wev.client_fd, &wev.client_addr.sa,
+                      wev.client_addrlen);
+  }
+  evbuffer_drain(input, len);
+}
+
+void ThreadEventReceiver::accept_connection(event_base *evbase,
+                                            evutil_socket_t fd,
+                                            sockaddr *addr, int addrlen)
+{
+  ClientHandler *client_handler;
+  client_handler = ssl::accept_connection(evbase, ssl_ctx_, fd, addr,
+                                          addrlen);
+  if(client_handler) {
+    client_handler->set_spdy_session_pool(spdy_pool_);
+    client_handler->set_http_dconn_pool(http_dconn_pool_);
+    client_handler->set_downstream_balancer(balancer_);
+    client_handler->set_worker_stat(stat_);
+    if(LOG_ENABLED(INFO)) {
+      TLOG(INFO, this) << "CLIENT_HANDLER:" << client_handler << " created";
+    }
+  } else {
+    if(LOG_ENABLED(INFO)) {
+      TLOG(ERROR, this) << "ClientHandler creation failed";
     }
+    close(fd);
+    stat_->num_connections.fetch_sub(1, std::memory_order_relaxed);
   }
 }
 
+WorkerStat* ThreadEventReceiver::get_worker_stat() const
+{
+  return stat_;
+}
+
 } // namespace shrpx
@@ -35,7 +35,10 @@
 
 namespace shrpx {
 
-class SpdySession;
+class SpdySessionPool;
+struct WorkerStat;
+class DownstreamConnectionPool;
+class DownstreamBalancer;
 
 struct WorkerEvent {
   evutil_socket_t client_fd;
@@ -45,14 +48,29 @@ struct WorkerEvent {
 
 class ThreadEventReceiver {
 public:
-  ThreadEventReceiver(SSL_CTX *ssl_ctx, SpdySession *spdy);
+  ThreadEventReceiver(SSL_CTX *ssl_ctx, SpdySessionPool *spdy_pool,
+                      DownstreamConnectionPool *http_dconn_pool,
+                      DownstreamBalancer *balancer, WorkerStat *stat);
   ~ThreadEventReceiver();
   void on_read(bufferevent *bev);
+  // Creates ClientHandler for the connection |fd| accepted by the
+  // worker thread itself. The connection must be already counted in
+  // WorkerStat::num_connections.
+  void accept_connection(event_base *evbase, evutil_socket_t fd,
+                         sockaddr *addr, int addrlen);
+  WorkerStat* get_worker_stat() const;
 private:
   SSL_CTX *ssl_ctx_;
-  // Shared SPDY session for each thread. NULL if not client mode. Not
-  // deleted by this object.
-  SpdySession *spdy_;
+  // Shared SPDY sessions for each thread. NULL if not client
+  // mode. Not deleted by this object.
+  SpdySessionPool *spdy_pool_;
+  // Idle HTTP/1.1 backend connections shared by the ClientHandlers in
+  // this thread. Not deleted by this object.
+  DownstreamConnectionPool *http_dconn_pool_;
+  // Chooses backends in this thread. Not deleted by this object.
+  DownstreamBalancer *balancer_;
+  // Load counters of this worker. Not deleted by this object.
+  WorkerStat *stat_;
 };
 
 } // namespace shrpx
@@ -29,19 +29,28 @@
 
 #include <event.h>
 #include <event2/bufferevent.h>
+#include <event2/listener.h>
 
 #include "shrpx_ssl.h"
 #include "shrpx_thread_event_receiver.h"
 #include "shrpx_log.h"
-#include "shrpx_spdy_session.h"
+#include "shrpx_spdy_session_pool.h"
+#include "shrpx_downstream_connection_pool.h"
+#include "shrpx_downstream_balancer.h"
+#include "shrpx_session_cache.h"
 
 namespace shrpx {
 
 Worker::Worker(WorkerInfo *info)
   : fd_(info->sv[1]),
     sv_ssl_ctx_(info->sv_ssl_ctx),
-    cl_ssl_ctx_(info->cl_ssl_ctx)
-{}
+    cl_ssl_ctx_(info->cl_ssl_ctx),
+    stat_(&info->stat)
+{
+  for(size_t i = 0; i < 2; ++i) {
+    listen_fds_[i] = info->listen_fds[i];
+  }
+}
 
 Worker::~Worker()
 {
@@ -69,23 +78,79 @@ void eventcb(bufferevent *bev, short events, void *arg)
 }
 } // namespace
 
+namespace {
+void acceptcb(evconnlistener *listener, evutil_socket_t fd,
+              sockaddr *addr, int addrlen, void *arg)
+{
+  auto receiver = reinterpret_cast<ThreadEventReceiver*>(arg);
+  if(LOG_ENABLED(INFO)) {
+    LOG(INFO) << "Accepted connection in worker. fd=" << fd;
+  }
+  receiver->get_worker_stat()->num_connections.fetch_add
+    (1, std::memory_order_relaxed);
+  receiver->accept_connection(evconnlistener_get_base(listener), fd,
+                              addr, addrlen);
+}
+} // namespace
+
+namespace {
+void evlistener_errorcb(evconnlistener *listener, void *arg)
+{
+  LOG(ERROR) << "Accepting incoming connection failed";
+}
+} // namespace
+
 void Worker::run()
 {
   auto evbase = event_base_new();
   auto bev = bufferevent_socket_new(evbase, fd_, BEV_OPT_DEFER_CALLBACKS);
-  SpdySession *spdy = nullptr;
+  DownstreamBalancer balancer(get_config()->num_downstream_addrs,
+                              get_config()->downstream_balance_method,
+                              get_config()->downstream_eject_period);
+  BackendSessionCache tls_session_cache(get_config()->num_downstream_addrs,
+                                        stat_);
+  SpdySessionPool *spdy_pool = nullptr;
   if(get_config()->downstream_proto == PROTO_SPDY) {
-    spdy = new SpdySession(evbase, cl_ssl_ctx_);
-    if(spdy->init_notification() == -1) {
+    spdy_pool = new SpdySessionPool
+      (evbase, cl_ssl_ctx_, &balancer, &tls_session_cache,
+       get_config()->downstream_spdy_max_sessions);
+    if(spdy_pool->init() == -1) {
       DIE();
     }
   }
-  auto receiver = new ThreadEventReceiver(sv_ssl_ctx_, spdy);
+  DownstreamConnectionPool http_dconn_pool
+    (get_config()->downstream_max_idle_connections, stat_);
+  auto receiver = new ThreadEventReceiver(sv_ssl_ctx_, spdy_pool,
+                                          &http_dconn_pool, &balancer,
+                                          stat_);
   bufferevent_enable(bev, EV_READ);
   bufferevent_setcb(bev, readcb, 0, eventcb, receiver);
 
+  evconnlistener *evlisteners[2] = { nullptr, nullptr };
+  for(size_t i = 0; i < 2; ++i) {
+    if(listen_fds_[i] == -1) {
+      continue;
+    }
+    evlisteners[i] = evconnlistener_new(evbase, acceptcb, receiver,
+                                        LEV_OPT_REUSEABLE |
+                                        LEV_OPT_CLOSE_ON_FREE,
+                                        get_config()->backlog,
+                                        listen_fds_[i]);
+    if(!evlisteners[i]) {
+      LOG(ERROR) << "evconnlistener_new() failed for fd=" << listen_fds_[i];
+      close(listen_fds_[i]);
+      continue;
+    }
+    evconnlistener_set_error_cb(evlisteners[i], evlistener_errorcb);
+  }
+
   event_base_loop(evbase, 0);
 
+  for(size_t i = 0; i < 2; ++i) {
+    if(evlisteners[i]) {
+      evconnlistener_free(evlisteners[i]);
+    }
+  }
   delete receiver;
 }
 
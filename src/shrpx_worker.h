@@ -42,8 +42,12 @@ public:
 private:
   // Channel to the main thread
   int fd_;
+  // Listening sockets owned by this worker. -1 if not used.
+  evutil_socket_t listen_fds_[2];
   SSL_CTX *sv_ssl_ctx_;
   SSL_CTX *cl_ssl_ctx_;
+  // Load counters shared with the main thread
+  WorkerStat *stat_;
 };
 
 void start_threaded_worker(WorkerInfo *info);
@@ -0,0 +1,63 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "shrpx_worker_stat.h"
+
+namespace shrpx {
+
+WorkerStat::WorkerStat()
+  : num_connections(0),
+    num_downstreams(0),
+    pending_write_bytes(0),
+    backend_pool_hits(0),
+    backend_pool_misses(0),
+    backend_tls_resumed(0),
+    backend_tls_full(0)
+{}
+
+size_t worker_load(const WorkerStat *stat)
+{
+  return stat->num_connections.load(std::memory_order_relaxed) +
+    stat->num_downstreams.load(std::memory_order_relaxed) +
+    stat->pending_write_bytes.load(std::memory_order_relaxed) /
+    SHRPX_WORKER_LOAD_PENDING_UNIT;
+}
+
+size_t select_least_loaded_worker(WorkerStat * const *stats, size_t n,
+                                  size_t start)
+{
+  size_t best = start % n;
+  size_t best_load = worker_load(stats[best]);
+  for(size_t i = 1; i < n && best_load > 0; ++i) {
+    size_t idx = (start + i) % n;
+    size_t load = worker_load(stats[idx]);
+    if(load < best_load) {
+      best = idx;
+      best_load = load;
+    }
+  }
+  return best;
+}
+
+} // namespace shrpx
@@ -0,0 +1,83 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef SHRPX_WORKER_STAT_H
+#define SHRPX_WORKER_STAT_H
+
+#include "shrpx.h"
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <atomic>
+
+namespace shrpx {
+
+// Load counters of a worker thread. They are updated by the worker
+// thread (and by the main thread when it hands a connection over)
+// and read by the main thread to choose the worker for a new
+// connection, so all members are atomic. Relaxed ordering is enough
+// since they are only used as hints.
+struct WorkerStat {
+  WorkerStat();
+  // The number of client connections assigned to the worker. This
+  // is counted from the moment the connection is handed to the
+  // worker, so that a burst of accepted connections does not go to
+  // the same worker before it gets a chance to process them.
+  std::atomic<size_t> num_connections;
+  // The number of Downstream objects alive in the worker.
+  std::atomic<size_t> num_downstreams;
+  // The number of bytes queued in the upstream output buffers and
+  // not written to the clients yet.
+  std::atomic<size_t> pending_write_bytes;
+  // The number of times an idle HTTP/1.1 backend connection was
+  // reused from the worker's pool, and the number of times a new one
+  // had to be made.
+  std::atomic<uint64_t> backend_pool_hits;
+  std::atomic<uint64_t> backend_pool_misses;
+  // The number of TLS handshakes with HTTP/2.0 or SPDY backends which
+  // resumed a cached session, and the number of full ones.
+  std::atomic<uint64_t> backend_tls_resumed;
+  std::atomic<uint64_t> backend_tls_full;
+};
+
+// Each chunk of this many pending output bytes weighs as much as one
+// connection or one Downstream in worker_load().
+#define SHRPX_WORKER_LOAD_PENDING_UNIT 16384
+
+// Returns the load score of the worker: the number of connections
+// plus the number of Downstreams plus the pending output bytes in
+// SHRPX_WORKER_LOAD_PENDING_UNIT.
+size_t worker_load(const WorkerStat *stat);
+
+// Returns the index of the least loaded worker in |stats| of length
+// |n|. The workers are scanned starting at |start| % |n|, so that
+// ties are broken in round-robin fashion if the caller advances
+// |start| for each call. |n| must be greater than 0.
+size_t select_least_loaded_worker(WorkerStat * const *stats, size_t n,
+                                  size_t start);
+
+} // namespace shrpx
+
+#endif // SHRPX_WORKER_STAT_H
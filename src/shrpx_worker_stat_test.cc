@@ -0,0 +1,65 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "shrpx_worker_stat_test.h"
+
+#include <CUnit/CUnit.h>
+
+#include "shrpx_worker_stat.h"
+
+namespace shrpx {
+
+void test_worker_stat_select_least_loaded_worker(void)
+{
+  WorkerStat stats[3];
+  WorkerStat *ptrs[] = { &stats[0], &stats[1], &stats[2] };
+
+  // All idle: round-robin by |start|
+  CU_ASSERT(0 == select_least_loaded_worker(ptrs, 3, 0));
+  CU_ASSERT(1 == select_least_loaded_worker(ptrs, 3, 1));
+  CU_ASSERT(2 == select_least_loaded_worker(ptrs, 3, 5));
+
+  stats[0].num_connections = 2;
+  stats[1].num_connections = 1;
+  stats[1].num_downstreams = 3;
+  stats[2].num_connections = 1;
+  stats[2].pending_write_bytes = SHRPX_WORKER_LOAD_PENDING_UNIT * 2;
+
+  CU_ASSERT(2 == worker_load(&stats[0]));
+  CU_ASSERT(4 == worker_load(&stats[1]));
+  CU_ASSERT(3 == worker_load(&stats[2]));
+  CU_ASSERT(0 == select_least_loaded_worker(ptrs, 3, 1));
+
+  // Pending bytes less than the unit do not count
+  stats[2].pending_write_bytes = SHRPX_WORKER_LOAD_PENDING_UNIT - 1;
+  CU_ASSERT(1 == worker_load(&stats[2]));
+  CU_ASSERT(2 == select_least_loaded_worker(ptrs, 3, 0));
+
+  // Ties are broken by the scan start
+  stats[0].num_connections = 1;
+  CU_ASSERT(0 == select_least_loaded_worker(ptrs, 3, 0));
+  CU_ASSERT(2 == select_least_loaded_worker(ptrs, 3, 2));
+}
+
+} // namespace shrpx
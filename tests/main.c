@@ -68,6 +68,7 @@ int main(int argc, char* argv[])
    /* add the tests to the suite */
    if(!CU_add_test(pSuite, "pq", test_nghttp2_pq) ||
       !CU_add_test(pSuite, "pq_update", test_nghttp2_pq_update) ||
+      !CU_add_test(pSuite, "pq_update_item", test_nghttp2_pq_update_item) ||
       !CU_add_test(pSuite, "map", test_nghttp2_map) ||
       !CU_add_test(pSuite, "map_functional", test_nghttp2_map_functional) ||
       !CU_add_test(pSuite, "map_each_free", test_nghttp2_map_each_free) ||
@@ -84,6 +85,8 @@ int main(int argc, char* argv[])
                    test_nghttp2_session_recv_eof) ||
       !CU_add_test(pSuite, "session_recv_data",
                    test_nghttp2_session_recv_data) ||
+      !CU_add_test(pSuite, "session_recv_in_place",
+                   test_nghttp2_session_recv_in_place) ||
       !CU_add_test(pSuite, "session_recv_frame_too_large",
                    test_nghttp2_session_recv_frame_too_large) ||
       !CU_add_test(pSuite, "session_add_frame",
@@ -188,12 +191,24 @@ int main(int argc, char* argv[])
                    test_nghttp2_session_on_stream_close) ||
       !CU_add_test(pSuite, "session_on_ctrl_not_send",
                    test_nghttp2_session_on_ctrl_not_send) ||
+      !CU_add_test(pSuite, "session_fair_data_scheduling",
+                   test_nghttp2_session_fair_data_scheduling) ||
       !CU_add_test(pSuite, "session_get_outbound_queue_size",
                    test_nghttp2_session_get_outbound_queue_size) ||
       !CU_add_test(pSuite, "session_set_option",
                    test_nghttp2_session_set_option) ||
       !CU_add_test(pSuite, "session_data_backoff_by_high_pri_frame",
                    test_nghttp2_session_data_backoff_by_high_pri_frame) ||
+      !CU_add_test(pSuite, "session_data_no_copy",
+                   test_nghttp2_session_data_no_copy) ||
+      !CU_add_test(pSuite, "session_send_batch",
+                   test_nghttp2_session_send_batch) ||
+      !CU_add_test(pSuite, "session_custom_mem",
+                   test_nghttp2_session_custom_mem) ||
+      !CU_add_test(pSuite, "session_shrink",
+                   test_nghttp2_session_shrink) ||
+      !CU_add_test(pSuite, "session_on_header_callback",
+                   test_nghttp2_session_on_header_callback) ||
       !CU_add_test(pSuite, "pack_settings_payload",
                    test_nghttp2_pack_settings_payload) ||
       !CU_add_test(pSuite, "frame_nv_check_null",
@@ -243,6 +258,8 @@ int main(int argc, char* argv[])
                    test_nghttp2_hd_inflate_clearall_inc) ||
       !CU_add_test(pSuite, "hd_deflate_inflate",
                    test_nghttp2_hd_deflate_inflate) ||
+      !CU_add_test(pSuite, "hd_deflate_index",
+                   test_nghttp2_hd_deflate_index) ||
       !CU_add_test(pSuite, "gzip_inflate", test_nghttp2_gzip_inflate) ||
       !CU_add_test(pSuite, "adjust_local_window_size",
                    test_nghttp2_adjust_local_window_size) ||
@@ -0,0 +1,132 @@
+/*
+ * nghttp2 - HTTP/2.0 C Library
+ *
+ * Copyright (c) 2013 Tatsuhiro Tsujikawa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * Micro benchmark of nghttp2_map with the stream count typical for
+ * HTTP/2 sessions. Build with "make mapbench" in tests directory.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "nghttp2_map.h"
+
+#define NUM_FIND 1000000
+#define NUM_CHURN 1000000
+
+static double elapsed(clock_t start)
+{
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void shuffle(key_type *a, size_t n)
+{
+  size_t i;
+  for(i = n - 1; i >= 1; --i) {
+    size_t j = (size_t)((double)(i + 1) * rand() / (RAND_MAX + 1.0));
+    key_type t = a[j];
+    a[j] = a[i];
+    a[i] = t;
+  }
+}
+
+static void run(size_t n)
+{
+  nghttp2_map map;
+  nghttp2_map_entry *ents;
+  key_type *keys;
+  size_t i;
+  key_type next_key;
+  clock_t start;
+  double t_insert, t_find, t_remove, t_churn;
+
+  ents = malloc(sizeof(nghttp2_map_entry) * n);
+  keys = malloc(sizeof(key_type) * n);
+  if(ents == NULL || keys == NULL || nghttp2_map_init(&map) != 0) {
+    fprintf(stderr, "Out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  /* Client initiated stream IDs */
+  for(i = 0; i < n; ++i) {
+    keys[i] = i * 2 + 1;
+    nghttp2_map_entry_init(&ents[i], keys[i]);
+  }
+
+  start = clock();
+  for(i = 0; i < n; ++i) {
+    nghttp2_map_insert(&map, &ents[i]);
+  }
+  t_insert = elapsed(start);
+
+  shuffle(keys, n);
+  start = clock();
+  for(i = 0; i < NUM_FIND; ++i) {
+    if(nghttp2_map_find(&map, keys[i % n]) == NULL) {
+      fprintf(stderr, "Key %u not found\n", keys[i % n]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  t_find = elapsed(start);
+
+  /* Close the oldest stream and open new one, keeping n streams
+     open. */
+  next_key = n * 2 + 1;
+  start = clock();
+  for(i = 0; i < NUM_CHURN; ++i) {
+    nghttp2_map_entry *ent = &ents[i % n];
+    nghttp2_map_remove(&map, ent->key);
+    nghttp2_map_entry_init(ent, next_key);
+    next_key += 2;
+    nghttp2_map_insert(&map, ent);
+  }
+  t_churn = elapsed(start);
+
+  start = clock();
+  for(i = 0; i < n; ++i) {
+    nghttp2_map_remove(&map, ents[i].key);
+  }
+  t_remove = elapsed(start);
+
+  printf("%6zu streams: insert %7.1f ns/op, find %7.1f ns/op, "
+         "churn %7.1f ns/op, remove %7.1f ns/op\n",
+         n,
+         t_insert * 1e9 / n,
+         t_find * 1e9 / NUM_FIND,
+         t_churn * 1e9 / NUM_CHURN,
+         t_remove * 1e9 / n);
+
+  nghttp2_map_free(&map);
+  free(keys);
+  free(ents);
+}
+
+int main(int argc, char **argv)
+{
+  size_t nums[] = { 100, 1000, 10000 };
+  size_t i;
+  for(i = 0; i < sizeof(nums) / sizeof(nums[0]); ++i) {
+    run(nums[i]);
+  }
+  return 0;
+}
@@ -687,3 +687,79 @@ void test_nghttp2_hd_deflate_inflate(void)
   nghttp2_hd_inflate_free(&inflater);
   nghttp2_hd_deflate_free(&deflater);
 }
+
+static size_t count_nv_map(nghttp2_hd_context *deflater,
+                           nghttp2_hd_entry *target)
+{
+  size_t i, n = 0;
+  nghttp2_hd_entry *ent;
+  for(i = 0; i < NGHTTP2_HD_MAP_SIZE; ++i) {
+    for(ent = deflater->nv_map[i]; ent; ent = ent->nv_next) {
+      if(target == NULL || ent == target) {
+        ++n;
+      }
+    }
+  }
+  return n;
+}
+
+static size_t count_name_map(nghttp2_hd_context *deflater,
+                             nghttp2_hd_entry *target)
+{
+  size_t i, n = 0;
+  nghttp2_hd_entry *ent;
+  for(i = 0; i < NGHTTP2_HD_MAP_SIZE; ++i) {
+    for(ent = deflater->name_map[i]; ent; ent = ent->name_next) {
+      if(target == NULL || ent == target) {
+        ++n;
+      }
+    }
+  }
+  return n;
+}
+
+void test_nghttp2_hd_deflate_index(void)
+{
+  nghttp2_hd_context deflater, inflater;
+  nghttp2_nv nva[2];
+  char name[32], value[64];
+  uint8_t *buf = NULL;
+  size_t buflen = 0;
+  ssize_t blocklen;
+  size_t i, j;
+
+  nghttp2_hd_deflate_init(&deflater, NGHTTP2_HD_SIDE_CLIENT);
+  nghttp2_hd_inflate_init(&inflater, NGHTTP2_HD_SIDE_SERVER);
+
+  CU_ASSERT(NULL == inflater.nv_map);
+  CU_ASSERT(NULL == inflater.name_map);
+  CU_ASSERT(deflater.hd_tablelen == count_nv_map(&deflater, NULL));
+  CU_ASSERT(deflater.hd_tablelen == count_name_map(&deflater, NULL));
+
+  /* Add enough distinct header fields to evict the initial entries
+     and wrap the header table several times. */
+  for(i = 0; i < 500; ++i) {
+    snprintf(name, sizeof(name), "x-name-%zu", i % 7);
+    snprintf(value, sizeof(value), "value-%zu", i);
+    nva[0] = (nghttp2_nv)MAKE_NV(":path", "/");
+    nva[1] = (nghttp2_nv)MAKE_NV(name, value);
+    check_deflate_inflate(&deflater, &inflater, nva, 2);
+
+    CU_ASSERT(deflater.hd_tablelen == count_nv_map(&deflater, NULL));
+    CU_ASSERT(deflater.hd_tablelen == count_name_map(&deflater, NULL));
+    for(j = 0; j < deflater.hd_tablelen; ++j) {
+      CU_ASSERT(1 == count_nv_map(&deflater, deflater.hd_table[j]));
+      CU_ASSERT(1 == count_name_map(&deflater, deflater.hd_table[j]));
+    }
+  }
+
+  /* The last header field is in the reference set, so it is
+     implicitly emitted and nothing is encoded. */
+  blocklen = nghttp2_hd_deflate_hd(&deflater, &buf, &buflen, 0, nva, 2);
+  CU_ASSERT(0 == blocklen);
+  nghttp2_hd_end_headers(&deflater);
+
+  free(buf);
+  nghttp2_hd_inflate_free(&inflater);
+  nghttp2_hd_deflate_free(&deflater);
+}
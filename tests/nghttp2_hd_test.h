@@ -38,5 +38,6 @@ void test_nghttp2_hd_inflate_newname_subst(void);
 void test_nghttp2_hd_inflate_clearall_inc(void);
 void test_nghttp2_hd_inflate_clearall_subst(void);
 void test_nghttp2_hd_deflate_inflate(void);
+void test_nghttp2_hd_deflate_index(void);
 
 #endif /* NGHTTP2_HD_TEST_H */
@@ -134,11 +134,25 @@ void test_nghttp2_map_functional(void)
   for(i = 0; i < NUM_ENT; ++i) {
     nghttp2_map_find(&map, order[i]);
   }
-  /* remove */
+  /* remove half of them and make sure that the rest are still
+     found */
   shuffle(order, NUM_ENT);
-  for(i = 0; i < NUM_ENT; ++i) {
+  for(i = 0; i < NUM_ENT / 2; ++i) {
+    CU_ASSERT(0 == nghttp2_map_remove(&map, order[i]));
+  }
+  CU_ASSERT(NUM_ENT - NUM_ENT / 2 == nghttp2_map_size(&map));
+  for(i = 0; i < NUM_ENT / 2; ++i) {
+    CU_ASSERT(NULL == nghttp2_map_find(&map, order[i]));
+  }
+  for(i = NUM_ENT / 2; i < NUM_ENT; ++i) {
+    CU_ASSERT(&arr[order[i] - 1].map_entry ==
+              nghttp2_map_find(&map, order[i]));
+  }
+  /* remove */
+  for(i = NUM_ENT / 2; i < NUM_ENT; ++i) {
     CU_ASSERT(0 == nghttp2_map_remove(&map, order[i]));
   }
+  CU_ASSERT(0 == nghttp2_map_size(&map));
 
   /* each_free (but no op function for testing purpose) */
   for(i = 0; i < NUM_ENT; ++i) {
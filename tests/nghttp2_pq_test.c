@@ -24,13 +24,40 @@
  */
 #include "nghttp2_pq_test.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include <CUnit/CUnit.h>
 
 #include "nghttp2_pq.h"
 
+typedef struct {
+  nghttp2_pq_entry ent;
+  const char *s;
+} string_entry;
+
+static string_entry* string_entry_new(const char *s)
+{
+  string_entry *ent = malloc(sizeof(string_entry));
+  ent->s = s;
+  return ent;
+}
+
 static int pq_compar(const void *lhs, const void *rhs)
 {
-  return strcmp(lhs, rhs);
+  return strcmp(((const string_entry*)lhs)->s, ((const string_entry*)rhs)->s);
+}
+
+static const char* top_string(nghttp2_pq *pq)
+{
+  return ((string_entry*)nghttp2_pq_top(pq))->s;
+}
+
+static void pop_free(nghttp2_pq *pq)
+{
+  string_entry *ent = (string_entry*)nghttp2_pq_top(pq);
+  nghttp2_pq_pop(pq);
+  free(ent);
 }
 
 void test_nghttp2_pq(void)
@@ -40,37 +67,37 @@ void test_nghttp2_pq(void)
   nghttp2_pq_init(&pq, pq_compar);
   CU_ASSERT(nghttp2_pq_empty(&pq));
   CU_ASSERT(0 == nghttp2_pq_size(&pq));
-  CU_ASSERT(0 == nghttp2_pq_push(&pq, (void*)"foo"));
+  CU_ASSERT(0 == nghttp2_pq_push(&pq, &string_entry_new("foo")->ent));
   CU_ASSERT(0 == nghttp2_pq_empty(&pq));
   CU_ASSERT(1 == nghttp2_pq_size(&pq));
-  CU_ASSERT(strcmp("foo", nghttp2_pq_top(&pq)) == 0);
-  CU_ASSERT(0 == nghttp2_pq_push(&pq, (void*)"bar"));
-  CU_ASSERT(strcmp("bar", nghttp2_pq_top(&pq)) == 0);
-  CU_ASSERT(0 == nghttp2_pq_push(&pq, (void*)"baz"));
-  CU_ASSERT(strcmp("bar", nghttp2_pq_top(&pq)) == 0);
-  CU_ASSERT(0 == nghttp2_pq_push(&pq, (void*)"C"));
+  CU_ASSERT(strcmp("foo", top_string(&pq)) == 0);
+  CU_ASSERT(0 == nghttp2_pq_push(&pq, &string_entry_new("bar")->ent));
+  CU_ASSERT(strcmp("bar", top_string(&pq)) == 0);
+  CU_ASSERT(0 == nghttp2_pq_push(&pq, &string_entry_new("baz")->ent));
+  CU_ASSERT(strcmp("bar", top_string(&pq)) == 0);
+  CU_ASSERT(0 == nghttp2_pq_push(&pq, &string_entry_new("C")->ent));
   CU_ASSERT(4 == nghttp2_pq_size(&pq));
-  CU_ASSERT(strcmp("C", nghttp2_pq_top(&pq)) == 0);
-  nghttp2_pq_pop(&pq);
+  CU_ASSERT(strcmp("C", top_string(&pq)) == 0);
+  pop_free(&pq);
   CU_ASSERT(3 == nghttp2_pq_size(&pq));
-  CU_ASSERT(strcmp("bar", nghttp2_pq_top(&pq)) == 0);
-  nghttp2_pq_pop(&pq);
-  CU_ASSERT(strcmp("baz", nghttp2_pq_top(&pq)) == 0);
-  nghttp2_pq_pop(&pq);
-  CU_ASSERT(strcmp("foo", nghttp2_pq_top(&pq)) == 0);
-  nghttp2_pq_pop(&pq);
+  CU_ASSERT(strcmp("bar", top_string(&pq)) == 0);
+  pop_free(&pq);
+  CU_ASSERT(strcmp("baz", top_string(&pq)) == 0);
+  pop_free(&pq);
+  CU_ASSERT(strcmp("foo", top_string(&pq)) == 0);
+  pop_free(&pq);
   CU_ASSERT(nghttp2_pq_empty(&pq));
   CU_ASSERT(0 == nghttp2_pq_size(&pq));
   CU_ASSERT(NULL == nghttp2_pq_top(&pq));
 
   /* Add bunch of entry to see realloc works */
   for(i = 0; i < 10000; ++i) {
-    CU_ASSERT(0 == nghttp2_pq_push(&pq, (void*)"foo"));
+    CU_ASSERT(0 == nghttp2_pq_push(&pq, &string_entry_new("foo")->ent));
     CU_ASSERT((size_t)(i+1) == nghttp2_pq_size(&pq));
   }
   for(i = 10000; i > 0; --i) {
     CU_ASSERT(NULL != nghttp2_pq_top(&pq));
-    nghttp2_pq_pop(&pq);
+    pop_free(&pq);
     CU_ASSERT((size_t)(i-1) == nghttp2_pq_size(&pq));
   }
 
@@ -78,6 +105,7 @@ void test_nghttp2_pq(void)
 }
 
 typedef struct {
+  nghttp2_pq_entry ent;
   int key;
   int val;
 } node;
@@ -113,13 +141,13 @@ void test_nghttp2_pq_update(void)
   for(i = 0; i < sizeof(nodes)/sizeof(nodes[0]); ++i) {
     nodes[i].key = i;
     nodes[i].val = i;
-    nghttp2_pq_push(&pq, &nodes[i]);
+    nghttp2_pq_push(&pq, &nodes[i].ent);
   }
 
   nghttp2_pq_update(&pq, node_update, NULL);
 
   for(i = 0; i < sizeof(nodes)/sizeof(nodes[0]); ++i) {
-    nd = nghttp2_pq_top(&pq);
+    nd = (node*)nghttp2_pq_top(&pq);
     CU_ASSERT(ans[i] == nd->key);
     nghttp2_pq_pop(&pq);
   }
@@ -127,3 +155,44 @@ void test_nghttp2_pq_update(void)
   nghttp2_pq_free(&pq);
 }
 
+void test_nghttp2_pq_update_item(void)
+{
+  nghttp2_pq pq;
+  node nodes[10];
+  size_t i;
+  node *nd;
+  int ans[] = {-9, -4, 0, 1, 2, 3, 5, 6, 7, 100};
+
+  nghttp2_pq_init(&pq, node_compar);
+
+  for(i = 0; i < sizeof(nodes)/sizeof(nodes[0]); ++i) {
+    nodes[i].key = i;
+    nodes[i].val = i;
+    nghttp2_pq_push(&pq, &nodes[i].ent);
+  }
+
+  /* Move up, move down and move to the top */
+  nodes[4].key = -4;
+  nghttp2_pq_update_item(&pq, &nodes[4].ent);
+  nodes[8].key = 100;
+  nghttp2_pq_update_item(&pq, &nodes[8].ent);
+  nodes[9].key = -9;
+  nghttp2_pq_update_item(&pq, &nodes[9].ent);
+
+  CU_ASSERT(&nodes[9] == (node*)nghttp2_pq_top(&pq));
+  nghttp2_pq_pop(&pq);
+
+  /* The item not in the queue is ignored */
+  nghttp2_pq_update_item(&pq, &nodes[9].ent);
+
+  nghttp2_pq_push(&pq, &nodes[9].ent);
+
+  for(i = 0; i < sizeof(nodes)/sizeof(nodes[0]); ++i) {
+    nd = (node*)nghttp2_pq_top(&pq);
+    CU_ASSERT(ans[i] == nd->key);
+    nghttp2_pq_pop(&pq);
+  }
+  CU_ASSERT(nghttp2_pq_empty(&pq));
+
+  nghttp2_pq_free(&pq);
+}
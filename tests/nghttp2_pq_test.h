@@ -27,5 +27,6 @@
 
 void test_nghttp2_pq(void);
 void test_nghttp2_pq_update(void);
+void test_nghttp2_pq_update_item(void);
 
 #endif /* NGHTTP2_PQ_TEST_H */
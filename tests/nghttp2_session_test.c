@@ -67,6 +67,7 @@ typedef struct {
   size_t block_count;
   int data_chunk_recv_cb_called;
   int data_recv_cb_called;
+  int send_cb_called;
 } my_user_data;
 
 static void scripted_data_feed_init(scripted_data_feed *df,
@@ -126,6 +127,16 @@ static ssize_t accumulator_send_callback(nghttp2_session *session,
   return len;
 }
 
+static ssize_t counting_accumulator_send_callback(nghttp2_session *session,
+                                                  const uint8_t *buf,
+                                                  size_t len,
+                                                  int flags, void* user_data)
+{
+  my_user_data *ud = (my_user_data*)user_data;
+  ++ud->send_cb_called;
+  return accumulator_send_callback(session, buf, len, flags, user_data);
+}
+
 static int on_frame_recv_callback(nghttp2_session *session,
                                   const nghttp2_frame *frame,
                                   void *user_data)
@@ -205,6 +216,26 @@ static ssize_t fixed_length_data_source_read_callback
   return wlen;
 }
 
+static ssize_t no_copy_data_source_read_callback
+(nghttp2_session *session, int32_t stream_id,
+ uint8_t *buf, size_t len, int *eof,
+ nghttp2_data_source *source, void *user_data)
+{
+  my_user_data *ud = (my_user_data*)user_data;
+  size_t wlen;
+  if(len < ud->data_source_length) {
+    wlen = len;
+  } else {
+    wlen = ud->data_source_length;
+  }
+  ud->data_source_length -= wlen;
+  *eof = NGHTTP2_DATA_FLAG_NO_COPY;
+  if(ud->data_source_length == 0) {
+    *eof |= NGHTTP2_DATA_FLAG_EOF;
+  }
+  return wlen;
+}
+
 static ssize_t temporal_failure_data_source_read_callback
 (nghttp2_session *session, int32_t stream_id,
  uint8_t *buf, size_t len, int *eof,
@@ -256,6 +287,22 @@ static ssize_t block_count_send_callback(nghttp2_session* session,
   return r;
 }
 
+static int block_count_send_data_callback(nghttp2_session* session,
+                                          const uint8_t *framehd,
+                                          size_t length, int32_t stream_id,
+                                          nghttp2_data_source *source,
+                                          void *user_data)
+{
+  my_user_data *ud = (my_user_data*)user_data;
+  CU_ASSERT(length == nghttp2_get_uint16(framehd));
+  CU_ASSERT(stream_id == (int32_t)nghttp2_get_uint32(&framehd[4]));
+  if(ud->block_count == 0) {
+    return NGHTTP2_ERR_WOULDBLOCK;
+  }
+  --ud->block_count;
+  return 0;
+}
+
 static ssize_t defer_data_source_read_callback
 (nghttp2_session *session, int32_t stream_id,
  uint8_t *buf, size_t len, int *eof,
@@ -631,6 +678,66 @@ void test_nghttp2_session_recv_data(void)
   nghttp2_session_del(session);
 }
 
+void test_nghttp2_session_recv_in_place(void)
+{
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  my_user_data user_data;
+  char value[8192];
+  const char *nv[] = { "url", value, NULL };
+  uint8_t *framedata = NULL;
+  size_t framedatalen = 0;
+  ssize_t framelen;
+  nghttp2_frame frame;
+  nghttp2_nv *nva;
+  ssize_t nvlen;
+  size_t bufmax;
+  int32_t stream_id;
+
+  memset(value, 'a', sizeof(value));
+  value[sizeof(value)-1] = '\0';
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = null_send_callback;
+  callbacks.on_frame_recv_callback = on_frame_recv_callback;
+  nghttp2_session_server_new(&session, &callbacks, &user_data);
+  bufmax = session->iframe.bufmax;
+
+  for(stream_id = 1; stream_id <= 3; stream_id += 2) {
+    nvlen = nghttp2_nv_array_from_cstr(&nva, nv);
+    nghttp2_frame_headers_init(&frame.headers, NGHTTP2_FLAG_END_HEADERS,
+                               stream_id, NGHTTP2_PRI_DEFAULT, nva, nvlen);
+    framelen = nghttp2_frame_pack_headers(&framedata, &framedatalen,
+                                          &frame.headers,
+                                          &session->hd_deflater);
+    nghttp2_hd_end_headers(&session->hd_deflater);
+    nghttp2_frame_headers_free(&frame.headers);
+    CU_ASSERT((size_t)framelen > bufmax);
+
+    user_data.frame_recv_cb_called = 0;
+    if(stream_id == 1) {
+      /* The whole frame is in the input, so it is processed in place
+         without growing the inbound buffer. */
+      CU_ASSERT(framelen == nghttp2_session_mem_recv(session, framedata,
+                                                     framelen));
+      CU_ASSERT(bufmax == session->iframe.bufmax);
+    } else {
+      /* The frame is split, so the payload is buffered. */
+      CU_ASSERT(100 == nghttp2_session_mem_recv(session, framedata, 100));
+      CU_ASSERT(0 == user_data.frame_recv_cb_called);
+      CU_ASSERT(framelen - 100 ==
+                nghttp2_session_mem_recv(session, framedata + 100,
+                                         framelen - 100));
+      CU_ASSERT(bufmax < session->iframe.bufmax);
+    }
+    CU_ASSERT(1 == user_data.frame_recv_cb_called);
+    CU_ASSERT(NULL != nghttp2_session_get_stream(session, stream_id));
+  }
+
+  free(framedata);
+  nghttp2_session_del(session);
+}
+
 void test_nghttp2_session_add_frame(void)
 {
   nghttp2_session *session;
@@ -2439,13 +2546,11 @@ void test_nghttp2_session_pop_next_ob_item(void)
 
   item = nghttp2_session_pop_next_ob_item(session);
   CU_ASSERT(NGHTTP2_PING == OB_CTRL_TYPE(item));
-  nghttp2_outbound_item_free(item);
-  free(item);
+  nghttp2_session_outbound_item_del(session, item);
 
   item = nghttp2_session_pop_next_ob_item(session);
   CU_ASSERT(NGHTTP2_HEADERS == OB_CTRL_TYPE(item));
-  nghttp2_outbound_item_free(item);
-  free(item);
+  nghttp2_session_outbound_item_del(session, item);
 
   CU_ASSERT(NULL == nghttp2_session_pop_next_ob_item(session));
 
@@ -2463,8 +2568,7 @@ void test_nghttp2_session_pop_next_ob_item(void)
   item = nghttp2_session_pop_next_ob_item(session);
   CU_ASSERT(NGHTTP2_HEADERS == OB_CTRL_TYPE(item));
   CU_ASSERT(1 == OB_CTRL(item)->hd.stream_id);
-  nghttp2_outbound_item_free(item);
-  free(item);
+  nghttp2_session_outbound_item_del(session, item);
 
   CU_ASSERT(NULL == nghttp2_session_pop_next_ob_item(session));
 
@@ -2472,8 +2576,7 @@ void test_nghttp2_session_pop_next_ob_item(void)
 
   item = nghttp2_session_pop_next_ob_item(session);
   CU_ASSERT(NGHTTP2_HEADERS == OB_CTRL_TYPE(item));
-  nghttp2_outbound_item_free(item);
-  free(item);
+  nghttp2_session_outbound_item_del(session, item);
 
   nghttp2_session_del(session);
 
@@ -3162,6 +3265,115 @@ void test_nghttp2_session_on_ctrl_not_send(void)
   nghttp2_session_del(session);
 }
 
+typedef struct {
+  int32_t stream_ids[40];
+  size_t len;
+} data_send_order;
+
+static ssize_t limited_send_callback(nghttp2_session *session,
+                                     const uint8_t *data, size_t len,
+                                     int flags, void *user_data)
+{
+  data_send_order *order = (data_send_order*)user_data;
+  if(order->len == sizeof(order->stream_ids)/sizeof(order->stream_ids[0])) {
+    return NGHTTP2_ERR_WOULDBLOCK;
+  }
+  return len;
+}
+
+static int record_data_send_callback(nghttp2_session *session,
+                                     uint16_t length, uint8_t flags,
+                                     int32_t stream_id, void *user_data)
+{
+  data_send_order *order = (data_send_order*)user_data;
+  order->stream_ids[order->len++] = stream_id;
+  return 0;
+}
+
+static ssize_t endless_data_source_read_callback
+(nghttp2_session *session, int32_t stream_id,
+ uint8_t *buf, size_t len, int *eof,
+ nghttp2_data_source *source, void *user_data)
+{
+  return len;
+}
+
+/*
+ * Submits 3 requests with endless request body: stream 1 with
+ * priority |pri1| and stream 3 and 5 with NGHTTP2_PRI_DEFAULT. Then
+ * sends DATA until |order| is filled.
+ */
+static void send_competing_data(data_send_order *order, int32_t pri1,
+                                int fair)
+{
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  const char *nv[] = { "url", "/", NULL };
+  nghttp2_data_provider data_prd;
+  nghttp2_frame frame;
+  nghttp2_settings_entry iv = { NGHTTP2_SETTINGS_FLOW_CONTROL_OPTIONS, 0x1 };
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = limited_send_callback;
+  callbacks.on_data_send_callback = record_data_send_callback;
+  data_prd.read_callback = endless_data_source_read_callback;
+
+  order->len = 0;
+  nghttp2_session_client_new(&session, &callbacks, order);
+  CU_ASSERT(0 == nghttp2_session_set_option
+            (session, NGHTTP2_OPT_FAIR_DATA_SCHEDULING, &fair, sizeof(fair)));
+  /* Disable flow control so that only the scheduler decides the
+     order */
+  nghttp2_frame_settings_init(&frame.settings, dup_iv(&iv, 1), 1);
+  nghttp2_session_on_settings_received(session, &frame);
+  nghttp2_frame_settings_free(&frame.settings);
+
+  nghttp2_submit_request(session, pri1, nv, &data_prd, NULL);
+  nghttp2_submit_request(session, NGHTTP2_PRI_DEFAULT, nv, &data_prd, NULL);
+  nghttp2_submit_request(session, NGHTTP2_PRI_DEFAULT, nv, &data_prd, NULL);
+
+  CU_ASSERT(0 == nghttp2_session_send(session));
+  CU_ASSERT(sizeof(order->stream_ids)/sizeof(order->stream_ids[0]) ==
+            order->len);
+
+  nghttp2_session_del(session);
+}
+
+static size_t count_stream_data(data_send_order *order, int32_t stream_id)
+{
+  size_t i, n = 0;
+  for(i = 0; i < order->len; ++i) {
+    if(order->stream_ids[i] == stream_id) {
+      ++n;
+    }
+  }
+  return n;
+}
+
+void test_nghttp2_session_fair_data_scheduling(void)
+{
+  data_send_order order;
+  size_t i;
+
+  /* By default, the first stream with the highest priority takes all
+     bandwidth. */
+  send_competing_data(&order, 0, 0);
+  CU_ASSERT(order.len == count_stream_data(&order, 1));
+
+  /* Streams with the same priority are served in round robin */
+  send_competing_data(&order, NGHTTP2_PRI_DEFAULT, 1);
+  for(i = 0; i < order.len; ++i) {
+    CU_ASSERT((int32_t)(i % 3) * 2 + 1 == order.stream_ids[i]);
+  }
+
+  /* Stream 1 with priority 0 has 16 times as much weight as the
+     others, but does not starve them. */
+  send_competing_data(&order, 0, 1);
+  CU_ASSERT(2 == count_stream_data(&order, 3));
+  CU_ASSERT(2 == count_stream_data(&order, 5));
+  CU_ASSERT(36 == count_stream_data(&order, 1));
+}
+
 void test_nghttp2_session_get_outbound_queue_size(void)
 {
   nghttp2_session *session;
@@ -3274,6 +3486,410 @@ void test_nghttp2_session_data_backoff_by_high_pri_frame(void)
   nghttp2_session_del(session);
 }
 
+void test_nghttp2_session_data_no_copy(void)
+{
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  const char *nv[] = { NULL };
+  my_user_data ud;
+  nghttp2_data_provider data_prd;
+  nghttp2_stream *stream;
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = null_send_callback;
+  callbacks.send_data_callback = block_count_send_data_callback;
+  data_prd.read_callback = no_copy_data_source_read_callback;
+
+  ud.data_source_length = 16*1024;
+
+  nghttp2_session_client_new(&session, &callbacks, &ud);
+  nghttp2_submit_request(session, NGHTTP2_PRI_DEFAULT, nv, &data_prd, NULL);
+
+  ud.block_count = 1;
+  /* Sends HEADERS + DATA[0]. DATA[1] is blocked. */
+  CU_ASSERT(0 == nghttp2_session_send(session));
+  CU_ASSERT(NGHTTP2_INITIAL_CONNECTION_WINDOW_SIZE - 4096 ==
+            session->remote_window_size);
+  /* data for DATA[1] is read from data_prd but it is not sent */
+  CU_ASSERT(ud.data_source_length == 8*1024);
+
+  ud.block_count = 3;
+  /* Sends DATA[1..3] */
+  CU_ASSERT(0 == nghttp2_session_send(session));
+  CU_ASSERT(0 == ud.block_count);
+  CU_ASSERT(NGHTTP2_INITIAL_CONNECTION_WINDOW_SIZE - 16*1024 ==
+            session->remote_window_size);
+
+  stream = nghttp2_session_get_stream(session, 1);
+  CU_ASSERT(stream->shut_flags & NGHTTP2_SHUT_WR);
+
+  nghttp2_session_del(session);
+
+  /* NGHTTP2_DATA_FLAG_NO_COPY requires send_data_callback */
+  callbacks.send_data_callback = NULL;
+  ud.data_source_length = 16*1024;
+
+  nghttp2_session_client_new(&session, &callbacks, &ud);
+  nghttp2_submit_request(session, NGHTTP2_PRI_DEFAULT, nv, &data_prd, NULL);
+
+  CU_ASSERT(NGHTTP2_ERR_CALLBACK_FAILURE == nghttp2_session_send(session));
+
+  nghttp2_session_del(session);
+}
+
+void test_nghttp2_session_send_batch(void)
+{
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  const char *nv[] = { NULL };
+  my_user_data ud;
+  accumulator acc;
+  nghttp2_data_provider data_prd;
+  nghttp2_frame_hd hd;
+  int intval;
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = counting_accumulator_send_callback;
+  callbacks.on_frame_send_callback = on_frame_send_callback;
+  data_prd.read_callback = fixed_length_data_source_read_callback;
+
+  acc.length = 0;
+  ud.acc = &acc;
+  ud.send_cb_called = 0;
+  ud.frame_send_cb_called = 0;
+
+  nghttp2_session_client_new(&session, &callbacks, &ud);
+
+  intval = 1024;
+  CU_ASSERT(0 == nghttp2_session_set_option(session,
+                                            NGHTTP2_OPT_SEND_BATCH_SIZE,
+                                            &intval, sizeof(intval)));
+
+  /* 3 PING frames are sent in one send_callback invocation */
+  nghttp2_submit_ping(session, NULL);
+  nghttp2_submit_ping(session, NULL);
+  nghttp2_submit_ping(session, NULL);
+
+  CU_ASSERT(0 == nghttp2_session_send(session));
+  CU_ASSERT(1 == ud.send_cb_called);
+  CU_ASSERT(3 == ud.frame_send_cb_called);
+  CU_ASSERT(3 * (NGHTTP2_FRAME_HEAD_LENGTH + 8) == acc.length);
+  CU_ASSERT(0 == session->batch.buflen);
+
+  /* DATA frames larger than the buffer are sent directly, after the
+     buffered HEADERS is flushed. */
+  acc.length = 0;
+  ud.send_cb_called = 0;
+  ud.data_source_length = 2*1024;
+  nghttp2_submit_request(session, NGHTTP2_PRI_DEFAULT, nv, &data_prd, NULL);
+
+  intval = 16;
+  CU_ASSERT(0 == nghttp2_session_set_option(session,
+                                       NGHTTP2_OPT_SEND_BATCH_SIZE,
+                                       &intval, sizeof(intval)));
+
+  CU_ASSERT(0 == nghttp2_session_send(session));
+  CU_ASSERT(2 == ud.send_cb_called);
+  nghttp2_frame_unpack_frame_hd(&hd, acc.buf);
+  CU_ASSERT(NGHTTP2_HEADERS == hd.type);
+  nghttp2_frame_unpack_frame_hd(&hd, acc.buf + NGHTTP2_FRAME_HEAD_LENGTH +
+                                hd.length);
+  CU_ASSERT(NGHTTP2_DATA == hd.type);
+  CU_ASSERT(2*1024 == hd.length);
+
+  nghttp2_session_del(session);
+
+  /* Frames stay in the buffer while send_callback would block */
+  callbacks.send_callback = block_count_send_callback;
+  ud.block_count = 0;
+  ud.frame_send_cb_called = 0;
+
+  nghttp2_session_client_new(&session, &callbacks, &ud);
+
+  intval = 1024;
+  nghttp2_session_set_option(session, NGHTTP2_OPT_SEND_BATCH_SIZE,
+                             &intval, sizeof(intval));
+
+  nghttp2_submit_ping(session, NULL);
+  nghttp2_submit_goaway(session, NGHTTP2_NO_ERROR, NULL, 0);
+
+  CU_ASSERT(0 == nghttp2_session_send(session));
+  CU_ASSERT(2 == ud.frame_send_cb_called);
+  CU_ASSERT(0 < session->batch.buflen);
+  CU_ASSERT(nghttp2_session_want_write(session));
+  CU_ASSERT(NGHTTP2_ERR_INVALID_STATE ==
+            nghttp2_session_set_option(session,
+                                       NGHTTP2_OPT_SEND_BATCH_SIZE,
+                                       &intval, sizeof(intval)));
+
+  ud.block_count = 1;
+  CU_ASSERT(0 == nghttp2_session_send(session));
+  CU_ASSERT(0 == session->batch.buflen);
+  CU_ASSERT(!nghttp2_session_want_write(session));
+
+  nghttp2_session_del(session);
+}
+
+typedef struct {
+  size_t malloc_called;
+  size_t free_called;
+} counting_mem_data;
+
+static void* counting_malloc(size_t size, void *mem_user_data)
+{
+  ++((counting_mem_data*)mem_user_data)->malloc_called;
+  return malloc(size);
+}
+
+static void counting_free(void *ptr, void *mem_user_data)
+{
+  ++((counting_mem_data*)mem_user_data)->free_called;
+  free(ptr);
+}
+
+void test_nghttp2_session_custom_mem(void)
+{
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  const char *nv[] = { "foo", "bar", NULL };
+  my_user_data ud;
+  nghttp2_data_provider data_prd;
+  nghttp2_mem mem;
+  counting_mem_data md;
+  size_t malloc_called;
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = null_send_callback;
+  data_prd.read_callback = fixed_length_data_source_read_callback;
+
+  md.malloc_called = md.free_called = 0;
+  mem.mem_user_data = &md;
+  mem.malloc = counting_malloc;
+  mem.free = counting_free;
+
+  ud.data_source_length = 100;
+
+  CU_ASSERT(0 == nghttp2_session_client_new2(&session, &callbacks, &ud,
+                                             &mem));
+  CU_ASSERT(1 == md.malloc_called);
+
+  /* Stream, item, frame, aux data, data provider and name/value
+     pairs are allocated by mem. */
+  CU_ASSERT(0 == nghttp2_submit_request(session, NGHTTP2_PRI_DEFAULT, nv,
+                                        &data_prd, NULL));
+  CU_ASSERT(0 == nghttp2_session_send(session));
+  CU_ASSERT(NULL != nghttp2_session_get_stream(session, 1));
+  CU_ASSERT(1 < md.malloc_called);
+  CU_ASSERT(0 < md.free_called);
+
+  /* Once the frames are returned to the free lists, sending more
+     frames does not call allocator. */
+  nghttp2_submit_ping(session, NULL);
+  nghttp2_submit_window_update(session, NGHTTP2_FLAG_NONE, 0, 1);
+  CU_ASSERT(0 == nghttp2_session_send(session));
+  malloc_called = md.malloc_called;
+  nghttp2_submit_ping(session, NULL);
+  nghttp2_submit_window_update(session, NGHTTP2_FLAG_NONE, 0, 1);
+  CU_ASSERT(0 == nghttp2_session_send(session));
+  CU_ASSERT(malloc_called == md.malloc_called);
+
+  nghttp2_session_del(session);
+
+  CU_ASSERT(md.malloc_called == md.free_called);
+}
+
+/*
+ * Returns the number of bytes held by the buffers and free lists of
+ * |session| which nghttp2_session_shrink() can release.
+ */
+static size_t session_buffer_bytes(nghttp2_session *session)
+{
+  size_t n = session->aob.framebufmax + session->iframe.bufmax;
+  if(session->hd_inflater.emit_set) {
+    n += sizeof(nghttp2_hd_entry*) * session->hd_inflater.emit_set_capacity;
+  }
+  n += session->item_pool.len * session->item_pool.objsize;
+  n += session->frame_pool.len * session->frame_pool.objsize;
+  n += session->data_pool.len * session->data_pool.objsize;
+  n += session->aux_pool.len * session->aux_pool.objsize;
+  return n;
+}
+
+void test_nghttp2_session_shrink(void)
+{
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  my_user_data ud;
+  const char *nv[] = { "url", "/", NULL };
+  uint8_t *framedata = NULL;
+  size_t framedatalen = 0;
+  ssize_t framelen;
+  nghttp2_frame frame;
+  nghttp2_nv *nva;
+  ssize_t nvlen;
+  nghttp2_data_provider data_prd;
+  size_t idle_bytes;
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = null_send_callback;
+  data_prd.read_callback = fixed_length_data_source_read_callback;
+  ud.data_source_length = 100;
+  nghttp2_session_server_new(&session, &callbacks, &ud);
+
+  /* Nothing is allocated until the session does something */
+  idle_bytes = session_buffer_bytes(session);
+  CU_ASSERT(0 == idle_bytes);
+
+  /* Receive a request, split across two reads so that its payload is
+     buffered, and send a response. */
+  nvlen = nghttp2_nv_array_from_cstr(&nva, nv);
+  nghttp2_frame_headers_init(&frame.headers, NGHTTP2_FLAG_END_HEADERS |
+                             NGHTTP2_FLAG_END_STREAM,
+                             1, NGHTTP2_PRI_DEFAULT, nva, nvlen);
+  framelen = nghttp2_frame_pack_headers(&framedata, &framedatalen,
+                                        &frame.headers,
+                                        &session->hd_deflater);
+  nghttp2_hd_end_headers(&session->hd_deflater);
+  nghttp2_frame_headers_free(&frame.headers);
+  CU_ASSERT(framelen - 1 ==
+            nghttp2_session_mem_recv(session, framedata, framelen - 1));
+  CU_ASSERT(1 == nghttp2_session_mem_recv(session, framedata + framelen - 1,
+                                          1));
+  CU_ASSERT(0 == nghttp2_submit_response(session, 1, nv, &data_prd));
+  CU_ASSERT(0 == nghttp2_session_send(session));
+  CU_ASSERT(NULL == nghttp2_session_get_stream(session, 1));
+
+  CU_ASSERT(idle_bytes < session_buffer_bytes(session));
+  CU_ASSERT(NULL != session->aob.framebuf);
+  CU_ASSERT(NULL != session->iframe.buf);
+  CU_ASSERT(NULL != session->hd_inflater.emit_set);
+
+  nghttp2_session_shrink(session);
+  CU_ASSERT(idle_bytes == session_buffer_bytes(session));
+
+  /* The session still works after shrink, and header table is
+     intact. */
+  nvlen = nghttp2_nv_array_from_cstr(&nva, nv);
+  nghttp2_frame_headers_init(&frame.headers, NGHTTP2_FLAG_END_HEADERS |
+                             NGHTTP2_FLAG_END_STREAM,
+                             3, NGHTTP2_PRI_DEFAULT, nva, nvlen);
+  framelen = nghttp2_frame_pack_headers(&framedata, &framedatalen,
+                                        &frame.headers,
+                                        &session->hd_deflater);
+  nghttp2_hd_end_headers(&session->hd_deflater);
+  nghttp2_frame_headers_free(&frame.headers);
+  CU_ASSERT(framelen ==
+            nghttp2_session_mem_recv(session, framedata, framelen));
+  CU_ASSERT(NULL != nghttp2_session_get_stream(session, 3));
+  CU_ASSERT(0 == nghttp2_submit_response(session, 3, nv, &data_prd));
+  CU_ASSERT(0 == nghttp2_session_send(session));
+  CU_ASSERT(NULL == nghttp2_session_get_stream(session, 3));
+
+  free(framedata);
+  nghttp2_session_del(session);
+}
+
+typedef struct {
+  size_t header_cb_called;
+  int frame_recv_cb_called;
+  int nva_was_null;
+  uint8_t name[16], value[16];
+  size_t namelen, valuelen;
+} header_cb_data;
+
+static int on_header_callback(nghttp2_session *session,
+                              const nghttp2_frame *frame,
+                              const uint8_t *name, size_t namelen,
+                              const uint8_t *value, size_t valuelen,
+                              void *user_data)
+{
+  header_cb_data *hd = (header_cb_data*)user_data;
+  ++hd->header_cb_called;
+  if(namelen <= sizeof(hd->name) && valuelen <= sizeof(hd->value)) {
+    memcpy(hd->name, name, namelen);
+    hd->namelen = namelen;
+    memcpy(hd->value, value, valuelen);
+    hd->valuelen = valuelen;
+  }
+  return 0;
+}
+
+static int header_cb_on_frame_recv_callback(nghttp2_session *session,
+                                            const nghttp2_frame *frame,
+                                            void *user_data)
+{
+  header_cb_data *hd = (header_cb_data*)user_data;
+  ++hd->frame_recv_cb_called;
+  hd->nva_was_null = frame->headers.nva == NULL &&
+    frame->headers.nvlen == 0;
+  return 0;
+}
+
+void test_nghttp2_session_on_header_callback(void)
+{
+  nghttp2_session *session;
+  nghttp2_session_callbacks callbacks;
+  header_cb_data hd;
+  const char *nv[] = { "url", "/", NULL };
+  uint8_t *framedata = NULL;
+  size_t framedatalen = 0;
+  ssize_t framelen;
+  nghttp2_frame frame;
+  nghttp2_nv *nva;
+  ssize_t nvlen;
+  nghttp2_outbound_item *item;
+  int32_t stream_id;
+
+  memset(&callbacks, 0, sizeof(nghttp2_session_callbacks));
+  callbacks.send_callback = null_send_callback;
+  callbacks.on_frame_recv_callback = header_cb_on_frame_recv_callback;
+  callbacks.on_header_callback = on_header_callback;
+  nghttp2_session_server_new(&session, &callbacks, &hd);
+
+  for(stream_id = 1; stream_id <= 5; stream_id += 2) {
+    nvlen = nghttp2_nv_array_from_cstr(&nva, nv);
+    nghttp2_frame_headers_init(&frame.headers, NGHTTP2_FLAG_END_HEADERS,
+                               stream_id, NGHTTP2_PRI_DEFAULT, nva, nvlen);
+    framelen = nghttp2_frame_pack_headers(&framedata, &framedatalen,
+                                          &frame.headers,
+                                          &session->hd_deflater);
+    nghttp2_hd_end_headers(&session->hd_deflater);
+    nghttp2_frame_headers_free(&frame.headers);
+
+    memset(&hd, 0, sizeof(hd));
+    if(stream_id == 3) {
+      /* Stream 3 is refused. Its header block must be consumed to
+         keep header table in sync, but not emitted. */
+      session->local_settings[NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS] = 1;
+    } else {
+      session->local_settings[NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS] =
+        NGHTTP2_INITIAL_MAX_CONCURRENT_STREAMS;
+    }
+    CU_ASSERT(framelen == nghttp2_session_mem_recv(session, framedata,
+                                                   framelen));
+    if(stream_id == 3) {
+      CU_ASSERT(0 == hd.header_cb_called);
+      CU_ASSERT(0 == hd.frame_recv_cb_called);
+      item = nghttp2_session_get_next_ob_item(session);
+      CU_ASSERT(NGHTTP2_RST_STREAM == OB_CTRL_TYPE(item));
+      CU_ASSERT(NGHTTP2_REFUSED_STREAM ==
+                OB_CTRL(item)->rst_stream.error_code);
+      CU_ASSERT(0 == nghttp2_session_send(session));
+    } else {
+      CU_ASSERT(1 == hd.header_cb_called);
+      CU_ASSERT(1 == hd.frame_recv_cb_called);
+      CU_ASSERT(hd.nva_was_null);
+      CU_ASSERT(3 == hd.namelen);
+      CU_ASSERT(0 == memcmp("url", hd.name, 3));
+      CU_ASSERT(1 == hd.valuelen);
+      CU_ASSERT(0 == memcmp("/", hd.value, 1));
+    }
+  }
+
+  free(framedata);
+  nghttp2_session_del(session);
+}
+
 void test_nghttp2_pack_settings_payload(void)
 {
   nghttp2_settings_entry iv[2];
@@ -30,6 +30,7 @@ void test_nghttp2_session_recv_invalid_stream_id(void);
 void test_nghttp2_session_recv_invalid_frame(void);
 void test_nghttp2_session_recv_eof(void);
 void test_nghttp2_session_recv_data(void);
+void test_nghttp2_session_recv_in_place(void);
 void test_nghttp2_session_recv_frame_too_large(void);
 void test_nghttp2_session_add_frame(void);
 void test_nghttp2_session_on_request_headers_received(void);
@@ -84,9 +85,15 @@ void test_nghttp2_session_data_read_temporal_failure(void);
 void test_nghttp2_session_on_request_recv_callback(void);
 void test_nghttp2_session_on_stream_close(void);
 void test_nghttp2_session_on_ctrl_not_send(void);
+void test_nghttp2_session_fair_data_scheduling(void);
 void test_nghttp2_session_get_outbound_queue_size(void);
 void test_nghttp2_session_set_option(void);
 void test_nghttp2_session_data_backoff_by_high_pri_frame(void);
+void test_nghttp2_session_data_no_copy(void);
+void test_nghttp2_session_send_batch(void);
+void test_nghttp2_session_custom_mem(void);
+void test_nghttp2_session_shrink(void);
+void test_nghttp2_session_on_header_callback(void);
 void test_nghttp2_pack_settings_payload(void);
 
 #endif /* NGHTTP2_SESSION_TEST_H */